@@ -4,9 +4,15 @@
 #include "../utility.glsl"
 #include "../voxel_world.glsl"
 
+// a bit per brick whose voxel types changed this frame, so the CPU side can refresh what the automata moved
+layout(std430, set = 1, binding = 0) restrict buffer ChangedBricks {
+    uint changedBricks[];
+};
+
 layout(local_size_x = 4, local_size_y = 2, local_size_z = 4) in;
 
 shared uint localOccupancy[32];
+shared uint brickChanged;
 
 void main() {
     ivec3 pos = ivec3(gl_GlobalInvocationID.xyz) * ivec3(2, 4, 2);
@@ -14,6 +20,10 @@ void main() {
     uint brick_index = getBrickIndex(pos);
     uint id = gl_LocalInvocationIndex;      
     uint occupied = 0;
+    bool changed = false;
+    if (id == 0u)
+        brickChanged = 0u;
+    barrier();
     
     for (int x = 0; x < 2; ++x) {
         for (int y = 0; y < 4; ++y) {
@@ -24,16 +34,21 @@ void main() {
                 uint voxel_index = voxelBricks[brick_index].voxel_data_pointer * BRICK_VOLUME
                                     + getVoxelIndexInBrick(world_pos); 
                 
-                if(isVoxelDynamic(getPreviousVoxel(voxel_index))) {
+                Voxel previous = getPreviousVoxel(voxel_index);
+                Voxel current = getVoxel(voxel_index);
+                changed = changed || (previous.data >> 24) != (current.data >> 24);
+                if(isVoxelDynamic(previous)) {
                     setPreviousVoxel(voxel_index, createAirVoxel());
                 }
                 
-                occupied += isVoxelAir(getVoxel(voxel_index)) ? 0 : 1;
+                occupied += isVoxelAir(current) ? 0 : 1;
             }
         }
     }  
 
     localOccupancy[id] = occupied;
+    if (changed)
+        brickChanged = 1u;
     barrier();
     
     if (id == 0u) {
@@ -43,5 +58,7 @@ void main() {
         }
 
         voxelBricks[brick_index].occupancy_count = count;
+        if (brickChanged != 0u)
+            atomicOr(changedBricks[brick_index >> 5], 1u << (brick_index & 31u));
     }
 }
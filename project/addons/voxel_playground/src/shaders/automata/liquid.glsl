@@ -3,6 +3,10 @@
 
 #include "../utility.glsl"
 #include "../voxel_world.glsl"
+#include "../particles/particle_pool.glsl"
+
+// a dynamic voxel with this many air cells below it is in free fall and leaves the grid as a particle
+#define FREE_FALL_DEPTH 3
 
 
 ivec3 directions[4] = ivec3[](
@@ -44,6 +48,15 @@ bool move_water(ivec3 pos, ivec3 dir, uint brick_index, uint voxel_index, uint n
     return true;
 }
 
+bool isFreeFalling(ivec3 pos) {
+    for (int i = 1; i <= FREE_FALL_DEPTH; ++i) {
+        ivec3 below = pos - ivec3(0, i, 0);
+        if (!isValidPos(below) || !isVoxelAir(getPreviousVoxel(posToIndex(below))))
+            return false;
+    }
+    return true;
+}
+
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;
 void main() {
     ivec3 pos = ivec3(gl_GlobalInvocationID.xyz);
@@ -53,6 +66,13 @@ void main() {
     uint voxel_index = voxelBricks[brick_index].voxel_data_pointer * BRICK_VOLUME + getVoxelIndexInBrick(pos); 
 
     Voxel voxel_value = getPreviousVoxel(voxel_index);
+    if (isVoxelDynamic(voxel_value) && isFreeFalling(pos)) {
+        // hand it over to the particle pool, falling at the speed it had on the grid (one cell per tick).
+        // Nothing is written to the current buffer, so the voxel leaves the grid.
+        vec3 velocity = vec3(0.0, -1.0 / max(particleParams.delta, 1e-3), 0.0);
+        if (spawnParticle(vec3(pos) + vec3(0.5), velocity, voxel_value))
+            return;
+    }
     if(isVoxelLiquid(voxel_value)) {
         if(!move_water(pos, ivec3(0, -1, 0), brick_index, voxel_index, voxel_value.data, false))
         {
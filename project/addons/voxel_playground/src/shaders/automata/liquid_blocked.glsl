@@ -0,0 +1,221 @@
+#[compute]
+#version 460
+
+#include "../utility.glsl"
+#include "../voxel_world.glsl"
+
+// Temporal blocking variant of liquid.glsl. Every workgroup loads its 8^3 tile plus a halo into shared memory,
+// advances it params.steps generations on-chip and only writes the interior back to global memory.
+// To stay free of atomics the rules are applied on a Margolus neighbourhood: the tile is split into 2x2x2 blocks
+// whose origin alternates each generation, so a block only depends on itself. Cells that could not be updated
+// at the tile border go stale and that error creeps inward one voxel per generation, hence HALO == MAX_STEPS.
+
+#define TILE_EDGE 8
+#define MAX_STEPS 3
+#define HALO MAX_STEPS
+#define SHARED_EDGE (TILE_EDGE + 2 * HALO)
+#define SHARED_VOLUME (SHARED_EDGE * SHARED_EDGE * SHARED_EDGE)
+#define GROUP_VOLUME (TILE_EDGE * TILE_EDGE * TILE_EDGE)
+
+layout(std430, set = 1, binding = 0) restrict buffer Params {
+    int steps;
+} params;
+
+#define PARTICLE_BINDING 1
+#include "../particles/particle_pool.glsl"
+
+// same free fall rule as liquid.glsl
+#define FREE_FALL_DEPTH 3
+
+// marks cells outside of the world, anything moving there is lost (same as liquid.glsl)
+const uint VOID_VOXEL = 0xFFFFFFFFu;
+
+shared uint tile[SHARED_VOLUME];
+
+ivec3 directions[4] = ivec3[](
+    ivec3(-1, 0, 0), // left
+    ivec3(0, 0, 1),  // forward
+    ivec3(1, 0, 0),  // right
+    ivec3(0, 0, -1)  // backward
+);
+
+uint getVoxelDirectionID(uint voxel) {
+    return voxel & 0xFu;
+}
+
+uint withVoxelDirectionID(uint voxel, uint directionID) {
+    return (voxel & ~0xFu) | (directionID & 0xFu);
+}
+
+bool isFreeFalling(ivec3 pos) {
+    for (int i = 1; i <= FREE_FALL_DEPTH; ++i) {
+        ivec3 below = pos - ivec3(0, i, 0);
+        if (!isValidPos(below) || !isVoxelAir(getPreviousVoxel(posToIndex(below))))
+            return false;
+    }
+    return true;
+}
+
+uint tileIndex(ivec3 p) {
+    return uint(p.x + p.y * SHARED_EDGE + p.z * SHARED_EDGE * SHARED_EDGE);
+}
+
+// index of a cell inside a 2x2x2 block
+int blockCell(int dx, int dy, int dz) {
+    return dx + 2 * dy + 4 * dz;
+}
+
+bool isFree(uint voxel) {
+    return voxel == VOID_VOXEL || isVoxelAir(Voxel(voxel));
+}
+
+bool isLiquid(uint voxel) {
+    return voxel != VOID_VOXEL && isVoxelLiquid(Voxel(voxel));
+}
+
+bool isSand(uint voxel) {
+    return voxel != VOID_VOXEL && isVoxelType(Voxel(voxel), VOXEL_TYPE_SAND);
+}
+
+// moves cells[from] into cells[to]. sand displaces liquid, which takes its old place.
+void moveCell(inout uint cells[8], inout bool moved[8], int from, int to) {
+    uint target = cells[to];
+    if (target != VOID_VOXEL)
+        cells[to] = cells[from];
+    cells[from] = isLiquid(target) ? target : createAirVoxel().data;
+    moved[to] = true;
+    moved[from] = isLiquid(target);
+}
+
+// picks the lateral direction for a liquid the same way liquid.glsl does, returns the updated voxel
+uint pickLiquidDirection(uint voxel, uint randVal, out uint index) {
+    uint previous_index = getVoxelDirectionID(voxel);
+    if (previous_index == 0u) {
+        index = randVal % 4u;
+        return withVoxelDirectionID(voxel, index + 1u);
+    }
+    --previous_index;
+    uint randPercent = randVal % 100u;
+    if (randPercent < 80u) {
+        index = previous_index;
+    } else if (randPercent < 90u) {
+        index = (previous_index + 1u) % 4u;
+    } else {
+        index = (previous_index + 3u) % 4u;
+    }
+    return voxel;
+}
+
+// returns the block cell that lies in direction dir from (dx, dy, dz), or -1 if it is outside of the block
+int lateralNeighbour(int dx, int dy, int dz, ivec3 dir) {
+    int nx = dx + dir.x;
+    int nz = dz + dir.z;
+    if (nx < 0 || nx > 1 || nz < 0 || nz > 1)
+        return -1;
+    return blockCell(nx, dy, nz);
+}
+
+void stepBlock(ivec3 origin, ivec3 tile_min, uint seed) {
+    uint cells[8];
+    bool moved[8];
+    for (int i = 0; i < 8; ++i) {
+        cells[i] = tile[tileIndex(origin + ivec3(i & 1, (i >> 1) & 1, (i >> 2) & 1))];
+        moved[i] = false;
+    }
+
+    // gravity: the upper layer falls into the lower layer
+    for (int dz = 0; dz < 2; ++dz) {
+        for (int dx = 0; dx < 2; ++dx) {
+            int up = blockCell(dx, 1, dz);
+            int down = blockCell(dx, 0, dz);
+            if (isLiquid(cells[up]) && isFree(cells[down]))
+                moveCell(cells, moved, up, down);
+            else if (isSand(cells[up]) && (isFree(cells[down]) || isLiquid(cells[down])))
+                moveCell(cells, moved, up, down);
+        }
+    }
+
+    // lateral spreading for everything that did not fall. Lower layer cells cannot see what is below them, they get
+    // their chance to fall once the block origin shifts in the next generation.
+    for (int i = 0; i < 8; ++i) {
+        if (moved[i])
+            continue;
+        int dx = i & 1, dy = (i >> 1) & 1, dz = (i >> 2) & 1;
+        bool upper_blocked = dy == 1 && !isFree(cells[blockCell(dx, 0, dz)]);
+        ivec3 world_pos = tile_min + origin + ivec3(dx, dy, dz);
+        uint randVal = hash(uvec4(uvec3(world_pos), seed)).x;
+
+        if (isLiquid(cells[i]) && (dy == 0 || upper_blocked)) {
+            uint index;
+            uint voxel = pickLiquidDirection(cells[i], randVal, index);
+            int target = lateralNeighbour(dx, dy, dz, directions[index]);
+            if (target < 0) {
+                cells[i] = voxel; // points out of the block, try again next generation
+            } else if (isFree(cells[target]) && !moved[target]) {
+                cells[i] = voxel;
+                moveCell(cells, moved, i, target);
+            } else {
+                cells[i] = withVoxelDirectionID(voxel, 0u);
+            }
+        } else if (isSand(cells[i]) && upper_blocked) {
+            int target = lateralNeighbour(dx, 0, dz, directions[randVal % 4u]);
+            if (target >= 0 && !moved[target] && (isFree(cells[target]) || isLiquid(cells[target])))
+                moveCell(cells, moved, i, target);
+        }
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        tile[tileIndex(origin + ivec3(i & 1, (i >> 1) & 1, (i >> 2) & 1))] = cells[i];
+    }
+}
+
+layout(local_size_x = TILE_EDGE, local_size_y = TILE_EDGE, local_size_z = TILE_EDGE) in;
+void main() {
+    ivec3 tile_min = ivec3(gl_WorkGroupID.xyz) * TILE_EDGE - ivec3(HALO);
+    int lid = int(gl_LocalInvocationIndex);
+
+    int steps = clamp(params.steps, 1, MAX_STEPS);
+    for (int i = lid; i < SHARED_VOLUME; i += GROUP_VOLUME) {
+        ivec3 p = ivec3(i % SHARED_EDGE, (i / SHARED_EDGE) % SHARED_EDGE, i / (SHARED_EDGE * SHARED_EDGE));
+        ivec3 world_pos = tile_min + p;
+        uint voxel = isValidPos(world_pos) ? getPreviousVoxel(posToIndex(world_pos)).data : VOID_VOXEL;
+
+        // Free falling voxels leave the grid as particles before the generations run. Every tile that loads the
+        // cell drops it, only the tile that owns it spawns the particle. If the pool is exhausted the owner keeps
+        // the voxel like liquid.glsl does, and the tiles that have it in their halo see a stale cell.
+        if (voxel != VOID_VOXEL && particleParams.spawn_enabled != 0u && isVoxelDynamic(Voxel(voxel)) &&
+            isFreeFalling(world_pos)) {
+            bool owned = all(greaterThanEqual(p, ivec3(HALO))) && all(lessThan(p, ivec3(HALO + TILE_EDGE)));
+            // the grid moved it steps cells per tick
+            vec3 velocity = vec3(0.0, -float(steps) / max(particleParams.delta, 1e-3), 0.0);
+            if (!owned || spawnParticle(vec3(world_pos) + vec3(0.5), velocity, Voxel(voxel)))
+                voxel = createAirVoxel().data;
+        }
+        tile[i] = voxel;
+    }
+    barrier();
+
+    for (int g = 0; g < steps; ++g) {
+        uint seed = uint(voxelWorldProperties.frame) * uint(MAX_STEPS) + uint(g);
+        // blocks start at world coordinates with the parity of this generation, so neighbouring tiles agree
+        ivec3 first = (ivec3(int(seed & 1u)) - tile_min) & 1;
+        ivec3 blocks = (ivec3(SHARED_EDGE) - first) / 2;
+        if (lid < blocks.x * blocks.y * blocks.z) {
+            ivec3 b = ivec3(lid % blocks.x, (lid / blocks.x) % blocks.y, lid / (blocks.x * blocks.y));
+            stepBlock(first + 2 * b, tile_min, seed);
+        }
+        barrier();
+    }
+
+    // write back the interior only. The current buffer holds just the static voxels (see cleanup_pass.glsl),
+    // so only cells that were or became dynamic need to be written.
+    ivec3 pos = ivec3(gl_GlobalInvocationID.xyz);
+    if (!isValidPos(pos)) return;
+
+    uint voxel_index = posToIndex(pos);
+    Voxel previous = getPreviousVoxel(voxel_index);
+    Voxel result = Voxel(tile[tileIndex(ivec3(gl_LocalInvocationID.xyz) + ivec3(HALO))]);
+    if (isVoxelDynamic(previous) || isVoxelDynamic(result)) {
+        setVoxel(voxel_index, result);
+    }
+}
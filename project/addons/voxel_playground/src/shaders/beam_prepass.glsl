@@ -0,0 +1,91 @@
+#[compute]
+#version 460
+
+#include "utility.glsl"
+#include "voxel_world.glsl"
+
+// Coarse pre-pass of voxel_renderer_new.glsl. One cone per BEAM_TILE_SIZE x BEAM_TILE_SIZE pixel tile is marched
+// along its axis, every brick the cone touches on the way has to be empty. The distance it gets to is stored per
+// tile and the primary rays of the tile start their world trace there instead of at the near plane.
+
+#define BEAM_TILE_SIZE 8
+#define MAX_BEAM_STEPS 256
+#define MAX_BEAM_FOOTPRINT 4 // bricks per axis, a wider cone stops
+
+layout(set = 1, binding = 0, r32f) restrict uniform writeonly image2D beamImage;
+
+layout(std430, set = 1, binding = 1) restrict buffer Params {
+    vec4 background; //rgb, brightness
+    int width;
+    int height;
+    float fov;
+    int beam_prepass;
+} params;
+
+layout(std430, set = 1, binding = 2) restrict buffer Camera {
+    mat4 view_projection;
+    mat4 inv_view_projection;
+    vec4 position;
+    uint frame_index;
+    float near;
+    float far;
+} camera;
+
+// same rays as voxel_renderer_new.glsl, pixel in render pixels
+vec3 screenRay(vec2 pixel) {
+    vec4 ndc = vec4(pixel / vec2(params.width, params.height) * 2.0 - 1.0, 0.0, 1.0);
+    ndc.y = -ndc.y;
+    vec4 world_pos = camera.inv_view_projection * ndc;
+    return normalize(world_pos.xyz / world_pos.w - camera.position.xyz);
+}
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+void main() {
+    ivec2 tile = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 tiles = (ivec2(params.width, params.height) + BEAM_TILE_SIZE - 1) / BEAM_TILE_SIZE;
+    if (tile.x >= tiles.x || tile.y >= tiles.y) return;
+
+    // the cone around the tile, one pixel wider for the jitter of the temporal upscale
+    vec2 lo = vec2(tile * BEAM_TILE_SIZE) - 1.0;
+    vec2 hi = vec2((tile + 1) * BEAM_TILE_SIZE) + 1.0;
+    vec3 axis = screenRay((lo + hi) * 0.5);
+    float cos_cone = min(min(dot(axis, screenRay(lo)), dot(axis, screenRay(hi))),
+                         min(dot(axis, screenRay(vec2(lo.x, hi.y))), dot(axis, screenRay(vec2(hi.x, lo.y)))));
+    float tan_cone = sqrt(max(1.0 - cos_cone * cos_cone, 0.0)) / cos_cone;
+
+    float scale = voxelWorldProperties.scale;
+    float brick_scale = scale * BRICK_EDGE_LENGTH;
+    ivec3 brick_grid_size = voxelWorldProperties.brick_grid_size.xyz;
+    vec3 origin = camera.position.xyz;
+
+    // A pixel ray reaches distance t no further along the axis than t, so everything it passes before the
+    // distance stored here lies in the part of the cone that was found empty. A camera outside the world is
+    // not handled, its tiles start at the near plane.
+    float start = camera.near;
+    if (all(greaterThanEqual(origin, vec3(0.0))) && all(lessThan(origin, vec3(brick_grid_size) * brick_scale))) {
+        for (int i = 0; i < MAX_BEAM_STEPS && start < camera.far; ++i) {
+            float end = start + brick_scale;
+            float radius = end * tan_cone + scale;
+            vec3 a = origin + axis * start;
+            vec3 b = origin + axis * end;
+            ivec3 first = max(ivec3(floor((min(a, b) - radius) / brick_scale)), ivec3(0));
+            ivec3 last = min(ivec3(floor((max(a, b) + radius) / brick_scale)), brick_grid_size - 1);
+            if (any(greaterThan(first, last))) {
+                // the cone left the world and does not come back, the camera is inside
+                start = camera.far;
+                break;
+            }
+            if (any(greaterThanEqual(last - first, ivec3(MAX_BEAM_FOOTPRINT)))) break;
+
+            bool empty = true;
+            for (int z = first.z; z <= last.z && empty; ++z)
+                for (int y = first.y; y <= last.y && empty; ++y)
+                    for (int x = first.x; x <= last.x && empty; ++x)
+                        empty = voxelBricks[getBrickIndex(ivec3(x, y, z) * BRICK_EDGE_LENGTH)].occupancy_count == 0u;
+            if (!empty) break;
+            start = end;
+        }
+    }
+
+    imageStore(beamImage, tile, vec4(min(start, camera.far), 0.0, 0.0, 0.0));
+}
@@ -0,0 +1,147 @@
+#[compute]
+#version 460
+
+// Bins the projectiles and entities of voxel_renderer_new.glsl into screen tiles, so its pixels only test the
+// objects that can cover them. The bindings match the renderer. Every workgroup projects a batch of objects
+// into shared memory once, then each invocation checks the batch against its own tile.
+
+#define OBJECT_BINS_BINDING 11
+#include "object_bins.glsl"
+
+layout(std430, set = 1, binding = 2) restrict buffer Params {
+    vec4 background; //rgb, brightness
+    int width;
+    int height;
+    float fov;
+    int beam_prepass;
+    int object_binning;
+} params;
+
+layout(std430, set = 1, binding = 3) restrict buffer Camera {
+    mat4 view_projection;
+    mat4 inv_view_projection;
+    vec4 position;
+    uint frame_index;
+    float near;
+    float far;
+} camera;
+
+layout(std430, set = 1, binding = 4) restrict buffer ProjectileParams {
+    int projectile_count;
+} projectileParams;
+
+layout(std430, set = 1, binding = 5) restrict buffer ProjectileSpheres {
+    vec4 projectile_spheres[];
+} projectileData;
+
+struct EntityDescriptor {
+    mat4 local_to_world;
+    mat4 world_to_local;
+    vec4 aabb_min;
+    vec4 aabb_max;
+    vec4 grid_size;
+    vec4 brick_grid_size;
+    float scale;
+    uint brick_offset;
+    uint voxel_offset;
+    uint brick_count;
+    uint enabled;
+    float health;
+    float _pad0, _pad1, _pad2;
+};
+
+layout(std430, set = 1, binding = 6) restrict buffer EntityCount {
+    int entity_count;
+} entityCount;
+
+layout(std430, set = 1, binding = 9) restrict buffer EntityDescriptors {
+    EntityDescriptor entities[];
+} entityDesc;
+
+#define GROUP_SIZE 64
+const vec4 EMPTY_RECT = vec4(1e20, 1e20, -1e20, -1e20);
+
+shared vec4 rects[GROUP_SIZE]; // xy min, zw max, render pixels
+
+// Screen rect of a world space box in render pixels. Perspective keeps the projected box inside the hull of
+// its corners, a box that reaches behind the near plane covers the whole screen.
+vec4 screenRect(vec3 lo, vec3 hi) {
+    vec4 rect = EMPTY_RECT;
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = vec3((i & 1) != 0 ? hi.x : lo.x, (i & 2) != 0 ? hi.y : lo.y, (i & 4) != 0 ? hi.z : lo.z);
+        vec4 clip = camera.view_projection * vec4(corner, 1.0);
+        if (clip.w <= camera.near)
+            return vec4(-1e20, -1e20, 1e20, 1e20);
+        vec2 ndc = clip.xy / clip.w;
+        ndc.y = -ndc.y;
+        vec2 pixel = (ndc * 0.5 + 0.5) * vec2(params.width, params.height);
+        rect.xy = min(rect.xy, pixel);
+        rect.zw = max(rect.zw, pixel);
+    }
+    return rect;
+}
+
+vec4 projectileRect(int i) {
+    vec4 sphere = projectileData.projectile_spheres[i];
+    if (sphere.w <= 0.0) return EMPTY_RECT; // free slot
+    return screenRect(sphere.xyz - sphere.w, sphere.xyz + sphere.w);
+}
+
+vec4 entityRect(int i) {
+    EntityDescriptor ent = entityDesc.entities[i];
+    if (ent.enabled == 0u) return EMPTY_RECT;
+    // world space AABB of the oriented box, the same as the BVH bounds
+    vec3 center = (ent.local_to_world * vec4((ent.aabb_min.xyz + ent.aabb_max.xyz) * 0.5, 1.0)).xyz;
+    mat3 rotation = mat3(ent.local_to_world);
+    vec3 extent = mat3(abs(rotation[0]), abs(rotation[1]), abs(rotation[2])) * ((ent.aabb_max.xyz - ent.aabb_min.xyz) * 0.5);
+    return screenRect(center - extent, center + extent);
+}
+
+bool overlaps(vec4 rect, vec4 tile_rect) {
+    return rect.x <= tile_rect.z && rect.z >= tile_rect.x && rect.y <= tile_rect.w && rect.w >= tile_rect.y;
+}
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+void main() {
+    ivec2 tile = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 tiles = (ivec2(params.width, params.height) + BIN_TILE_SIZE - 1) / BIN_TILE_SIZE;
+    // invocations outside the screen still project objects for the group, so no early return before the barriers
+    bool active = tile.x < tiles.x && tile.y < tiles.y;
+    // one pixel wider for the jitter of the temporal upscale
+    vec4 tile_rect = vec4(vec2(tile * BIN_TILE_SIZE) - 1.0, vec2((tile + 1) * BIN_TILE_SIZE) + 1.0);
+    uint bin = binOffset(tile, params.width);
+
+    uint count = 0u;
+    int projectile_count = projectileParams.projectile_count;
+    for (int base = 0; base < projectile_count; base += GROUP_SIZE) {
+        int i = base + int(gl_LocalInvocationIndex);
+        rects[gl_LocalInvocationIndex] = i < projectile_count ? projectileRect(i) : EMPTY_RECT;
+        barrier();
+        for (int j = 0; j < GROUP_SIZE && base + j < projectile_count; ++j) {
+            if (!active || count == BIN_OVERFLOW || !overlaps(rects[j], tile_rect)) continue;
+            if (count == MAX_TILE_PROJECTILES)
+                count = BIN_OVERFLOW;
+            else
+                tileBins[bin + BIN_PROJECTILES + count++] = uint(base + j);
+        }
+        barrier();
+    }
+    if (active) tileBins[bin] = count;
+
+    count = 0u;
+    int entity_count = entityCount.entity_count;
+    for (int base = 0; base < entity_count; base += GROUP_SIZE) {
+        int i = base + int(gl_LocalInvocationIndex);
+        rects[gl_LocalInvocationIndex] = i < entity_count ? entityRect(i) : EMPTY_RECT;
+        barrier();
+        for (int j = 0; j < GROUP_SIZE && base + j < entity_count; ++j) {
+            if (!active || count == BIN_OVERFLOW || !overlaps(rects[j], tile_rect)) continue;
+            if (count == MAX_TILE_ENTITIES)
+                count = BIN_OVERFLOW;
+            else
+                tileBins[bin + BIN_ENTITIES + count++] = uint(base + j);
+        }
+        barrier();
+    }
+    if (active) tileBins[bin + 1u] = count;
+}
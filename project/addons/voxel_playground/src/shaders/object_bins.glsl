@@ -0,0 +1,29 @@
+#ifndef OBJECT_BINS_GLSL
+#define OBJECT_BINS_GLSL
+
+// Per screen tile lists of the projectiles and entities whose screen bounds overlap the tile, built by
+// object_binning.glsl. A tile is one workgroup of voxel_renderer_new.glsl. A list that overflows is marked
+// BIN_OVERFLOW and the pixels of that tile test every object, like without binning.
+#ifndef OBJECT_BINS_BINDING
+#define OBJECT_BINS_BINDING 0
+#endif
+
+#define BIN_TILE_SIZE 32
+#define MAX_TILE_PROJECTILES 64
+#define MAX_TILE_ENTITIES 16
+#define BIN_OVERFLOW 0xFFFFFFFFu
+// per tile: projectile count, entity count, projectile indices, entity indices
+#define BIN_STRIDE (2 + MAX_TILE_PROJECTILES + MAX_TILE_ENTITIES)
+#define BIN_PROJECTILES 2
+#define BIN_ENTITIES (2 + MAX_TILE_PROJECTILES)
+
+layout(std430, set = 1, binding = OBJECT_BINS_BINDING) restrict buffer ObjectBins {
+    uint tileBins[];
+};
+
+uint binOffset(ivec2 tile, int width) {
+    int tiles_x = (width + BIN_TILE_SIZE - 1) / BIN_TILE_SIZE;
+    return uint(tile.y * tiles_x + tile.x) * BIN_STRIDE;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef OBJECT_BVH_GLSL
+#define OBJECT_BVH_GLSL
+
+// Linear BVH over the projectile spheres and entity boxes, built by ObjectBvh on the CPU whenever they change.
+// There are only internal nodes, a child is either another node or an object reference with BVH_LEAF set.
+// Node 0 is the root.
+#ifndef OBJECT_BVH_BINDING
+#define OBJECT_BVH_BINDING 0
+#endif
+
+#define BVH_LEAF 0x80000000u
+#define BVH_ENTITY 0x40000000u // the reference is an entity, else a projectile
+#define BVH_INDEX_MASK 0x3FFFFFFFu
+#define BVH_INVALID 0xFFFFFFFFu
+#define BVH_STACK_SIZE 64
+
+struct BvhNode {
+    vec4 bounds_min; // w: left child (floatBitsToUint)
+    vec4 bounds_max; // w: right child
+};
+
+layout(std430, set = 1, binding = OBJECT_BVH_BINDING) restrict buffer ObjectBvh {
+    uint bvh_node_count;
+    uint _bvh_pad0, _bvh_pad1, _bvh_pad2;
+    BvhNode bvh_nodes[];
+};
+
+// true if the ray enters the box before t_max
+bool bvhHitsBox(vec3 bounds_min, vec3 bounds_max, vec3 origin, vec3 inv_dir, float t_max) {
+    vec3 t0 = (bounds_min - origin) * inv_dir;
+    vec3 t1 = (bounds_max - origin) * inv_dir;
+    vec3 t_near = min(t0, t1);
+    vec3 t_far = max(t0, t1);
+    float t_enter = max(max(t_near.x, t_near.y), max(t_near.z, 0.0));
+    float t_exit = min(min(t_far.x, t_far.y), t_far.z);
+    return t_enter <= t_exit && t_enter < t_max;
+}
+
+#endif
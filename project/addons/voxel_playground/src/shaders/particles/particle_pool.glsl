@@ -0,0 +1,59 @@
+#ifndef PARTICLE_POOL_GLSL
+#define PARTICLE_POOL_GLSL
+
+// Pooled free-flying voxels (splashes, debris). Positions and velocities are in voxel units so they map directly
+// onto the grid. The buffers live in set 1 starting at PARTICLE_BINDING, so shaders can put them after their own.
+#ifndef PARTICLE_BINDING
+#define PARTICLE_BINDING 0
+#endif
+
+struct Particle {
+    vec4 position; // xyz position, w voxel data (uintBitsToFloat)
+    vec4 velocity; // xyz velocity, w > 0 when the slot is alive
+};
+
+layout(std430, set = 1, binding = PARTICLE_BINDING) restrict buffer ParticleParams {
+    vec4 gravity; // acceleration in voxels / s^2
+    float delta;
+    uint capacity;
+    uint spawn_enabled;
+} particleParams;
+
+layout(std430, set = 1, binding = PARTICLE_BINDING + 1) restrict buffer ParticleFreeList {
+    int free_count;
+    uint free_slots[];
+} particleFreeList;
+
+layout(std430, set = 1, binding = PARTICLE_BINDING + 2) restrict buffer ParticleData {
+    Particle particles[];
+};
+
+bool isParticleAlive(uint slot) {
+    return particles[slot].velocity.w > 0.0;
+}
+
+// Pops a slot from the free list, returns false if spawning is disabled or the pool is exhausted.
+// Only ever pop or push within one dispatch, never both.
+bool spawnParticle(vec3 position, vec3 velocity, Voxel voxel) {
+    if (particleParams.spawn_enabled == 0u)
+        return false;
+
+    int previous = atomicAdd(particleFreeList.free_count, -1);
+    if (previous <= 0) {
+        atomicAdd(particleFreeList.free_count, 1);
+        return false;
+    }
+
+    uint slot = particleFreeList.free_slots[previous - 1];
+    particles[slot].position = vec4(position, uintBitsToFloat(voxel.data));
+    particles[slot].velocity = vec4(velocity, 1.0);
+    return true;
+}
+
+void freeParticle(uint slot) {
+    particles[slot].velocity.w = 0.0;
+    int index = atomicAdd(particleFreeList.free_count, 1);
+    particleFreeList.free_slots[index] = slot;
+}
+
+#endif // PARTICLE_POOL_GLSL
@@ -0,0 +1,65 @@
+#[compute]
+#version 460
+
+#include "../utility.glsl"
+#include "../voxel_world.glsl"
+
+// Draws the particle pool on top of the ray marched image. Depth tested against the distance written by
+// voxel_renderer_new.glsl, each particle covers a screen square the size of one projected voxel.
+
+layout(set = 1, binding = 0, rgba32f) restrict uniform image2D outputImage;
+layout(set = 1, binding = 1, r32f) restrict uniform readonly image2D depthBuffer;
+
+layout(std430, set = 1, binding = 2) restrict buffer Params {
+    vec4 background;
+    int width;
+    int height;
+    float fov;
+} params;
+
+layout(std430, set = 1, binding = 3) restrict buffer Camera {
+    mat4 view_projection;
+    mat4 inv_view_projection;
+    vec4 position;
+    uint frame_index;
+    float near;
+    float far;
+} camera;
+
+#define PARTICLE_BINDING 4
+#include "particle_pool.glsl"
+
+#define MAX_SPLAT_RADIUS 8
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+void main() {
+    uint slot = gl_GlobalInvocationID.x;
+    if (slot >= particleParams.capacity || !isParticleAlive(slot)) return;
+
+    Particle particle = particles[slot];
+    vec3 world_pos = particle.position.xyz * voxelWorldProperties.scale;
+
+    vec4 clip = camera.view_projection * vec4(world_pos, 1.0);
+    if (clip.w <= camera.near) return;
+    vec2 ndc = clip.xy / clip.w;
+    ndc.y = -ndc.y;
+    ivec2 center = ivec2((ndc * 0.5 + 0.5) * vec2(params.width, params.height));
+
+    float dist = length(world_pos - camera.position.xyz);
+    float focal = 0.5 * float(params.height) / tan(radians(params.fov) * 0.5);
+    int radius = clamp(int(0.5 * voxelWorldProperties.scale * focal / dist), 0, MAX_SPLAT_RADIUS);
+
+    Voxel voxel = Voxel(floatBitsToUint(particle.position.w));
+    vec3 color = getVoxelColor(voxel, ivec3(particle.position.xyz)) * (1.0 + getVoxelEmission(voxel));
+
+    for (int y = -radius; y <= radius; ++y) {
+        for (int x = -radius; x <= radius; ++x) {
+            ivec2 pixel = center + ivec2(x, y);
+            if (pixel.x < 0 || pixel.y < 0 || pixel.x >= params.width || pixel.y >= params.height)
+                continue;
+            if (imageLoad(depthBuffer, pixel).r < dist)
+                continue;
+            imageStore(outputImage, pixel, vec4(color, 1.0));
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#[compute]
+#version 460
+
+#include "../utility.glsl"
+#include "../voxel_world.glsl"
+#include "particle_pool.glsl"
+
+#define MAX_MARCH_STEPS 64
+
+// a bit per brick whose voxel types changed this frame, shared with the cleanup pass
+layout(std430, set = 1, binding = 3) restrict buffer ChangedBricks {
+    uint changedBricks[];
+};
+
+// Writes the particle back into the current grid, fails if the cell got occupied in the meantime.
+bool depositParticle(ivec3 cell, Voxel voxel) {
+    uint voxel_index = posToIndex(cell);
+    Voxel current = getVoxel(voxel_index);
+    if (!isVoxelAir(current))
+        return false;
+
+    uint original;
+    if (voxelWorldProperties.frame % 2 == 0)
+        original = atomicCompSwap(voxelData[voxel_index].data, current.data, voxel.data);
+    else
+        original = atomicCompSwap(voxelData2[voxel_index].data, current.data, voxel.data);
+    if (original != current.data)
+        return false;
+
+    // static voxels have to live in both buffers, dynamic ones are picked up by the automata next frame
+    if (!isVoxelDynamic(voxel))
+        setPreviousVoxel(voxel_index, voxel);
+    uint brick_index = getBrickIndex(cell);
+    atomicAdd(voxelBricks[brick_index].occupancy_count, 1);
+    atomicOr(changedBricks[brick_index >> 5], 1u << (brick_index & 31u));
+    return true;
+}
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+void main() {
+    uint slot = gl_GlobalInvocationID.x;
+    if (slot >= particleParams.capacity || !isParticleAlive(slot)) return;
+
+    Particle particle = particles[slot];
+    Voxel voxel = Voxel(floatBitsToUint(particle.position.w));
+
+    // ballistic integration
+    vec3 velocity = particle.velocity.xyz + particleParams.gravity.xyz * particleParams.delta;
+    vec3 start = particle.position.xyz;
+    vec3 end = start + velocity * particleParams.delta;
+
+    // march towards the new position at most one voxel at a time
+    ivec3 last_free = ivec3(floor(start));
+    int steps = clamp(int(ceil(length(end - start))), 1, MAX_MARCH_STEPS);
+    for (int i = 1; i <= steps; ++i) {
+        ivec3 cell = ivec3(floor(mix(start, end, float(i) / float(steps))));
+        if (cell == last_free)
+            continue;
+
+        if (!isValidPos(cell)) {
+            freeParticle(slot); // left the world
+            return;
+        }
+
+        if (!isVoxelAir(getVoxel(posToIndex(cell)))) {
+            // hit something, turn back into a grid voxel
+            if (isValidPos(last_free) && depositParticle(last_free, voxel)) {
+                freeParticle(slot);
+            } else {
+                // spot got taken, float up a cell and try again next frame
+                particles[slot].position.xyz = vec3(last_free) + vec3(0.5, 1.5, 0.5);
+                particles[slot].velocity.xyz = vec3(0.0);
+            }
+            return;
+        }
+        last_free = cell;
+    }
+
+    particles[slot].position.xyz = end;
+    particles[slot].velocity.xyz = velocity;
+}
@@ -0,0 +1,52 @@
+#[compute]
+#version 460
+
+#include "../utility.glsl"
+#include "../voxel_world.glsl"
+
+// Traces a batch of rays against the voxel world, one invocation per ray.
+
+struct Ray {
+    vec4 origin;    // xyz origin in meters, w near
+    vec4 direction; // xyz direction, w far
+};
+
+struct RayHit {
+    vec4 hit;   // x distance in meters (< 0 if nothing was hit), yzw normal
+    vec4 voxel; // xyz grid position, w voxel type
+};
+
+layout(std430, set = 1, binding = 0) restrict readonly buffer Params {
+    uint ray_count;
+} params;
+
+layout(std430, set = 1, binding = 1) restrict readonly buffer Rays {
+    Ray rays[];
+};
+
+layout(std430, set = 1, binding = 2) restrict writeonly buffer RayHits {
+    RayHit hits[];
+};
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+void main() {
+    uint ray_index = gl_GlobalInvocationID.x;
+    if (ray_index >= params.ray_count) return;
+
+    Ray ray = rays[ray_index];
+    ivec3 grid_position;
+    vec3 normal;
+    int step_count = 0;
+    float t;
+    Voxel voxel;
+
+    bool hit = voxelTraceWorld(ray.origin.xyz, normalize(ray.direction.xyz), vec2(ray.origin.w, ray.direction.w),
+                               voxel, t, grid_position, normal, step_count);
+    if (hit) {
+        hits[ray_index].hit = vec4(t, normal);
+        hits[ray_index].voxel = vec4(vec3(grid_position), float(voxel.data >> 24));
+    } else {
+        hits[ray_index].hit = vec4(-1.0, 0.0, 0.0, 0.0);
+        hits[ray_index].voxel = vec4(0.0);
+    }
+}
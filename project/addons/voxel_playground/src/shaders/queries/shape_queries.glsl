@@ -0,0 +1,198 @@
+#[compute]
+#version 460
+
+#include "../utility.glsl"
+#include "../voxel_world.glsl"
+
+// Sphere sweeps and overlap counts, one workgroup per query. The workgroup walks the bricks under the query bounds,
+// skips the empty ones and the ones the sphere cannot reach, and splits the voxels of the rest between invocations.
+// Same culling and math as VoxelWorldMirror::sweep_sphere / overlap_count.
+
+#define MODE_SWEEP 0u
+#define MODE_OVERLAP 1u
+
+#define TYPE_COUNT 8
+#define REFINE_STEPS 16
+#define SWEEP_EPSILON 1e-3
+#define MIN_DIRECTION 1e-8
+#define NO_HIT 3.0e38
+
+struct ShapeQuery {
+    vec4 from; // xyz sphere center in meters, w radius in meters
+    vec4 to;   // xyz end of the sweep in meters
+    uint type_mask;
+    uint _pad0;
+    uint _pad1;
+    uint _pad2;
+};
+
+layout(std430, set = 1, binding = 0) restrict readonly buffer Params {
+    uint mode;
+    uint query_count;
+} params;
+
+layout(std430, set = 1, binding = 1) restrict readonly buffer Queries {
+    ShapeQuery queries[];
+};
+
+// 8 values per query: for sweeps the float bits of distance (< 0 if nothing was hit), normal, grid position and
+// voxel type, for overlaps the voxel count of every type
+layout(std430, set = 1, binding = 2) restrict writeonly buffer Results {
+    uint results[];
+};
+
+shared uint best_bits;
+shared uint winner;
+shared uint type_counts[TYPE_COUNT];
+
+// entry of the segment o + d * t, t in [0, t_max], into the box
+bool segmentBoxEntry(vec3 o, vec3 d, float t_max, vec3 box_min, vec3 box_max, out float t_entry) {
+    float t0 = 0.0;
+    float t1 = t_max;
+    t_entry = 0.0;
+    for (int a = 0; a < 3; a++) {
+        if (abs(d[a]) < MIN_DIRECTION) {
+            if (o[a] < box_min[a] || o[a] > box_max[a]) return false;
+            continue;
+        }
+        float ta = (box_min[a] - o[a]) / d[a];
+        float tb = (box_max[a] - o[a]) / d[a];
+        t0 = max(t0, min(ta, tb));
+        t1 = min(t1, max(ta, tb));
+    }
+    t_entry = t0;
+    return t0 <= t1;
+}
+
+float boxDistance(vec3 p, vec3 box_min, vec3 box_max) {
+    return length(p - clamp(p, box_min, box_max));
+}
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+void main() {
+    uint query_index = gl_WorkGroupID.x;
+    if (query_index >= params.query_count) return;
+    uint lid = gl_LocalInvocationIndex;
+
+    ShapeQuery query = queries[query_index];
+    float inv_scale = 1.0 / voxelWorldProperties.scale;
+    vec3 o = query.from.xyz * inv_scale;
+    float r = query.from.w * inv_scale;
+    bool sweep = params.mode == MODE_SWEEP;
+
+    if (lid == 0) {
+        best_bits = floatBitsToUint(NO_HIT);
+        winner = 0xFFFFFFFFu;
+    }
+    if (lid < TYPE_COUNT)
+        type_counts[lid] = 0u;
+    barrier();
+
+    // everything in voxel units from here on
+    vec3 delta = sweep ? query.to.xyz * inv_scale - o : vec3(0.0);
+    float len = length(delta);
+    vec3 d = len > 0.0 ? delta / len : vec3(0.0);
+    ivec3 grid_max = voxelWorldProperties.grid_size.xyz - 1;
+    ivec3 min_voxel = clamp(ivec3(floor(min(o, o + delta) - r)), ivec3(0), grid_max);
+    ivec3 max_voxel = clamp(ivec3(floor(max(o, o + delta) + r)), ivec3(0), grid_max);
+    ivec3 min_brick = min_voxel / BRICK_EDGE_LENGTH;
+    ivec3 brick_span = max_voxel / BRICK_EDGE_LENGTH - min_brick + 1;
+    int brick_total = brick_span.x * brick_span.y * brick_span.z;
+
+    float local_best = NO_HIT;
+    ivec3 local_voxel = ivec3(0);
+    uint local_type = 0u;
+    uint local_counts[TYPE_COUNT];
+    for (int k = 0; k < TYPE_COUNT; k++)
+        local_counts[k] = 0u;
+
+    for (int i = 0; i < brick_total; i++) {
+        ivec3 brick = min_brick + ivec3(i % brick_span.x, (i / brick_span.x) % brick_span.y,
+                                        i / (brick_span.x * brick_span.y));
+        ivec3 brick_origin = brick * BRICK_EDGE_LENGTH;
+        uint brick_index = getBrickIndex(brick_origin);
+        bool empty = voxelBricks[brick_index].occupancy_count == 0u;
+        uint first_voxel = voxelBricks[brick_index].voxel_data_pointer * BRICK_VOLUME;
+
+        if (sweep) {
+            // another invocation may already have found a closer contact, a stale value only culls less
+            float best = min(local_best, uintBitsToFloat(best_bits));
+            float t;
+            if (empty || !segmentBoxEntry(o, d, min(len, best), vec3(brick_origin) - r,
+                                          vec3(brick_origin + BRICK_EDGE_LENGTH) + r, t))
+                continue;
+
+            for (uint v = lid; v < BRICK_VOLUME; v += gl_WorkGroupSize.x) {
+                ivec3 pos = brick_origin + ivec3(v & 7u, (v >> 3) & 7u, v >> 6);
+                Voxel voxel = getVoxel(first_voxel + getVoxelIndexInBrick(pos));
+                // liquids do not stop a sweep, like on the CPU
+                if (!isVoxelSolid(voxel)) continue;
+                uint type = voxel.data >> 24;
+
+                vec3 voxel_min = vec3(pos);
+                vec3 voxel_max = voxel_min + 1.0;
+                float t_max = min(len, local_best);
+                if (!segmentBoxEntry(o, d, t_max, voxel_min - r, voxel_max + r, t)) continue;
+                // the expanded box is larger than the rounded one at edges and corners, sphere trace the rest
+                for (int s = 0; s < REFINE_STEPS && t <= t_max; s++) {
+                    float dist = boxDistance(o + d * t, voxel_min, voxel_max) - r;
+                    if (dist <= SWEEP_EPSILON) {
+                        local_best = t;
+                        local_voxel = pos;
+                        local_type = type;
+                        break;
+                    }
+                    t += dist;
+                }
+            }
+        } else {
+            // empty bricks only matter when air is counted
+            if ((empty && (query.type_mask & 1u) == 0u) ||
+                boxDistance(o, vec3(brick_origin) + 0.5, vec3(brick_origin + BRICK_EDGE_LENGTH) - 0.5) > r)
+                continue;
+
+            for (uint v = lid; v < BRICK_VOLUME; v += gl_WorkGroupSize.x) {
+                ivec3 pos = brick_origin + ivec3(v & 7u, (v >> 3) & 7u, v >> 6);
+                if (distance(vec3(pos) + 0.5, o) > r) continue;
+                uint type = empty ? VOXEL_TYPE_AIR : getVoxel(first_voxel + getVoxelIndexInBrick(pos)).data >> 24;
+                if (type < TYPE_COUNT && (query.type_mask & (1u << type)) != 0u)
+                    local_counts[type]++;
+            }
+        }
+    }
+
+    uint base = query_index * 8;
+    if (!sweep) {
+        for (int k = 0; k < TYPE_COUNT; k++)
+            if (local_counts[k] > 0u)
+                atomicAdd(type_counts[k], local_counts[k]);
+        barrier();
+        if (lid < TYPE_COUNT)
+            results[base + lid] = type_counts[lid];
+        return;
+    }
+
+    // positive floats order like their bits
+    atomicMin(best_bits, floatBitsToUint(local_best));
+    barrier();
+    if (local_best < NO_HIT && floatBitsToUint(local_best) == best_bits &&
+        atomicCompSwap(winner, 0xFFFFFFFFu, lid) == 0xFFFFFFFFu) {
+        vec3 center = o + d * local_best;
+        vec3 normal = center - clamp(center, vec3(local_voxel), vec3(local_voxel) + 1.0);
+        normal = length(normal) > 1e-6 ? normalize(normal) : (len > 0.0 ? -d : vec3(0.0, 1.0, 0.0));
+        results[base + 0] = floatBitsToUint(local_best * voxelWorldProperties.scale);
+        results[base + 1] = floatBitsToUint(normal.x);
+        results[base + 2] = floatBitsToUint(normal.y);
+        results[base + 3] = floatBitsToUint(normal.z);
+        results[base + 4] = floatBitsToUint(float(local_voxel.x));
+        results[base + 5] = floatBitsToUint(float(local_voxel.y));
+        results[base + 6] = floatBitsToUint(float(local_voxel.z));
+        results[base + 7] = floatBitsToUint(float(local_type));
+    }
+    barrier();
+    if (lid == 0 && winner == 0xFFFFFFFFu) {
+        results[base + 0] = floatBitsToUint(-1.0);
+        for (int k = 1; k < 8; k++)
+            results[base + k] = 0u;
+    }
+}
@@ -0,0 +1,84 @@
+#[compute]
+#version 460
+
+// Upscales the ray marched image from the render resolution to the output resolution. Spatial: a bilinear
+// sample of the render target, shifted by the sub-pixel jitter of this frame. Temporal: the previous output,
+// reprojected with the depth of the pixel, clamped to the colors around it and blended in.
+
+#define MODE_RESOLVE 0u       // render target + history -> output
+#define MODE_STORE_HISTORY 1u // output -> history, for the next frame
+
+layout(set = 1, binding = 0, rgba32f) restrict uniform readonly image2D renderImage;
+layout(set = 1, binding = 1, r32f) restrict uniform readonly image2D depthBuffer;
+layout(set = 1, binding = 2, rgba32f) restrict uniform image2D outputImage;
+layout(set = 1, binding = 3, rgba32f) restrict uniform image2D historyImage;
+
+layout(std430, set = 1, binding = 4) restrict readonly buffer UpscaleParams {
+    mat4 prev_view_projection;  // without jitter
+    mat4 inv_view_projection;   // this frame, without jitter
+    vec4 camera_position;
+    ivec2 render_size;
+    ivec2 output_size;
+    vec2 jitter;                // render pixels, y down
+    float history_weight;       // 0 disables the temporal part
+    float far;
+    uint mode;
+    uint history_valid;
+} params;
+
+vec3 loadRender(ivec2 p) {
+    return imageLoad(renderImage, clamp(p, ivec2(0), params.render_size - 1)).rgb;
+}
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x >= params.output_size.x || pixel.y >= params.output_size.y) return;
+
+    if (params.mode == MODE_STORE_HISTORY) {
+        imageStore(historyImage, pixel, imageLoad(outputImage, pixel));
+        return;
+    }
+
+    vec2 uv = (vec2(pixel) + 0.5) / vec2(params.output_size);
+
+    // render pixel p was shaded at screen position p + 0.5 - jitter
+    vec2 source = uv * vec2(params.render_size) - 0.5 + params.jitter;
+    ivec2 p0 = ivec2(floor(source));
+    vec2 f = source - vec2(p0);
+    vec3 color = mix(mix(loadRender(p0), loadRender(p0 + ivec2(1, 0)), f.x),
+                     mix(loadRender(p0 + ivec2(0, 1)), loadRender(p0 + ivec2(1, 1)), f.x), f.y);
+
+    if (params.history_weight > 0.0 && params.history_valid != 0u) {
+        // the colors around the nearest render pixel bound the history, so disocclusions do not ghost
+        ivec2 center = clamp(ivec2(source + 0.5), ivec2(0), params.render_size - 1);
+        vec3 lo = vec3(1e20), hi = vec3(-1e20);
+        for (int y = -1; y <= 1; ++y)
+            for (int x = -1; x <= 1; ++x) {
+                vec3 c = loadRender(center + ivec2(x, y));
+                lo = min(lo, c);
+                hi = max(hi, c);
+            }
+
+        // same ray as voxel_renderer_new.glsl, without the jitter
+        vec4 ndc = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+        ndc.y = -ndc.y;
+        vec4 target = params.inv_view_projection * ndc;
+        vec3 ray_dir = normalize(target.xyz / target.w - params.camera_position.xyz);
+        float depth = min(imageLoad(depthBuffer, center).r, params.far);
+        vec3 world_pos = params.camera_position.xyz + ray_dir * depth;
+
+        vec4 prev_clip = params.prev_view_projection * vec4(world_pos, 1.0);
+        if (prev_clip.w > 0.0) {
+            vec2 prev_ndc = prev_clip.xy / prev_clip.w;
+            prev_ndc.y = -prev_ndc.y;
+            vec2 prev_uv = prev_ndc * 0.5 + 0.5;
+            if (all(greaterThanEqual(prev_uv, vec2(0.0))) && all(lessThan(prev_uv, vec2(1.0)))) {
+                vec3 history = imageLoad(historyImage, ivec2(prev_uv * vec2(params.output_size))).rgb;
+                color = mix(color, clamp(history, lo, hi), params.history_weight);
+            }
+        }
+    }
+
+    imageStore(outputImage, pixel, vec4(color, 1.0));
+}
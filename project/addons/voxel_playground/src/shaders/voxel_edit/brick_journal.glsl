@@ -0,0 +1,94 @@
+#[compute]
+#version 460
+
+#include "../utility.glsl"
+#include "../voxel_world.glsl"
+
+// Copy-on-write undo journal. Before an edit the bricks it touches are copied into a ring of history slots,
+// undo and redo swap a slot range with the world, so the same entry flips between the before and after state.
+
+#define MODE_GATHER_RAYCAST 0u // fill the slot bricks from the hit position of a raycast edit
+#define MODE_SAVE 1u           // world -> slots
+#define MODE_SWAP 2u           // world <-> slots
+
+#define INVALID_BRICK 0xFFFFFFFFu
+
+layout(std430, set = 1, binding = 0) restrict readonly buffer JournalParams {
+    uint mode;
+    uint first_slot;
+    uint slot_count;
+    uint capacity;
+    ivec4 gather_size;  // bricks per axis covered by a raycast edit
+    float gather_radius;
+} params;
+
+// brick index stored in every slot
+layout(std430, set = 1, binding = 1) restrict buffer JournalBricks {
+    uint slotBricks[];
+};
+
+layout(std430, set = 1, binding = 2) restrict buffer JournalVoxels {
+    uint slotVoxels[];
+};
+
+layout(std430, set = 1, binding = 3) restrict buffer JournalOccupancy {
+    uint slotOccupancy[];
+};
+
+// params of the raycast edit, see sphere_edit.glsl
+layout(std430, set = 1, binding = 4) restrict readonly buffer EditParams {
+    vec4 camera_origin;
+    vec4 camera_direction;
+    vec4 hit_position;
+} editParams;
+
+void gatherRaycastBricks(uint i) {
+    uint slot = (params.first_slot + i) % params.capacity;
+    ivec3 n = params.gather_size.xyz;
+    ivec3 local_brick = ivec3(int(i) % n.x, (int(i) / n.x) % n.y, int(i) / (n.x * n.y));
+
+    // same voxel range as sphere_edit.glsl dispatches over
+    ivec3 min_voxel = ivec3(editParams.hit_position.xyz) - ivec3(params.gather_radius);
+    ivec3 rounding = ivec3(lessThan(min_voxel, ivec3(0))) * (BRICK_EDGE_LENGTH - 1);
+    ivec3 brick = (min_voxel - rounding) / BRICK_EDGE_LENGTH + local_brick; // floor division
+    bool valid = editParams.hit_position.w >= 0.0 && all(greaterThanEqual(brick, ivec3(0))) &&
+                 all(lessThan(brick, voxelWorldProperties.brick_grid_size.xyz));
+    slotBricks[slot] = valid ? getBrickIndex(brick * BRICK_EDGE_LENGTH) : INVALID_BRICK;
+}
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;
+void main() {
+    uint lid = gl_LocalInvocationIndex;
+
+    if (params.mode == MODE_GATHER_RAYCAST) {
+        uint i = gl_WorkGroupID.x * BRICK_VOLUME + lid;
+        if (i < params.slot_count)
+            gatherRaycastBricks(i);
+        return;
+    }
+
+    // one workgroup per slot, one thread per voxel
+    if (gl_WorkGroupID.x >= params.slot_count) return;
+    uint slot = (params.first_slot + gl_WorkGroupID.x) % params.capacity;
+    uint brick_index = slotBricks[slot];
+    if (brick_index == INVALID_BRICK) return;
+
+    // bricks are copied verbatim, the voxel order inside does not matter
+    uint voxel_index = voxelBricks[brick_index].voxel_data_pointer * BRICK_VOLUME + lid;
+    uint slot_index = slot * BRICK_VOLUME + lid;
+    uint world_voxel = getVoxel(voxel_index).data;
+
+    if (params.mode == MODE_SAVE) {
+        slotVoxels[slot_index] = world_voxel;
+        if (lid == 0)
+            slotOccupancy[slot] = voxelBricks[brick_index].occupancy_count;
+    } else if (params.mode == MODE_SWAP) {
+        setBothVoxelBuffers(voxel_index, Voxel(slotVoxels[slot_index]));
+        slotVoxels[slot_index] = world_voxel;
+        if (lid == 0) {
+            uint occupancy = voxelBricks[brick_index].occupancy_count;
+            voxelBricks[brick_index].occupancy_count = slotOccupancy[slot];
+            slotOccupancy[slot] = occupancy;
+        }
+    }
+}
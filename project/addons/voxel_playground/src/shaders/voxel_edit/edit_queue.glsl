@@ -0,0 +1,160 @@
+#[compute]
+#version 460
+
+#include "../utility.glsl"
+#include "../voxel_world.glsl"
+#include "edit_shapes.glsl"
+
+// Applies all edits queued during a frame in one dispatch. The CPU expands every edit into the bricks it touches
+// and groups them per brick, one workgroup handles one brick and applies its edits in submission order.
+
+layout(std430, set = 1, binding = 0) restrict readonly buffer EditCommands {
+    VoxelEditCommand edits[];
+};
+
+// x: brick index, y: first entry in editRefs, z: number of edits touching the brick
+layout(std430, set = 1, binding = 1) restrict readonly buffer EditJobs {
+    uvec4 jobs[];
+};
+
+// edit indices, EDIT_COVERS_BRICK is set when the edit contains the whole brick
+layout(std430, set = 1, binding = 2) restrict readonly buffer EditRefs {
+    uint editRefs[];
+};
+
+#define EDIT_COVERS_BRICK 0x80000000u
+#define EDIT_INDEX_MASK 0x7FFFFFFFu
+
+// stamp voxels linearized in x, y, z order
+layout(std430, set = 1, binding = 3) restrict readonly buffer StampVoxels {
+    uint stampVoxels[];
+};
+
+#define PARTICLE_BINDING 4
+#include "../particles/particle_pool.glsl"
+
+// one in EJECT_RATIO removed voxels becomes debris
+#define EJECT_RATIO 6u
+
+shared int occupancy_delta;
+shared int occupancy_after_clear;
+
+Voxel createEditVoxel(uint value, ivec3 world_pos) {
+    if (value == 1)
+        return createRockVoxel(world_pos);
+    if (value == 2)
+        return createSandVoxel(world_pos);
+    if (value == 3)
+        return createWaterVoxel(world_pos);
+    if (value == 4)
+        return createLavaVoxel(world_pos);
+    return createAirVoxel();
+}
+
+// same rule as sphere_edit.glsl: a shape only replaces voxels whose air-ness it changes
+void applyShapeEdit(VoxelEditCommand edit, ivec3 world_pos, inout Voxel voxel) {
+    Voxel target = createEditVoxel(edit.value, world_pos);
+    if (!(isVoxelAir(voxel) ^^ isVoxelAir(target)))
+        return;
+
+    if (isVoxelAir(target) && edit.eject_speed > 0.0 &&
+        hash(uvec4(uvec3(world_pos), uint(voxelWorldProperties.frame))).x % EJECT_RATIO == 0u) {
+        vec3 outward = vec3(world_pos) - edit.a.xyz;
+        outward = (dot(outward, outward) > 0.0 ? normalize(outward) : vec3(0.0)) + vec3(0.0, 0.5, 0.0);
+        spawnParticle(vec3(world_pos) + vec3(0.5), normalize(outward) * edit.eject_speed, voxel);
+    }
+    voxel = target;
+}
+
+void applyEdit(VoxelEditCommand edit, bool covers_brick, ivec3 world_pos, inout Voxel voxel) {
+    if (edit.shape == EDIT_SHAPE_STAMP) {
+        ivec3 local_pos = world_pos - ivec3(edit.a.xyz);
+        ivec3 size = ivec3(edit.b.xyz);
+        if (any(lessThan(local_pos, ivec3(0))) || any(greaterThanEqual(local_pos, size)))
+            return;
+        Voxel stamp = Voxel(stampVoxels[edit.stamp_offset + local_pos.x + local_pos.y * size.x + local_pos.z * size.x * size.y]);
+        if (!isVoxelAir(stamp))
+            voxel = stamp;
+    } else if (covers_brick || sdEdit(edit, vec3(world_pos)) < 0.0) {
+        applyShapeEdit(edit, world_pos, voxel);
+    }
+}
+
+// A plain carve covering the brick leaves only air behind, whatever came before it. Returns the position in the
+// brick's edit list after the last such carve, or 0 if there is none.
+uint findLastClear(uvec4 job) {
+    for (uint i = job.z; i > 0; --i) {
+        uint ref = editRefs[job.y + i - 1];
+        VoxelEditCommand edit = edits[ref & EDIT_INDEX_MASK];
+        if ((ref & EDIT_COVERS_BRICK) != 0u && edit.value == 0u && edit.eject_speed <= 0.0)
+            return i;
+    }
+    return 0u;
+}
+
+// A fill covering the brick leaves no air behind: it fills every air voxel and the others were not air already.
+// When it is the last edit of the brick, the brick ends up full whatever came before it.
+bool endsWithFill(uvec4 job) {
+    uint ref = editRefs[job.y + job.z - 1];
+    return (ref & EDIT_COVERS_BRICK) != 0u && !isVoxelAir(createEditVoxel(edits[ref & EDIT_INDEX_MASK].value, ivec3(0)));
+}
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;
+void main() {
+    uvec4 job = jobs[gl_WorkGroupID.x];
+    uint brick_index = job.x;
+    uint occupancy = voxelBricks[brick_index].occupancy_count;
+
+    // whole-brick fast paths: everything up to the last covering carve is skipped and the brick starts out as air,
+    // and a brick that ends with a covering fill is full without counting
+    uint first = findLastClear(job);
+    bool cleared = first > 0u;
+    bool filled = endsWithFill(job);
+    if (cleared && first == job.z && occupancy == 0u)
+        return; // carving through empty space
+    if (filled && job.z == 1u && occupancy == BRICK_VOLUME)
+        return; // filling a full brick
+
+    if (gl_LocalInvocationIndex == 0) {
+        occupancy_delta = 0;
+        occupancy_after_clear = 0;
+    }
+    barrier();
+
+    ivec3 brick_grid_size = voxelWorldProperties.brick_grid_size.xyz;
+    int b = int(brick_index);
+    ivec3 brick_pos = ivec3(b % brick_grid_size.x, (b / brick_grid_size.x) % brick_grid_size.y,
+                            b / (brick_grid_size.x * brick_grid_size.y));
+    ivec3 world_pos = brick_pos * BRICK_EDGE_LENGTH + ivec3(gl_LocalInvocationID.xyz);
+    uint voxel_index = voxelBricks[brick_index].voxel_data_pointer * BRICK_VOLUME + getVoxelIndexInBrick(world_pos);
+
+    // an empty brick holds only air, there is nothing to read
+    Voxel original = cleared || occupancy == 0u ? createAirVoxel() : getVoxel(voxel_index);
+    Voxel voxel = original;
+    for (uint i = first; i < job.z; ++i) {
+        uint ref = editRefs[job.y + i];
+        applyEdit(edits[ref & EDIT_INDEX_MASK], (ref & EDIT_COVERS_BRICK) != 0u, world_pos, voxel);
+    }
+
+    // every voxel is written at most once, however many edits overlap it
+    if (cleared) {
+        setBothVoxelBuffers(voxel_index, voxel);
+        if (!filled && !isVoxelAir(voxel))
+            atomicAdd(occupancy_after_clear, 1);
+    } else if (voxel.data != original.data) {
+        setBothVoxelBuffers(voxel_index, voxel);
+        if (!filled && isVoxelAir(original) != isVoxelAir(voxel))
+            atomicAdd(occupancy_delta, isVoxelAir(voxel) ? -1 : 1);
+    }
+    barrier();
+
+    // the brick belongs to this workgroup alone, so a cleared or filled brick can store its count directly
+    if (gl_LocalInvocationIndex == 0) {
+        if (filled)
+            voxelBricks[brick_index].occupancy_count = BRICK_VOLUME;
+        else if (cleared)
+            voxelBricks[brick_index].occupancy_count = uint(occupancy_after_clear);
+        else if (occupancy_delta != 0)
+            atomicAdd(voxelBricks[brick_index].occupancy_count, uint(occupancy_delta));
+    }
+}
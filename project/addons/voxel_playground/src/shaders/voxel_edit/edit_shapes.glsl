@@ -0,0 +1,118 @@
+#ifndef EDIT_SHAPES_GLSL
+#define EDIT_SHAPES_GLSL
+
+// Signed distance functions of the edit primitives, in voxels. Negative inside.
+// Mirrored on the CPU in voxel_edit_shapes.h, which uses them to cull and classify bricks: keep both in sync.
+
+#define EDIT_SHAPE_SPHERE 0u
+#define EDIT_SHAPE_BOX 1u
+#define EDIT_SHAPE_STAMP 2u
+#define EDIT_SHAPE_CAPSULE 3u
+#define EDIT_SHAPE_CYLINDER 4u
+#define EDIT_SHAPE_CONE 5u
+#define EDIT_SHAPE_SMOOTH_UNION 6u    // two spheres blended together
+#define EDIT_SHAPE_SMOOTH_SUBTRACT 7u // sphere a with sphere b carved out, blended
+
+struct VoxelEditCommand {
+    vec4 a;            // centre / segment start / stamp min corner. w: radius
+    vec4 b;            // box half extents / segment end / stamp size / second sphere. w: second radius
+    uint shape;
+    uint value;        // material id, unused for stamps
+    float eject_speed; // voxels / s, > 0 throws part of the removed voxels out as particles
+    uint stamp_offset; // first voxel of the stamp in stampVoxels
+    float smoothness;  // blend distance of the smooth shapes
+    float _pad0;
+    float _pad1;
+    float _pad2;
+};
+
+float sdSphere(vec3 p, vec3 center, float radius) {
+    return length(p - center) - radius;
+}
+
+float sdBox(vec3 p, vec3 center, vec3 half_extents) {
+    vec3 q = abs(p - center) - half_extents;
+    return length(max(q, vec3(0.0))) + min(max(q.x, max(q.y, q.z)), 0.0);
+}
+
+float sdCapsule(vec3 p, vec3 a, vec3 b, float radius) {
+    vec3 pa = p - a;
+    vec3 ba = b - a;
+    float h = clamp(dot(pa, ba) / max(dot(ba, ba), 1e-6), 0.0, 1.0);
+    return length(pa - ba * h) - radius;
+}
+
+// one voxel thick disc in the xz plane, what cylinders and cones with a zero-length axis become
+float sdDisc(vec3 p, vec3 center, float radius) {
+    vec2 d = vec2(length(p.xz - center.xz) - radius, abs(p.y - center.y) - 0.5);
+    return min(max(d.x, d.y), 0.0) + length(max(d, vec2(0.0)));
+}
+
+float sdCylinder(vec3 p, vec3 a, vec3 b, float radius) {
+    vec3 ba = b - a;
+    vec3 pa = p - a;
+    float baba = dot(ba, ba);
+    if (baba < 1e-6)
+        return sdDisc(p, a, radius);
+    float paba = dot(pa, ba);
+    float x = length(pa * baba - ba * paba) - radius * baba;
+    float y = abs(paba - baba * 0.5) - baba * 0.5;
+    float x2 = x * x;
+    float y2 = y * y * baba;
+    float d = (max(x, y) < 0.0) ? -min(x2, y2) : (((x > 0.0) ? x2 : 0.0) + ((y > 0.0) ? y2 : 0.0));
+    return sign(d) * sqrt(abs(d)) / baba;
+}
+
+float sdCone(vec3 p, vec3 a, vec3 b, float ra, float rb) {
+    float rba = rb - ra;
+    float baba = dot(b - a, b - a);
+    if (baba < 1e-6)
+        return sdDisc(p, a, max(ra, rb));
+    float papa = dot(p - a, p - a);
+    float paba = dot(p - a, b - a) / baba;
+    float x = sqrt(max(papa - paba * paba * baba, 0.0));
+    float cax = max(0.0, x - ((paba < 0.5) ? ra : rb));
+    float cay = abs(paba - 0.5) - 0.5;
+    float k = rba * rba + baba;
+    float f = clamp((rba * (x - ra) + paba * baba) / k, 0.0, 1.0);
+    float cbx = x - ra - f * rba;
+    float cby = paba - f;
+    float s = (cbx < 0.0 && cay < 0.0) ? -1.0 : 1.0;
+    return s * sqrt(min(cax * cax + cay * cay * baba, cbx * cbx + cby * cby * baba));
+}
+
+float smoothMin(float d1, float d2, float k) {
+    if (k <= 0.0)
+        return min(d1, d2);
+    float h = max(k - abs(d1 - d2), 0.0) / k;
+    return min(d1, d2) - h * h * k * 0.25;
+}
+
+float smoothMax(float d1, float d2, float k) {
+    return -smoothMin(-d1, -d2, k);
+}
+
+// stamps are not an sdf, they only report their bounding box
+float sdEdit(VoxelEditCommand edit, vec3 p) {
+    switch (edit.shape) {
+    case EDIT_SHAPE_SPHERE:
+        return sdSphere(p, edit.a.xyz, edit.a.w);
+    case EDIT_SHAPE_BOX:
+        return sdBox(p, edit.a.xyz, edit.b.xyz);
+    case EDIT_SHAPE_STAMP:
+        return sdBox(p, edit.a.xyz + 0.5 * (edit.b.xyz - 1.0), 0.5 * edit.b.xyz);
+    case EDIT_SHAPE_CAPSULE:
+        return sdCapsule(p, edit.a.xyz, edit.b.xyz, edit.a.w);
+    case EDIT_SHAPE_CYLINDER:
+        return sdCylinder(p, edit.a.xyz, edit.b.xyz, edit.a.w);
+    case EDIT_SHAPE_CONE:
+        return sdCone(p, edit.a.xyz, edit.b.xyz, edit.a.w, edit.b.w);
+    case EDIT_SHAPE_SMOOTH_UNION:
+        return smoothMin(sdSphere(p, edit.a.xyz, edit.a.w), sdSphere(p, edit.b.xyz, edit.b.w), edit.smoothness);
+    case EDIT_SHAPE_SMOOTH_SUBTRACT:
+        return smoothMax(sdSphere(p, edit.a.xyz, edit.a.w), -sdSphere(p, edit.b.xyz, edit.b.w), edit.smoothness);
+    }
+    return 1.0;
+}
+
+#endif // EDIT_SHAPES_GLSL
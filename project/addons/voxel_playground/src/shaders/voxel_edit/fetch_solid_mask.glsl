@@ -4,37 +4,42 @@
 #include "../utility.glsl"
 #include "../voxel_world.glsl"
 
-layout(std430, set = 1, binding = 0) restrict buffer Params {
-    ivec4 bounds_min; //min corner in voxels
-    ivec4 bounds_size; //size in voxels
+// Solid masks of collider chunks, one workgroup per brick aligned chunk. Every chunk gets 512 bits (16 uints),
+// bit x + y * 8 + z * 64.
+
+layout(std430, set = 1, binding = 0) restrict readonly buffer Params {
+    uint chunk_count;
 } params;
 
-layout(std430, set = 1, binding = 1) restrict buffer Result {
+layout(std430, set = 1, binding = 1) restrict readonly buffer Chunks {
+    ivec4 chunk_min[]; // min corner in voxels
+};
+
+layout(std430, set = 1, binding = 2) restrict writeonly buffer Result {
     uint data[];
 } result;
 
-uint posToResultIndex(ivec3 pos) {
-    return uint(pos.x + pos.y * params.bounds_size.x + pos.z * params.bounds_size.x * params.bounds_size.y);
-}
+shared uint chunk_bits[16];
 
 layout(local_size_x = 8, local_size_y = 8, local_size_z = 8) in;
 void main() {
-    ivec3 pos = ivec3(gl_GlobalInvocationID.xyz);
-    if(pos.x >= params.bounds_size.x || pos.y >= params.bounds_size.y || pos.z >= params.bounds_size.z) {
-        return; //out of bounds
-    }
-    ivec3 world_pos = params.bounds_min.xyz + pos;
-
-    uint index = posToResultIndex(pos);
-    uint bit_index = index % 32;
-    uint data_index = index / 32;
-
-    Voxel voxel_value = getVoxel(posToIndex(world_pos));
-
-    if (!isValidPos(world_pos) || !isVoxelSolid(voxel_value)) {
-        atomicAnd(result.data[data_index], ~(1u << bit_index));
-    } else {
-        atomicOr(result.data[data_index], 1u << bit_index);
+    uint chunk = gl_WorkGroupID.x;
+    if (chunk >= params.chunk_count) return;
+    uint lid = gl_LocalInvocationIndex; // x + y * 8 + z * 64
+
+    if (lid < 16)
+        chunk_bits[lid] = 0u;
+    barrier();
+
+    ivec3 brick_min = chunk_min[chunk].xyz;
+    // the whole workgroup agrees on this, chunks outside the world or on empty bricks stay zero
+    if (isValidPos(brick_min) && voxelBricks[getBrickIndex(brick_min)].occupancy_count > 0u) {
+        ivec3 world_pos = brick_min + ivec3(gl_LocalInvocationID);
+        if (isVoxelSolid(getVoxel(posToIndex(world_pos))))
+            atomicOr(chunk_bits[lid >> 5], 1u << (lid & 31u));
     }
+    barrier();
 
+    if (lid < 16)
+        result.data[chunk * 16 + lid] = chunk_bits[lid];
 }
@@ -21,6 +21,8 @@ layout(std430, set = 1, binding = 2) restrict buffer Params {
     int width;
     int height;
     float fov;
+    int beam_prepass;
+    int object_binning;
 } params;
 
 layout(std430, set = 1, binding = 3) restrict buffer Camera {
@@ -37,18 +39,12 @@ layout(std430, set = 1, binding = 4) restrict buffer ProjectileParams {
     int projectile_count;
 } projectileParams;
 
-// Packed as vec4(x, y, z, radius) per projectile, up to MAX_PROJECTILES (defined at compile time)
-#ifndef MAX_PROJECTILES
-#define MAX_PROJECTILES 64
-#endif
+// Packed as vec4(x, y, z, radius) per projectile, the buffer grows with the number of projectiles
 layout(std430, set = 1, binding = 5) restrict buffer ProjectileSpheres {
-    vec4 projectile_spheres[MAX_PROJECTILES];
+    vec4 projectile_spheres[];
 } projectileData;
 
 // -------------------------- ENTITIES (voxel-based) --------------------------
-#ifndef MAX_ENTITIES
-#define MAX_ENTITIES 32
-#endif
 
 struct EntityDescriptor {
     mat4 local_to_world;
@@ -79,9 +75,194 @@ layout(std430, set = 1, binding = 8) restrict buffer EntityVoxelsBuf {
 };
 
 layout(std430, set = 1, binding = 9) restrict buffer EntityDescriptors {
-    EntityDescriptor entities[MAX_ENTITIES];
+    EntityDescriptor entities[];
 } entityDesc;
 
+// projectiles and entities per tile of this shader's workgroups, written by object_binning.glsl
+#define OBJECT_BINS_BINDING 11
+#include "object_bins.glsl"
+
+// bounds of all projectiles and entities, for the tiles the binning overflowed and for shadow rays
+#define OBJECT_BVH_BINDING 12
+#include "object_bvh.glsl"
+
+// distance along the ray each BEAM_TILE_SIZE^2 tile can skip, written by beam_prepass.glsl
+#define BEAM_TILE_SIZE 8
+layout(set = 1, binding = 10, r32f) restrict uniform readonly image2D beamImage;
+
+// -------------------------- OBJECT INTERSECTION --------------------------
+
+struct ObjectHit {
+    float t_sphere;
+    vec3 n_sphere;
+    bool hit_sphere;
+    float t_entity;
+    vec3 entity_color;
+    vec3 n_entity;
+    bool hit_entity;
+};
+
+ObjectHit noObjectHit() {
+    return ObjectHit(1e20, vec3(0.0), false, 1e20, vec3(0.0), vec3(0.0), false);
+}
+
+// keeps the closest projectile hit
+void intersectProjectile(int i, vec3 ray_origin, vec3 ray_dir, inout ObjectHit hit) {
+    vec3 c = projectileData.projectile_spheres[i].xyz;
+    float r = projectileData.projectile_spheres[i].w;
+    // Ray-sphere intersection (analytic)
+    vec3 oc = ray_origin - c;
+    float b = dot(oc, ray_dir);
+    float c_term = dot(oc, oc) - r * r;
+    float disc = b*b - c_term;
+    if (disc >= 0.0) {
+        float s = sqrt(disc);
+        float t0 = -b - s;
+        float t1 = -b + s;
+        float t_candidate = (t0 > 0.0) ? t0 : ((t1 > 0.0) ? t1 : 1e20);
+        if (t_candidate > camera.near && t_candidate < camera.far && t_candidate < hit.t_sphere) {
+            hit.t_sphere = t_candidate;
+            vec3 hp = ray_origin + t_candidate * ray_dir;
+            hit.n_sphere = normalize(hp - c);
+            hit.hit_sphere = true;
+        }
+    }
+}
+
+vec3 safeInverseDirection(vec3 ray_dir) {
+    const float eps = 1e-7;
+    vec3 safe_dir = ray_dir;
+    safe_dir.x = abs(safe_dir.x) < eps ? (safe_dir.x >= 0.0 ? eps : -eps) : safe_dir.x;
+    safe_dir.y = abs(safe_dir.y) < eps ? (safe_dir.y >= 0.0 ? eps : -eps) : safe_dir.y;
+    safe_dir.z = abs(safe_dir.z) < eps ? (safe_dir.z >= 0.0 ? eps : -eps) : safe_dir.z;
+    return 1.0 / safe_dir;
+}
+
+#define MAX_ENTITY_BRICK_STEPS 64
+
+Voxel entityVoxel(EntityDescriptor ent, Brick brick, ivec3 cell) {
+    return entityVoxels[ent.voxel_offset + brick.voxel_data_pointer * BRICK_VOLUME + getVoxelIndexInBrick(cell)];
+}
+
+// Voxel DDA through one occupied brick of an entity. Everything is in the voxel grid of the entity, t is the ray
+// parameter, the same along the world ray and the grid ray, and [t_in, t_out] is the part inside the brick.
+bool traceEntityBrick(EntityDescriptor ent, Brick brick, ivec3 brick_pos, vec3 origin, vec3 dir, vec3 inv_dir,
+                      float t_in, float t_out, inout vec3 normal, out ivec3 cell, out float t) {
+    ivec3 lo = brick_pos * BRICK_EDGE_LENGTH;
+    ivec3 hi = lo + BRICK_EDGE_LENGTH - 1;
+    cell = clamp(ivec3(floor(origin + dir * t_in)), lo, hi);
+    ivec3 step_dir = ivec3(sign(inv_dir));
+    vec3 t_delta = abs(inv_dir);
+    vec3 t_max = (vec3(cell) + step(vec3(0.0), inv_dir) - origin) * inv_dir;
+    t = t_in;
+    for (int i = 0; i < 3 * BRICK_EDGE_LENGTH; ++i) {
+        if (!isVoxelAir(entityVoxel(ent, brick, cell))) return true;
+        float t_next = min(min(t_max.x, t_max.y), t_max.z);
+        if (t_next >= t_out) break;
+        vec3 mask = t_max.x == t_next ? vec3(1, 0, 0) : (t_max.y == t_next ? vec3(0, 1, 0) : vec3(0, 0, 1));
+        t = t_next;
+        t_max += mask * t_delta;
+        cell += ivec3(mask) * step_dir;
+        normal = -mask * vec3(step_dir);
+        if (any(lessThan(cell, lo)) || any(greaterThan(cell, hi))) break;
+    }
+    return false;
+}
+
+// Brick DDA over the brick grid of an entity between t_enter and t_exit, only occupied bricks are traced further.
+bool traceEntity(EntityDescriptor ent, vec3 origin, vec3 dir, float t_enter, float t_exit, inout vec3 normal,
+                 out Voxel voxel, out float t) {
+    vec3 inv_dir = safeInverseDirection(dir);
+    ivec3 brick_grid = ivec3(ent.brick_grid_size.xyz);
+    ivec3 brick_pos = clamp(ivec3(floor((origin + dir * t_enter) / BRICK_EDGE_LENGTH)), ivec3(0), brick_grid - 1);
+    ivec3 step_dir = ivec3(sign(inv_dir));
+    vec3 t_delta = abs(inv_dir) * BRICK_EDGE_LENGTH;
+    vec3 t_max = ((vec3(brick_pos) + step(vec3(0.0), inv_dir)) * BRICK_EDGE_LENGTH - origin) * inv_dir;
+    float t_brick = t_enter;
+    for (int i = 0; i < MAX_ENTITY_BRICK_STEPS && t_brick < t_exit; ++i) {
+        Brick brick = entityBricks[ent.brick_offset + uint(brick_pos.x + brick_grid.x * (brick_pos.y + brick_grid.y * brick_pos.z))];
+        float t_next = min(min(t_max.x, t_max.y), t_max.z);
+        ivec3 cell;
+        if (brick.occupancy_count > 0u &&
+            traceEntityBrick(ent, brick, brick_pos, origin, dir, inv_dir, t_brick, min(t_next, t_exit), normal, cell, t)) {
+            voxel = entityVoxel(ent, brick, cell);
+            return true;
+        }
+        vec3 mask = t_max.x == t_next ? vec3(1, 0, 0) : (t_max.y == t_next ? vec3(0, 1, 0) : vec3(0, 0, 1));
+        t_brick = t_next;
+        t_max += mask * t_delta;
+        brick_pos += ivec3(mask) * step_dir;
+        normal = -mask * vec3(step_dir);
+        if (any(lessThan(brick_pos, ivec3(0))) || any(greaterThanEqual(brick_pos, brick_grid))) break;
+    }
+    return false;
+}
+
+// keeps the closest entity hit
+void intersectEntity(int eid, vec3 ray_origin, vec3 ray_dir, inout ObjectHit hit) {
+    EntityDescriptor ent = entityDesc.entities[eid];
+
+    if (ent.enabled == 0u) return;
+
+    // the ray in the voxel grid of the entity: into the oriented box, then voxel units from its min corner
+    vec3 origin = ((ent.world_to_local * vec4(ray_origin, 1.0)).xyz - ent.aabb_min.xyz) / ent.scale;
+    vec3 dir = mat3(ent.world_to_local) * ray_dir / ent.scale;
+
+    vec3 inv_dir = safeInverseDirection(dir);
+    vec3 t0 = -origin * inv_dir;
+    vec3 t1 = (ent.grid_size.xyz - origin) * inv_dir;
+    vec3 tmin_vec = min(t0, t1);
+    vec3 tmax_vec = max(t0, t1);
+    float t_box = max(max(tmin_vec.x, tmin_vec.y), tmin_vec.z);
+    float t_enter = max(t_box, camera.near);
+    float t_exit = min(min(min(tmax_vec.x, tmax_vec.y), tmax_vec.z), hit.t_entity);
+    if (t_enter >= t_exit) return;
+
+    // a voxel on the face the ray enters through has that face's normal
+    vec3 normal = -sign(dir) * vec3(equal(tmin_vec, vec3(t_box)));
+    Voxel voxel;
+    float t;
+    if (!traceEntity(ent, origin, dir, t_enter, t_exit, normal, voxel, t)) return;
+
+    hit.t_entity = t;
+    hit.entity_color = getVoxelColor(voxel, ivec3(0));
+    hit.n_entity = normalize(transpose(mat3(ent.world_to_local)) * normal);
+    hit.hit_entity = true;
+}
+
+// Closest projectile and entity along the ray through the object BVH. With any_hit it returns at the first object
+// hit before t_max, for shadow rays.
+bool traceObjectBvh(vec3 ray_origin, vec3 ray_dir, float t_max, bool any_hit, inout ObjectHit hit) {
+    if (bvh_node_count == 0u) return false;
+
+    vec3 inv_dir = safeInverseDirection(ray_dir);
+    uint stack[BVH_STACK_SIZE];
+    int stack_size = 0;
+    stack[stack_size++] = 0u;
+    while (stack_size > 0) {
+        BvhNode node = bvh_nodes[stack[--stack_size]];
+        float t_best = min(t_max, min(hit.t_sphere, hit.t_entity));
+        if (!bvhHitsBox(node.bounds_min.xyz, node.bounds_max.xyz, ray_origin, inv_dir, t_best)) continue;
+
+        uint children[2] = uint[2](floatBitsToUint(node.bounds_min.w), floatBitsToUint(node.bounds_max.w));
+        for (int c = 0; c < 2; ++c) {
+            uint child = children[c];
+            if (child == BVH_INVALID) continue;
+            if ((child & BVH_LEAF) == 0u) {
+                if (stack_size < BVH_STACK_SIZE) stack[stack_size++] = child;
+                continue;
+            }
+            int index = int(child & BVH_INDEX_MASK);
+            if ((child & BVH_ENTITY) != 0u)
+                intersectEntity(index, ray_origin, ray_dir, hit);
+            else
+                intersectProjectile(index, ray_origin, ray_dir, hit);
+            if (any_hit && min(hit.t_sphere, hit.t_entity) < t_max) return true;
+        }
+    }
+    return hit.hit_sphere || hit.hit_entity;
+}
+
 // ----------------------------------- FUNCTIONS -----------------------------------
 
 vec3 blinnPhongShading(vec3 baseColor, vec3 normal, vec3 lightDir, vec3 lightColor, vec3 viewDir, float shadow) {
@@ -124,78 +305,34 @@ void main() {
 
     Voxel voxel;
 
-    // Check intersection with projectiles (spheres)
-    float t_sphere = 1e20;
-    vec3 n_sphere = vec3(0.0);
-    bool hit_sphere = false;
-    for (int i = 0; i < projectileParams.projectile_count && i < MAX_PROJECTILES; ++i) {
-        vec3 c = projectileData.projectile_spheres[i].xyz;
-        float r = projectileData.projectile_spheres[i].w;
-        // Ray-sphere intersection (analytic)
-        vec3 oc = ray_origin - c;
-        float b = dot(oc, ray_dir);
-        float c_term = dot(oc, oc) - r * r;
-        float disc = b*b - c_term;
-        if (disc >= 0.0) {
-            float s = sqrt(disc);
-            float t0 = -b - s;
-            float t1 = -b + s;
-            float t_candidate = (t0 > 0.0) ? t0 : ((t1 > 0.0) ? t1 : 1e20);
-            if (t_candidate > camera.near && t_candidate < camera.far && t_candidate < t_sphere) {
-                t_sphere = t_candidate;
-                vec3 hp = ray_origin + t_candidate * ray_dir;
-                n_sphere = normalize(hp - c);
-                hit_sphere = true;
-            }
-        }
-    }
-
-    // Check entity AABBs and raymarch voxels
-    float t_entity = 1e20;
-    vec3 entity_color = vec3(0);
-    vec3 n_entity = vec3(0);
-    bool hit_entity = false;
-    bool hit_any_aabb = false;  // DEBUG
-
-    for (int eid = 0; eid < entityCount.entity_count && eid < MAX_ENTITIES; ++eid) {
-        EntityDescriptor ent = entityDesc.entities[eid];
-
-        if (ent.enabled == 0u) continue;
-
-        // Extract entity world position from local_to_world matrix (column 3)
-        vec3 entity_world_pos = vec3(ent.local_to_world[3][0], ent.local_to_world[3][1], ent.local_to_world[3][2]);
-
-        // World-space AABB (no rotation support yet)
-        vec3 aabb_min = entity_world_pos + ent.aabb_min.xyz;
-        vec3 aabb_max = entity_world_pos + ent.aabb_max.xyz;
-
-        // AABB ray intersection
-        const float eps = 1e-7;
-        vec3 safe_dir = ray_dir;
-        safe_dir.x = abs(safe_dir.x) < eps ? (safe_dir.x >= 0.0 ? eps : -eps) : safe_dir.x;
-        safe_dir.y = abs(safe_dir.y) < eps ? (safe_dir.y >= 0.0 ? eps : -eps) : safe_dir.y;
-        safe_dir.z = abs(safe_dir.z) < eps ? (safe_dir.z >= 0.0 ? eps : -eps) : safe_dir.z;
-
-        vec3 inv_dir = 1.0 / safe_dir;
-        vec3 t0 = (aabb_min - ray_origin) * inv_dir;
-        vec3 t1 = (aabb_max - ray_origin) * inv_dir;
-        vec3 tmin_vec = min(t0, t1);
-        vec3 tmax_vec = max(t0, t1);
-        float tmin = max(max(tmin_vec.x, tmin_vec.y), tmin_vec.z);
-        float tmax = min(min(tmax_vec.x, tmax_vec.y), tmax_vec.z);
-
-        // Check for valid intersection
-        if (tmin <= tmax && tmax > 0.0) {
-            // Hit! Render colored box
-            entity_color = vec3(0.0, 1.0, 0.0);  // Green
-            t_entity = max(tmin, camera.near);
-            hit_entity = true;
-            n_entity = vec3(0, 1, 0);  // Simple up normal
-            break;
-        }
+    // a workgroup is one bin tile, its pixels only test the objects binned there
+    uint bin = binOffset(ivec2(gl_WorkGroupID.xy), params.width);
+    uint bin_projectiles = params.object_binning != 0 ? tileBins[bin] : BIN_OVERFLOW;
+    uint bin_entities = params.object_binning != 0 ? tileBins[bin + 1u] : BIN_OVERFLOW;
+
+    // Check intersection with projectiles (spheres) and entity boxes
+    ObjectHit objects = noObjectHit();
+    if (bin_projectiles != BIN_OVERFLOW && bin_entities != BIN_OVERFLOW) {
+        for (uint p = 0u; p < bin_projectiles; ++p)
+            intersectProjectile(int(tileBins[bin + BIN_PROJECTILES + p]), ray_origin, ray_dir, objects);
+        for (uint e = 0u; e < bin_entities; ++e)
+            intersectEntity(int(tileBins[bin + BIN_ENTITIES + e]), ray_origin, ray_dir, objects);
+    } else {
+        // the tile overflowed or binning is off
+        traceObjectBvh(ray_origin, ray_dir, camera.far, false, objects);
     }
-
-    bool hit_world = voxelTraceWorld(ray_origin, ray_dir, vec2(camera.near, camera.far), voxel, t, grid_position, normal, step_count);
+    float t_sphere = objects.t_sphere;
+    vec3 n_sphere = objects.n_sphere;
+    bool hit_sphere = objects.hit_sphere;
+    float t_entity = objects.t_entity;
+    vec3 entity_color = objects.entity_color;
+    vec3 n_entity = objects.n_entity;
+    bool hit_entity = objects.hit_entity;
+
+    float world_start = camera.near;
+    if (params.beam_prepass != 0)
+        world_start = max(world_start, imageLoad(beamImage, pos / BEAM_TILE_SIZE).r);
+    bool hit_world = voxelTraceWorld(ray_origin, ray_dir, vec2(world_start, camera.far), voxel, t, grid_position, normal, step_count);
 
     // Proper depth-sorted compositing
     // Entity is closest if: entity hit AND (no sphere hit OR entity closer than sphere) AND (no world hit OR entity closer than world)
@@ -203,7 +340,10 @@ void main() {
     bool sphere_closest = !entity_closest && hit_sphere && (!hit_world || (hit_world && t_sphere < t));
 
     if (entity_closest) {
-        color = entity_color;
+        vec3 hitPos = ray_origin + t_entity * ray_dir;
+        vec3 sun_dir = normalize(voxelWorldProperties.sun_direction.xyz);
+        float shadow = computeShadow(hitPos, n_entity, sun_dir);
+        color = blinnPhongShading(entity_color, n_entity, sun_dir, voxelWorldProperties.sun_color.rgb, -ray_dir, shadow);
     } else if (sphere_closest) {
         // Shade projectile as emissive fireball
         vec3 hitPos = ray_origin + t_sphere * ray_dir;
@@ -232,6 +372,9 @@ void main() {
         // direct illumination
         if(emission < 1) {
             float shadow = computeShadow(hitPos, normal, voxelWorldProperties.sun_direction.xyz);
+            ObjectHit occluder = noObjectHit();
+            if (shadow > 0.0 && traceObjectBvh(hitPos + normal * 0.001, normalize(voxelWorldProperties.sun_direction.xyz), 100.0, true, occluder))
+                shadow = 0.0;
             float ao = computeAmbientOcclusion(hitPos, grid_position, normal) * 0.7 + 0.3;
             color = ao * blinnPhongShading(color, normal, normalize(voxelWorldProperties.sun_direction.xyz), voxelWorldProperties.sun_color.rgb, voxel_view_dir, shadow);
         }
@@ -246,7 +389,14 @@ void main() {
     //     color = vec3(1,0,0);
 
 
-    float depth = 0.0f;
+    // distance along the ray, used to depth test the particle splats
+    float depth = camera.far;
+    if (entity_closest)
+        depth = t_entity;
+    else if (sphere_closest)
+        depth = t_sphere;
+    else if (hit_world)
+        depth = t;
 
     imageStore(outputImage, pos, vec4(color, 1.0));
     imageStore(depthBuffer, pos, vec4(depth, 0.0, 0.0, 0.0));
@@ -334,9 +334,17 @@ func _capture_frame_profile(delta: float, frame_time_ms: float, fps: float, fram
 		profile["voxel_camera_total_render"] = _camera.get_time_total_render()
 		profile["voxel_camera_update"] = _camera.get_time_camera_update()
 		profile["voxel_camera_raymarching"] = _camera.get_time_raymarching()
+		profile["voxel_camera_upscale"] = _camera.get_time_upscale()
+		profile["voxel_camera_beam_prepass"] = _camera.get_time_beam_prepass()
+		profile["voxel_camera_object_binning"] = _camera.get_time_object_binning()
+		profile["voxel_camera_object_bvh"] = _camera.get_time_object_bvh()
+		profile["voxel_camera_render_scale"] = _camera.render_scale
 
 		# GPU timing for raymarching
 		profile["gpu_voxel_camera_raymarching"] = _camera.get_gpu_time_raymarching()
+		profile["gpu_voxel_camera_upscale"] = _camera.get_gpu_time_upscale()
+		profile["gpu_voxel_camera_beam_prepass"] = _camera.get_gpu_time_beam_prepass()
+		profile["gpu_voxel_camera_object_binning"] = _camera.get_gpu_time_object_binning()
 
 	_frame_data.append(profile)
 
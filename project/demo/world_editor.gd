@@ -6,6 +6,17 @@ extends Node3D
 
 var cooldown := 0.0
 
+func _ready() -> void:
+	world.undo_enabled = true
+
+func _unhandled_input(event: InputEvent) -> void:
+	if not (event is InputEventKey and event.pressed and not event.echo and event.ctrl_pressed):
+		return
+	if event.keycode == KEY_Z and not event.shift_pressed:
+		world.undo()
+	elif event.keycode == KEY_Y or (event.keycode == KEY_Z and event.shift_pressed):
+		world.redo()
+
 func set_selected_material(value: int) -> void:
 	selected_material = value
 
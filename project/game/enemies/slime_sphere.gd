@@ -7,12 +7,15 @@ class_name SlimeSphere
 @export var base_radius: float = 0.7
 @export var aabb_size: Vector3 = Vector3(1.4, 1.4, 1.4)  ## AABB size for entity rendering
 @export var entity_scale: float = 0.1  ## Voxel scale for entity
+@export var use_voxel_mover: bool = true  ## Move against the voxels instead of the collider mesh
 
 @onready var health: HealthComponent = null
 
 var _entity_id: int = -1
 var _voxel_camera: Node = null
 var _voxel_world: VoxelWorld = null
+var _voxel_mover: VoxelCharacterMover = null
+var _gathered: bool = false  ## a VoxelCameraGatherer pushes our transform, no per-frame update call
 
 func _ready() -> void:
     add_to_group("enemy")
@@ -29,9 +32,17 @@ func _ready() -> void:
     health.reset_health()
     health.died.connect(_on_died)
 
+    _voxel_mover = VoxelCharacterMover.new()
+    _voxel_mover.half_extents = Vector3.ONE * base_radius
+    _voxel_mover.center_offset = Vector3.ZERO
+    _voxel_mover.step_height = base_radius * 0.5
+
     # Find VoxelCamera and VoxelWorld
     _voxel_camera = get_tree().get_first_node_in_group("voxel_camera")
     _voxel_world = get_tree().get_first_node_in_group("voxel_world") as VoxelWorld
+    # without the mover the slime needs collision around it
+    if not use_voxel_mover and _voxel_world != null:
+        _voxel_world.add_collider_agent(self)
 
     # Snap to terrain before registering
     await get_tree().process_frame
@@ -46,22 +57,33 @@ func _ready() -> void:
 
 func _exit_tree() -> void:
     _unregister_vm()
+    if _voxel_world != null:
+        _voxel_world.remove_collider_agent(self)
 
 func _register_entity() -> void:
     if not (_voxel_camera and _voxel_camera.has_method("register_entity")):
         print("SlimeSphere: No VoxelCamera found or register_entity method missing")
         return
     _entity_id = _voxel_camera.register_entity(global_transform, aabb_size, entity_scale)
+    _gathered = get_tree().get_first_node_in_group("voxel_camera_gatherer") != null
     print("SlimeSphere: Registered as entity with ID ", _entity_id)
 
 func _process(delta: float) -> void:
     # Update entity transform
-    if _voxel_camera and _entity_id >= 0 and _voxel_camera.has_method("update_entity"):
+    if _voxel_camera and _entity_id >= 0 and not _gathered and _voxel_camera.has_method("update_entity"):
         _voxel_camera.update_entity(_entity_id, global_transform)
 
     _check_projectile_hits()
 
 func _physics_process(_delta: float) -> void:
+    if use_voxel_mover and _voxel_world != null:
+        if not _voxel_mover.is_on_floor():
+            velocity += get_gravity() * _delta
+        _voxel_mover.velocity = velocity
+        global_position = _voxel_mover.move_and_slide(_voxel_world, global_position, _delta)
+        velocity = _voxel_mover.velocity
+        return
+
     # Apply gravity and slide on terrain
     if not is_on_floor():
         velocity += get_gravity() * _delta
@@ -74,13 +96,10 @@ func _physics_process(_delta: float) -> void:
     if not is_on_floor() and velocity.y < 0.0 and _voxel_world != null:
         var max_step: float = absf(velocity.y) * _delta + 0.5
         var origin: Vector3 = global_position
-        var hit: Vector4 = _voxel_world.raycast_voxels(origin, Vector3.DOWN, 0.0, max(1.0, max_step))
-        if hit.w >= 0.0:
-            var scale: float = _voxel_world.get_scale()
-            var world_hit: Vector3 = Vector3(hit.x, hit.y, hit.z) * scale
-            if origin.y >= world_hit.y and (origin.y - world_hit.y) <= max_step:
-                global_position.y = world_hit.y + base_radius + 0.1
-                velocity.y = 0.0
+        var ground: float = _voxel_world.get_ground_below(origin, max_step)
+        if ground >= 0.0 and origin.y >= ground and (origin.y - ground) <= max_step:
+            global_position.y = ground + base_radius
+            velocity.y = 0.0
 
     move_and_slide()
 
@@ -90,15 +109,9 @@ func _snap_to_voxel_ground() -> void:
     if _voxel_world == null:
         return
     var pos: Vector3 = global_position
-    var start_y: float = 10000.0
-    var origin: Vector3 = Vector3(pos.x, start_y, pos.z)
-    var dir: Vector3 = Vector3.DOWN
-    var far_dist: float = start_y + 100.0
-    var hit: Vector4 = _voxel_world.raycast_voxels(origin, dir, 0.0, far_dist)
-    if hit.w >= 0.0:
-        var scale: float = _voxel_world.get_scale()
-        var world_hit: Vector3 = Vector3(hit.x, hit.y, hit.z) * scale
-        global_position = Vector3(pos.x, world_hit.y + base_radius + 0.1, pos.z)
+    var ground: float = _voxel_world.get_ground_below(Vector3(pos.x, 10000.0, pos.z), 10100.0)
+    if ground >= 0.0:
+        global_position = Vector3(pos.x, ground + base_radius, pos.z)
 
 func _check_projectile_hits() -> void:
     # Poll nearby projectiles and apply damage on overlap or explosion radius.
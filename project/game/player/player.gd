@@ -14,6 +14,16 @@ const MAX_MOVE_SPEED = 512
 
 var input_active: bool = false
 @export var is_flying: bool = false
+## Move against the voxels directly instead of the generated collider mesh. The collider only follows the
+## player while it is off, the mover does not need it. The player registers itself as a collider agent, so the
+## VoxelWorld has player_collider_agent off.
+@export var use_voxel_mover: bool = true:
+	set(value):
+		use_voxel_mover = value
+		_update_collider_agent()
+@export var voxel_mover: VoxelCharacterMover
+
+var _voxel_world: VoxelWorld = null
 
 # Component references (will be set up as child nodes in the scene)
 @onready var health_component = $HealthComponent
@@ -27,6 +37,13 @@ func _ready():
 	is_flying = false
 	# Improve ground adherence to avoid tunneling on fast falls
 	floor_snap_length = 0.6
+	_voxel_world = get_tree().get_first_node_in_group("voxel_world") as VoxelWorld
+	_update_collider_agent()
+	if voxel_mover == null:
+		# box around the capsule of the collision shape
+		voxel_mover = VoxelCharacterMover.new()
+		voxel_mover.half_extents = Vector3(0.4, 0.9, 0.4)
+		voxel_mover.center_offset = Vector3(0.0, 0.9, 0.0)
 
 	# Snap to voxel terrain top at current XZ
 	await get_tree().process_frame
@@ -96,10 +113,11 @@ func _process_flying(_delta: float) -> void:
 	velocity = direction.normalized() * fly_speed
 
 func _process_walking(delta: float) -> void:
-	if not is_on_floor():
+	var on_floor := _is_grounded()
+	if not on_floor:
 		velocity += get_gravity() * delta
 
-	if Input.is_action_just_pressed("ui_accept") and is_on_floor():
+	if Input.is_action_just_pressed("ui_accept") and on_floor:
 		velocity.y = jump_velocity
 
 	var input_dir := Input.get_vector("move_left", "move_right", "move_forward", "move_backward")
@@ -117,23 +135,39 @@ func _physics_process(delta: float) -> void:
 	else:
 		_process_walking(delta)
 
+	if use_voxel_mover and _voxel_world != null:
+		voxel_mover.velocity = velocity
+		global_position = voxel_mover.move_and_slide(_voxel_world, global_position, delta)
+		velocity = voxel_mover.velocity
+		return
+
 	# Extra safety: voxel-ground catch to prevent tunneling at high fall speeds
 	if not is_flying and not is_on_floor() and velocity.y < 0.0:
 		var vw: VoxelWorld = get_tree().get_first_node_in_group("voxel_world") as VoxelWorld
 		if vw != null:
 			var max_fall_step: float = absf(velocity.y) * delta + 0.5
 			var origin: Vector3 = global_position
-			var hit: Vector4 = vw.raycast_voxels(origin, Vector3.DOWN, 0.0, max(1.0, max_fall_step))
-			if hit.w >= 0.0:
-				var scale: float = vw.get_scale()
-				var world_hit: Vector3 = Vector3(hit.x, hit.y, hit.z) * scale
-				# Only snap if below our feet within step range
-				if origin.y >= world_hit.y and (origin.y - world_hit.y) <= max_fall_step:
-					global_position.y = world_hit.y + 0.6
-					velocity.y = 0.0
+			var ground: float = vw.get_ground_below(origin, max_fall_step)
+			# Only snap if below our feet within step range
+			if ground >= 0.0 and origin.y >= ground and (origin.y - ground) <= max_fall_step:
+				global_position.y = ground + 0.5
+				velocity.y = 0.0
 
 	move_and_slide()
 
+func _update_collider_agent() -> void:
+	if _voxel_world == null:
+		return
+	if use_voxel_mover:
+		_voxel_world.remove_collider_agent(self)
+	else:
+		_voxel_world.add_collider_agent(self)
+
+func _is_grounded() -> bool:
+	if use_voxel_mover and _voxel_world != null:
+		return voxel_mover.is_on_floor()
+	return is_on_floor()
+
 func _on_player_died():
 	print("Player died! Game over.")
 	# TODO: Show game over screen, respawn, etc.
@@ -157,18 +191,12 @@ func _snap_to_voxel_ground() -> void:
 	var vw: VoxelWorld = get_tree().get_first_node_in_group("voxel_world") as VoxelWorld
 	if vw == null:
 		return
-	# Cast from high above straight down to find first solid voxel
+	# Top of the highest solid voxel in our column
 	var pos: Vector3 = global_position
-	var start_y: float = 10000.0
-	var origin: Vector3 = Vector3(pos.x, start_y, pos.z)
-	var dir: Vector3 = Vector3.DOWN
-	var far_dist: float = start_y + 100.0
-	var hit: Vector4 = vw.raycast_voxels(origin, dir, 0.0, far_dist)
-	if hit.w >= 0.0:
-		var scale: float = vw.get_scale()
-		var world_hit: Vector3 = Vector3(hit.x, hit.y, hit.z) * scale
+	var ground: float = vw.get_ground_below(Vector3(pos.x, 10000.0, pos.z), 10100.0)
+	if ground >= 0.0:
 		# Place slightly above to avoid clipping
-		global_position = Vector3(pos.x, world_hit.y + 0.6, pos.z)
+		global_position = Vector3(pos.x, ground + 0.5, pos.z)
 
 func _debug_heal():
 	if health_component:
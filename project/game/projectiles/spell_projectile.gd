@@ -1,13 +1,14 @@
 extends Area3D
 class_name SpellProjectile
 
-## Base class for spell projectiles. Handles movement, lifetime, and collision via raycasts.
+## Base class for spell projectiles. Handles movement, lifetime, and collision via sphere sweeps and raycasts.
 
 @export var speed: float = 15.0
 @export var lifetime: float = 5.0
 @export var radius_visual: float = 0.3
 @export var explosion_radius: float = 4.0
 @export var lava_radius: float = 2.0
+@export var debris_speed: float = 8.0 ## m/s of the voxels thrown out by the explosion, 0 disables debris
 @export var damage: int = 50
 
 var _velocity: Vector3 = Vector3.ZERO
@@ -19,6 +20,7 @@ var _camera: Node3D = null
 # Ray-marched sphere registration (via VoxelCamera)
 var _voxel_camera: Node = null
 var _vm_id: int = -1
+var _gathered: bool = false ## a VoxelCameraGatherer pushes our position, no per-frame update call
 
 func setup(spell: SpellData, direction: Vector3, voxel_world: VoxelWorld, camera: Node3D = null) -> void:
 	# Configure from spell
@@ -44,6 +46,7 @@ func setup(spell: SpellData, direction: Vector3, voxel_world: VoxelWorld, camera
 
 	if _voxel_camera and _voxel_camera.has_method("register_projectile"):
 		_vm_id = _voxel_camera.register_projectile(global_position, radius_visual)
+	_gathered = is_in_group("projectile") and get_tree().get_first_node_in_group("voxel_camera_gatherer") != null
 
 func _ready():
 	monitoring = false  # We use raycasts for reliable collision
@@ -65,18 +68,14 @@ func _physics_process(delta: float) -> void:
 	var from_pos: Vector3 = global_position
 	var to_pos: Vector3 = from_pos + _velocity * delta
 
-	# 1) Raycast against voxel world via compute (authoritative terrain collision)
-	if _voxel_world:
-		var dir := _velocity.normalized() if _velocity != Vector3.ZERO else Vector3.ZERO
-		var max_range := _velocity.length() * delta + 0.001
-		if dir != Vector3.ZERO and max_range > 0.0:
-			var hit_v4: Vector4 = _voxel_world.raycast_voxels(from_pos, dir, 0.0, max_range)
-			if hit_v4.w >= 0.0:
-				# raycast returns voxel grid coordinates; convert to world units
-				var scale := _voxel_world.get_scale()
-				global_position = Vector3(hit_v4.x, hit_v4.y, hit_v4.z) * scale
-				_explode()
-				return
+	# 1) Sweep the projectile sphere against the voxel world (authoritative terrain collision)
+	if _voxel_world and from_pos != to_pos:
+		var hit: Vector4 = _voxel_world.sweep_sphere(from_pos, to_pos, radius_visual)
+		if hit.w >= 0.0:
+			# contact center in world units, the sphere touches the terrain but does not tunnel into it
+			global_position = Vector3(hit.x, hit.y, hit.z)
+			_explode()
+			return
 
 	# 2) Fallback: physics raycast for bodies (enemies/props)
 	var space: PhysicsDirectSpaceState3D = get_world_3d().direct_space_state
@@ -93,13 +92,13 @@ func _physics_process(delta: float) -> void:
 	global_position = to_pos
 
 	# Update ray-marched sphere position
-	if _voxel_camera and _vm_id >= 0:
+	if _voxel_camera and _vm_id >= 0 and not _gathered:
 		_voxel_camera.update_projectile(_vm_id, global_position, radius_visual)
 
 func _explode():
 	# Modify voxels: destroy then create lava
 	if _voxel_world:
-		_voxel_world.edit_sphere_at(global_position, explosion_radius, 0) # air
+		_voxel_world.explode_at(global_position, explosion_radius, debris_speed) # air + debris
 		if lava_radius > 0.0:
 			_voxel_world.edit_sphere_at(global_position, lava_radius, 4) # lava
 
@@ -1,6 +1,8 @@
 #include "register_types.h"
 #include "voxel_rendering/voxel_camera.h"
+#include "voxel_rendering/voxel_camera_gatherer.h"
 #include "voxel_world/voxel_world.h"
+#include "voxel_world/colliders/voxel_character_mover.h"
 #include "voxel_world/generator/voxel_world_generator.h"
 #include "voxel_world/generator/voxel_world_shader_generator.h"
 #include "voxel_world/generator/voxel_world_generator_cpu_pass.h"
@@ -11,6 +13,7 @@
 #include "voxel_world/generator/cpu_passes/wave_function_collapse/voxel_world_wfc_pattern_generator.h"
 #include "voxel_world/generator/cpu_passes/wave_function_collapse/voxel_world_wfc_tile_generator.h"
 #include "voxel_world/data/voxel_data_vox.h"
+#include "voxel_world/entities/voxel_entity.h"
 
 using namespace godot;
 
@@ -38,7 +41,10 @@ void initialize_voxel_playground_module(ModuleInitializationLevel p_level)
         
 
         GDREGISTER_CLASS(VoxelCamera);
+        GDREGISTER_CLASS(VoxelCameraGatherer);
+        GDREGISTER_CLASS(VoxelEntity);
         GDREGISTER_CLASS(VoxelWorldCollider);
+        GDREGISTER_CLASS(VoxelCharacterMover);
         GDREGISTER_CLASS(VoxelWorld);
     }
 }
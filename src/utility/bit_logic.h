@@ -29,6 +29,12 @@
         return static_cast<int>(idx);
     }
 
+    inline int clz32(uint32_t x) {
+        unsigned long idx;
+        _BitScanReverse(&idx, x); // undefined if x==0
+        return 31 - static_cast<int>(idx);
+    }
+
     inline int popcount32(uint32_t x) {
         return __popcnt(x);
     }
@@ -52,6 +58,10 @@
         return __builtin_ctzll(x); // undefined if x==0
     }
 
+    inline int clz32(uint32_t x) {
+        return __builtin_clz(x); // undefined if x==0
+    }
+
     inline int popcount32(uint32_t x) {
         return __builtin_popcount(x);
     }
@@ -74,6 +84,12 @@
         return idx;
     }
 
+    inline int clz32(uint32_t x) {
+        int idx = 0;
+        while ((x & 0x80000000u) == 0u) { x <<= 1; ++idx; }
+        return idx;
+    }
+
     inline int popcount32(uint32_t x) {
         int count = 0;
         while (x) { x &= (x - 1); ++count; }
@@ -0,0 +1,163 @@
+#include "entity_brick_pool.h"
+#include <algorithm>
+
+uint32_t EntityBrickPool::RangeAllocator::allocate(uint32_t count, uint32_t initial_capacity)
+{
+    if (count == 0)
+        return 0;
+    for (;;)
+    {
+        for (size_t i = 0; i < free.size(); ++i)
+        {
+            if (free[i].count < count)
+                continue;
+            const uint32_t first = free[i].first;
+            free[i].first += count;
+            free[i].count -= count;
+            if (free[i].count == 0)
+                free.erase(free.begin() + i);
+            return first;
+        }
+
+        // nothing fits, double until the free range at the end does
+        const bool tail_free = !free.empty() && free.back().first + free.back().count == capacity;
+        const uint32_t tail_first = tail_free ? free.back().first : capacity;
+        uint32_t new_capacity = std::max(capacity * 2, initial_capacity);
+        while (new_capacity - tail_first < count)
+            new_capacity *= 2;
+        if (tail_free)
+            free.back().count = new_capacity - tail_first;
+        else
+            free.push_back({capacity, new_capacity - capacity});
+        capacity = new_capacity;
+    }
+}
+
+void EntityBrickPool::RangeAllocator::release(uint32_t first, uint32_t count)
+{
+    if (count == 0)
+        return;
+    auto it = std::lower_bound(free.begin(), free.end(), first,
+                               [](const Range &range, uint32_t value) { return range.first < value; });
+    it = free.insert(it, {first, count});
+    // merge with the next range, then with the previous one
+    if (it + 1 != free.end() && it->first + it->count == (it + 1)->first)
+    {
+        it->count += (it + 1)->count;
+        free.erase(it + 1);
+    }
+    if (it != free.begin() && (it - 1)->first + (it - 1)->count == it->first)
+    {
+        (it - 1)->count += it->count;
+        free.erase(it);
+    }
+}
+
+int EntityBrickPool::acquire(const String &key)
+{
+    auto it = _keys.find(key);
+    if (it == _keys.end())
+        return -1;
+    _models[it->second].references++;
+    return it->second;
+}
+
+int EntityBrickPool::add(const String &key, const Vector3i &grid_size,
+                         const std::function<Voxel(const Vector3i &)> &voxel_at)
+{
+    const int edge = VoxelWorldProperties::BRICK_SIZE;
+    const VoxelWorldProperties layout{}; // only for the voxel order inside a brick
+    Model model;
+    model.grid_size = grid_size.max(Vector3i(1, 1, 1));
+    model.brick_grid_size = (model.grid_size + Vector3i(edge - 1, edge - 1, edge - 1)) / edge;
+    model.brick_count = model.brick_grid_size.x * model.brick_grid_size.y * model.brick_grid_size.z;
+    model.references = 1;
+
+    // bricks of the model, and a block for each occupied one
+    std::vector<Brick> bricks(model.brick_count);
+    std::vector<Voxel> blocks;
+    std::vector<Voxel> block(VoxelWorldProperties::BRICK_VOLUME);
+    for (int bz = 0; bz < model.brick_grid_size.z; ++bz)
+        for (int by = 0; by < model.brick_grid_size.y; ++by)
+            for (int bx = 0; bx < model.brick_grid_size.x; ++bx)
+            {
+                int occupancy = 0;
+                for (int z = 0; z < edge; ++z)
+                    for (int y = 0; y < edge; ++y)
+                        for (int x = 0; x < edge; ++x)
+                        {
+                            const Vector3i pos = Vector3i(bx, by, bz) * edge + Vector3i(x, y, z);
+                            const bool inside = pos.x < model.grid_size.x && pos.y < model.grid_size.y &&
+                                                pos.z < model.grid_size.z;
+                            const Voxel voxel = inside ? voxel_at(pos) : Voxel::create_air_voxel();
+                            block[layout.getVoxelIndexInBrick(pos)] = voxel;
+                            occupancy += voxel.is_air() ? 0 : 1;
+                        }
+                Brick &brick = bricks[bx + by * model.brick_grid_size.x +
+                                      bz * model.brick_grid_size.x * model.brick_grid_size.y];
+                brick.occupancy_count = occupancy;
+                brick.voxel_data_pointer = 0;
+                if (occupancy > 0)
+                {
+                    brick.voxel_data_pointer = blocks.size() / VoxelWorldProperties::BRICK_VOLUME;
+                    blocks.insert(blocks.end(), block.begin(), block.end());
+                }
+            }
+    model.block_count = blocks.size() / VoxelWorldProperties::BRICK_VOLUME;
+
+    model.brick_offset = _brick_ranges.allocate(model.brick_count, INITIAL_BRICK_CAPACITY);
+    const uint32_t first_block = _block_ranges.allocate(model.block_count, INITIAL_BLOCK_CAPACITY);
+    model.voxel_offset = first_block * VoxelWorldProperties::BRICK_VOLUME;
+    _bricks.resize(std::max(_brick_ranges.capacity, 1u));
+    _voxels.resize(std::max(_block_ranges.capacity, 1u) * VoxelWorldProperties::BRICK_VOLUME);
+    std::copy(bricks.begin(), bricks.end(), _bricks.begin() + model.brick_offset);
+    std::copy(blocks.begin(), blocks.end(), _voxels.begin() + model.voxel_offset);
+    mark_dirty(_dirty_brick_first, _dirty_brick_end, model.brick_offset, model.brick_count);
+    mark_dirty(_dirty_block_first, _dirty_block_end, first_block, model.block_count);
+
+    int id = 0;
+    while (id < int(_models.size()) && _models[id].references > 0)
+        id++;
+    if (id == int(_models.size()))
+    {
+        _models.emplace_back();
+        _model_keys.emplace_back();
+    }
+    _models[id] = model;
+    _model_keys[id] = key;
+    _keys[key] = id;
+    return id;
+}
+
+void EntityBrickPool::release(int model)
+{
+    if (model < 0 || model >= int(_models.size()) || _models[model].references == 0)
+        return;
+    Model &m = _models[model];
+    if (--m.references > 0)
+        return;
+    // the voxels stay until the ranges are reused, no descriptor points at them anymore
+    _brick_ranges.release(m.brick_offset, m.brick_count);
+    _block_ranges.release(m.voxel_offset / VoxelWorldProperties::BRICK_VOLUME, m.block_count);
+    _keys.erase(_model_keys[model]);
+    _model_keys[model] = String();
+}
+
+void EntityBrickPool::mark_dirty(uint32_t &first, uint32_t &end, uint32_t range_first, uint32_t range_count)
+{
+    if (range_count == 0)
+        return;
+    first = std::min(first, range_first);
+    end = std::max(end, range_first + range_count);
+}
+
+void EntityBrickPool::take_dirty(uint32_t &brick_first, uint32_t &brick_end, uint32_t &block_first,
+                                 uint32_t &block_end)
+{
+    brick_first = _dirty_brick_end > 0 ? _dirty_brick_first : 0;
+    brick_end = _dirty_brick_end;
+    block_first = _dirty_block_end > 0 ? _dirty_block_first : 0;
+    block_end = _dirty_block_end;
+    _dirty_brick_first = _dirty_block_first = UINT32_MAX;
+    _dirty_brick_end = _dirty_block_end = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef ENTITY_BRICK_POOL_H
+#define ENTITY_BRICK_POOL_H
+
+#include "voxel_world/voxel_properties.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+using namespace godot;
+
+// Voxel models of the entities of the VoxelCamera, sub-allocated from one brick array and one voxel array that are
+// shared by all entities. A model is a brick grid over its voxels, only the occupied bricks get a block of
+// BRICK_VOLUME voxels (Morton order, like the world). Models are looked up by a key, entities with the same key use
+// the same model, so identical entities cost one descriptor each and no voxels.
+class EntityBrickPool
+{
+  public:
+    static constexpr uint32_t INITIAL_BRICK_CAPACITY = 256;
+    static constexpr uint32_t INITIAL_BLOCK_CAPACITY = 64; // blocks of BRICK_VOLUME voxels
+
+    struct Model
+    {
+        Vector3i grid_size;       // voxels
+        Vector3i brick_grid_size; // bricks, x fastest
+        uint32_t brick_offset;    // first brick of the model in the pool
+        uint32_t voxel_offset;    // first voxel of the model, brick voxel_data_pointers count blocks from here
+        uint32_t brick_count;
+        uint32_t block_count;
+        int references; // 0 is a free model slot
+    };
+
+    // the model stored under key with one more reference, or -1
+    int acquire(const String &key);
+    // a new model from voxel_at over [0, grid_size) with one reference, stored under key
+    int add(const String &key, const Vector3i &grid_size, const std::function<Voxel(const Vector3i &)> &voxel_at);
+    // drops a reference, the last one frees the bricks and voxels of the model
+    void release(int model);
+
+    const Model &get_model(int model) const { return _models[model]; }
+    const std::vector<Brick> &get_bricks() const { return _bricks; }
+    const std::vector<Voxel> &get_voxels() const { return _voxels; }
+
+    // bricks and blocks changed since the last call, as [first, end) ranges. Both are empty when nothing changed.
+    void take_dirty(uint32_t &brick_first, uint32_t &brick_end, uint32_t &block_first, uint32_t &block_end);
+
+  private:
+    // first fit over a sorted list of free ranges, the capacity doubles when nothing fits
+    struct RangeAllocator
+    {
+        struct Range
+        {
+            uint32_t first;
+            uint32_t count;
+        };
+        std::vector<Range> free;
+        uint32_t capacity = 0;
+
+        uint32_t allocate(uint32_t count, uint32_t initial_capacity);
+        void release(uint32_t first, uint32_t count);
+    };
+
+    void mark_dirty(uint32_t &first, uint32_t &end, uint32_t range_first, uint32_t range_count);
+
+    std::vector<Model> _models;
+    std::map<String, int> _keys;
+    std::vector<String> _model_keys; // per model, to drop the key with the last reference
+
+    RangeAllocator _brick_ranges;
+    RangeAllocator _block_ranges;
+    std::vector<Brick> _bricks;
+    std::vector<Voxel> _voxels;
+
+    uint32_t _dirty_brick_first = UINT32_MAX, _dirty_brick_end = 0;
+    uint32_t _dirty_block_first = UINT32_MAX, _dirty_block_end = 0;
+};
+
+#endif // ENTITY_BRICK_POOL_H
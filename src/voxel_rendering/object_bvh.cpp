@@ -0,0 +1,156 @@
+#include "object_bvh.h"
+#include "utility/bit_logic.h"
+#include <algorithm>
+
+// spreads the low 10 bits of v to every third bit
+static uint32_t expand_bits(uint32_t v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+void ObjectBvh::build()
+{
+    if (same_objects())
+        refit();
+    else
+        rebuild();
+}
+
+bool ObjectBvh::same_objects() const
+{
+    if (_nodes.empty() || _objects.size() != _items.size())
+        return false;
+    for (size_t i = 0; i < _objects.size(); ++i)
+        if (_items[_item_of_object[i]].reference != _objects[i].reference)
+            return false;
+    return true;
+}
+
+void ObjectBvh::refit()
+{
+    for (size_t i = 0; i < _objects.size(); ++i)
+        _items[_item_of_object[i]].bounds = _objects[i].bounds;
+
+    // children come after their parent, so walking the nodes backwards merges them before the parent
+    std::vector<AABB> bounds(_nodes.size());
+    for (int index = int(_nodes.size()) - 1; index >= 0; --index)
+    {
+        Node &node = _nodes[index];
+        auto child_bounds = [&](int side, uint32_t child) {
+            const int32_t item = _leaf_items[2 * index + side];
+            return item >= 0 ? _items[item].bounds : bounds[child];
+        };
+        AABB merged = child_bounds(0, node.left);
+        if (node.right != INVALID)
+            merged = merged.merge(child_bounds(1, node.right));
+        bounds[index] = merged;
+        const Vector3 end = merged.get_end();
+        node.min[0] = merged.position.x;
+        node.min[1] = merged.position.y;
+        node.min[2] = merged.position.z;
+        node.max[0] = end.x;
+        node.max[1] = end.y;
+        node.max[2] = end.z;
+    }
+}
+
+void ObjectBvh::rebuild()
+{
+    _nodes.clear();
+    _leaf_items.clear();
+    _items.resize(_objects.size());
+    for (size_t i = 0; i < _objects.size(); ++i)
+        _items[i] = {_objects[i].bounds, _objects[i].reference, 0, uint32_t(i)};
+    if (_items.empty())
+        return;
+
+    // 10 bits per axis of the center, relative to the bounds of all centers
+    AABB centers(_items[0].bounds.get_center(), Vector3());
+    for (const Item &item : _items)
+        centers.expand_to(item.bounds.get_center());
+    for (Item &item : _items)
+    {
+        const Vector3 offset = item.bounds.get_center() - centers.position;
+        uint32_t quantized[3];
+        for (int axis = 0; axis < 3; ++axis)
+            quantized[axis] = centers.size[axis] > 0.0f
+                                  ? uint32_t(std::clamp(offset[axis] / centers.size[axis] * 1023.0f, 0.0f, 1023.0f))
+                                  : 0u;
+        item.code = expand_bits(quantized[0]) << 2 | expand_bits(quantized[1]) << 1 | expand_bits(quantized[2]);
+    }
+    std::sort(_items.begin(), _items.end(), [](const Item &a, const Item &b) { return a.code < b.code; });
+    _item_of_object.resize(_items.size());
+    for (size_t i = 0; i < _items.size(); ++i)
+        _item_of_object[_items[i].object] = uint32_t(i);
+
+    _nodes.reserve(std::max<size_t>(_items.size() - 1, 1));
+    if (_items.size() == 1)
+    {
+        // a root with one child, so the traversal always starts at a node
+        const AABB &bounds = _items[0].bounds;
+        const Vector3 end = bounds.get_end();
+        _nodes.push_back({{bounds.position.x, bounds.position.y, bounds.position.z},
+                          LEAF_BIT | _items[0].reference,
+                          {end.x, end.y, end.z},
+                          INVALID});
+        _leaf_items = {0, -1};
+        return;
+    }
+    AABB bounds;
+    build_range(0, int(_items.size()) - 1, bounds);
+}
+
+int ObjectBvh::find_split(int first, int last) const
+{
+    const uint32_t first_code = _items[first].code;
+    const uint32_t last_code = _items[last].code;
+    if (first_code == last_code)
+        return (first + last) >> 1;
+
+    // binary search for the last item that shares more leading bits with the first one than the last one does
+    const int common = clz32(first_code ^ last_code);
+    int split = first;
+    int step = last - first;
+    do
+    {
+        step = (step + 1) >> 1;
+        const int candidate = split + step;
+        if (candidate < last)
+        {
+            const uint32_t difference = first_code ^ _items[candidate].code;
+            if (difference == 0 || clz32(difference) > common)
+                split = candidate;
+        }
+    } while (step > 1);
+    return split;
+}
+
+uint32_t ObjectBvh::build_range(int first, int last, AABB &bounds)
+{
+    if (first == last)
+    {
+        bounds = _items[first].bounds;
+        return LEAF_BIT | _items[first].reference;
+    }
+
+    const int split = find_split(first, last);
+    const uint32_t index = uint32_t(_nodes.size());
+    _nodes.emplace_back();
+    _leaf_items.push_back(first == split ? first : -1);
+    _leaf_items.push_back(split + 1 == last ? last : -1);
+    AABB left_bounds, right_bounds;
+    const uint32_t left = build_range(first, split, left_bounds);
+    const uint32_t right = build_range(split + 1, last, right_bounds);
+    bounds = left_bounds.merge(right_bounds);
+
+    const Vector3 end = bounds.get_end();
+    _nodes[index] = {{bounds.position.x, bounds.position.y, bounds.position.z},
+                     left,
+                     {end.x, end.y, end.z},
+                     right};
+    return index;
+}
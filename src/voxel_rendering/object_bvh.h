@@ -0,0 +1,68 @@
+#ifndef OBJECT_BVH_H
+#define OBJECT_BVH_H
+
+#include <cstdint>
+#include <godot_cpp/variant/aabb.hpp>
+#include <vector>
+
+using namespace godot;
+
+// Linear BVH over the bounds of the ray traced objects of the VoxelCamera (projectile spheres and entity boxes).
+// The objects are sorted along a Morton curve of their centers and the tree is the radix tree over the sorted
+// codes, so a rebuild is a sort and a linear pass. While the same objects are added in the same order the tree is
+// kept and only its bounds are refit, it is rebuilt when objects were added or removed. There are only internal
+// nodes, a child is either another node or an object reference with LEAF_BIT set. Node 0 is the root.
+class ObjectBvh
+{
+  public:
+    static constexpr uint32_t LEAF_BIT = 0x80000000u;
+    static constexpr uint32_t ENTITY_BIT = 0x40000000u; // the reference is an entity, else a projectile
+    static constexpr uint32_t INVALID = 0xFFFFFFFFu;    // missing child of a root with a single object
+
+    struct Node // match the struct on the gpu
+    {
+        float min[3];
+        uint32_t left;
+        float max[3];
+        uint32_t right;
+    };
+
+    void clear() { _objects.clear(); }
+    void add(const AABB &bounds, uint32_t reference) { _objects.push_back({bounds, reference}); }
+    // refits the last tree when the objects are the ones it was built over, else builds a new one
+    void build();
+
+    const std::vector<Node> &get_nodes() const { return _nodes; }
+
+  private:
+    struct Object
+    {
+        AABB bounds;
+        uint32_t reference;
+    };
+
+    struct Item
+    {
+        AABB bounds;
+        uint32_t reference;
+        uint32_t code;
+        uint32_t object; // index in _objects
+    };
+
+    bool same_objects() const;
+    void rebuild();
+    void refit();
+
+    // last item of the left child of [first, last], where the highest differing bit of the codes changes
+    int find_split(int first, int last) const;
+    // builds the subtree over the sorted items [first, last], returns its child reference
+    uint32_t build_range(int first, int last, AABB &bounds);
+
+    std::vector<Object> _objects; // in add order
+    std::vector<Item> _items;     // in Morton order
+    std::vector<uint32_t> _item_of_object;
+    std::vector<Node> _nodes;
+    std::vector<int32_t> _leaf_items; // per node the item of the left and of the right child, -1 for a node
+};
+
+#endif // OBJECT_BVH_H
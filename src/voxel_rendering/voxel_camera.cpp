@@ -1,7 +1,83 @@
 #include "voxel_camera.h"
+#include "utility/bit_logic.h"
 #include "utility/utils.h"
+#include "voxel_world/entities/voxel_entity.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <godot_cpp/classes/scene_tree.hpp>
 
+// pixels per side of a beam pre-pass tile, BEAM_TILE_SIZE in the shaders
+static constexpr int BEAM_TILE_SIZE = 8;
+
+// object bins in object_bins.glsl: pixels per tile side, and per tile two counts and the index lists
+static constexpr int BIN_TILE_SIZE = 32;
+static constexpr int MAX_TILE_PROJECTILES = 64;
+static constexpr int MAX_TILE_ENTITIES = 16;
+static constexpr int BIN_STRIDE = 2 + MAX_TILE_PROJECTILES + MAX_TILE_ENTITIES;
+
+// a clean gap this small between dirty slots is uploaded with them rather than starting another update
+static constexpr int MERGE_GAP_BYTES = 256;
+
+// GPU timestamps around the passes of a frame, read back with the next frame instead of syncing after every pass
+static const char *TIMESTAMP_BEGIN = "VoxelCamera begin";
+static const char *TIMESTAMP_BEAM = "VoxelCamera beam prepass";
+static const char *TIMESTAMP_BINNING = "VoxelCamera object binning";
+static const char *TIMESTAMP_RAYMARCHING = "VoxelCamera raymarching";
+static const char *TIMESTAMP_END = "VoxelCamera end";
+
+// first set bit at or after from, count if there is none
+static int next_dirty(const std::vector<uint64_t> &dirty, int from, int count)
+{
+    for (int word = from >> 6; word < int(dirty.size()); word++)
+    {
+        uint64_t bits = dirty[word];
+        if (word == (from >> 6))
+            bits &= ~0ull << (from & 63);
+        if (bits != 0)
+            return std::min(word * 64 + ctz64(bits), count);
+    }
+    return count;
+}
+
+// Uploads the dirty slots of staging to buffer in as few updates as possible and clears the dirty bits. fill(slot,
+// dst) writes the current value of a slot into the staging copy first.
+template <typename Fill>
+static void upload_dirty_slots(RenderingDevice *rd, const RID &buffer, PackedByteArray &staging, int stride,
+                               int count, std::vector<uint64_t> &dirty, Fill fill)
+{
+    const int max_gap = MERGE_GAP_BYTES / stride;
+    uint8_t *ptr = staging.ptrw();
+    for (int first = next_dirty(dirty, 0, count); first < count;)
+    {
+        int end = first + 1;
+        int next = next_dirty(dirty, end, count);
+        while (next < count && next - end <= max_gap)
+        {
+            end = next + 1;
+            next = next_dirty(dirty, end, count);
+        }
+        for (int slot = first; slot < end; slot++)
+            fill(slot, ptr + slot * stride);
+        rd->buffer_update(buffer, first * stride, (end - first) * stride,
+                          staging.slice(first * stride, end * stride));
+        first = next;
+    }
+    std::fill(dirty.begin(), dirty.end(), 0);
+}
+
+// Halton sequence, the sub-pixel jitter of the temporal upscale
+static float halton(int index, int base)
+{
+    float f = 1.0f, r = 0.0f;
+    for (; index > 0; index /= base)
+    {
+        f /= base;
+        r += f * (index % base);
+    }
+    return r;
+}
+
 void VoxelCamera::_bind_methods()
 {
     ClassDB::bind_method(D_METHOD("get_fov"), &VoxelCamera::get_fov);
@@ -18,23 +94,70 @@ void VoxelCamera::_bind_methods()
     ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "output_texture", PROPERTY_HINT_NODE_TYPE, "TextureRect"),
                  "set_output_texture", "get_output_texture");
 
+    // Resolution
+    ClassDB::bind_method(D_METHOD("get_dynamic_resolution"), &VoxelCamera::get_dynamic_resolution);
+    ClassDB::bind_method(D_METHOD("set_dynamic_resolution", "value"), &VoxelCamera::set_dynamic_resolution);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "dynamic_resolution"), "set_dynamic_resolution",
+                 "get_dynamic_resolution");
+    ClassDB::bind_method(D_METHOD("get_target_gpu_time_ms"), &VoxelCamera::get_target_gpu_time_ms);
+    ClassDB::bind_method(D_METHOD("set_target_gpu_time_ms", "value"), &VoxelCamera::set_target_gpu_time_ms);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "target_gpu_time_ms", PROPERTY_HINT_RANGE, "0.1,33,0.1,or_greater"),
+                 "set_target_gpu_time_ms", "get_target_gpu_time_ms");
+    ClassDB::bind_method(D_METHOD("get_min_render_scale"), &VoxelCamera::get_min_render_scale);
+    ClassDB::bind_method(D_METHOD("set_min_render_scale", "value"), &VoxelCamera::set_min_render_scale);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "min_render_scale", PROPERTY_HINT_RANGE, "0.25,1,0.01"),
+                 "set_min_render_scale", "get_min_render_scale");
+    ClassDB::bind_method(D_METHOD("get_max_render_scale"), &VoxelCamera::get_max_render_scale);
+    ClassDB::bind_method(D_METHOD("set_max_render_scale", "value"), &VoxelCamera::set_max_render_scale);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "max_render_scale", PROPERTY_HINT_RANGE, "0.25,1,0.01"),
+                 "set_max_render_scale", "get_max_render_scale");
+    ClassDB::bind_method(D_METHOD("get_render_scale"), &VoxelCamera::get_render_scale);
+    ClassDB::bind_method(D_METHOD("set_render_scale", "value"), &VoxelCamera::set_render_scale);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "render_scale", PROPERTY_HINT_RANGE, "0.25,1,0.01"),
+                 "set_render_scale", "get_render_scale");
+    ClassDB::bind_method(D_METHOD("get_temporal_upscale"), &VoxelCamera::get_temporal_upscale);
+    ClassDB::bind_method(D_METHOD("set_temporal_upscale", "value"), &VoxelCamera::set_temporal_upscale);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "temporal_upscale"), "set_temporal_upscale", "get_temporal_upscale");
+    ClassDB::bind_method(D_METHOD("get_temporal_blend"), &VoxelCamera::get_temporal_blend);
+    ClassDB::bind_method(D_METHOD("set_temporal_blend", "value"), &VoxelCamera::set_temporal_blend);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "temporal_blend", PROPERTY_HINT_RANGE, "0,0.98,0.01"),
+                 "set_temporal_blend", "get_temporal_blend");
+    ClassDB::bind_method(D_METHOD("get_beam_prepass"), &VoxelCamera::get_beam_prepass);
+    ClassDB::bind_method(D_METHOD("set_beam_prepass", "value"), &VoxelCamera::set_beam_prepass);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "beam_prepass"), "set_beam_prepass", "get_beam_prepass");
+    ClassDB::bind_method(D_METHOD("get_object_binning"), &VoxelCamera::get_object_binning);
+    ClassDB::bind_method(D_METHOD("set_object_binning", "value"), &VoxelCamera::set_object_binning);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "object_binning"), "set_object_binning", "get_object_binning");
+    ClassDB::bind_method(D_METHOD("get_render_size"), &VoxelCamera::get_render_size);
+
     // Performance profiling methods
     ClassDB::bind_method(D_METHOD("get_time_camera_update"), &VoxelCamera::get_time_camera_update);
     ClassDB::bind_method(D_METHOD("get_time_raymarching"), &VoxelCamera::get_time_raymarching);
     ClassDB::bind_method(D_METHOD("get_time_total_render"), &VoxelCamera::get_time_total_render);
+    ClassDB::bind_method(D_METHOD("get_time_upscale"), &VoxelCamera::get_time_upscale);
+    ClassDB::bind_method(D_METHOD("get_time_beam_prepass"), &VoxelCamera::get_time_beam_prepass);
+    ClassDB::bind_method(D_METHOD("get_time_object_binning"), &VoxelCamera::get_time_object_binning);
+    ClassDB::bind_method(D_METHOD("get_time_object_bvh"), &VoxelCamera::get_time_object_bvh);
 
     // GPU timing methods
     ClassDB::bind_method(D_METHOD("get_gpu_time_raymarching"), &VoxelCamera::get_gpu_time_raymarching);
+    ClassDB::bind_method(D_METHOD("get_gpu_time_upscale"), &VoxelCamera::get_gpu_time_upscale);
+    ClassDB::bind_method(D_METHOD("get_gpu_time_beam_prepass"), &VoxelCamera::get_gpu_time_beam_prepass);
+    ClassDB::bind_method(D_METHOD("get_gpu_time_object_binning"), &VoxelCamera::get_gpu_time_object_binning);
+    ClassDB::bind_method(D_METHOD("get_gpu_time_total"), &VoxelCamera::get_gpu_time_total);
 
     // Projectile API
     ClassDB::bind_method(D_METHOD("register_projectile", "position", "radius"), &VoxelCamera::register_projectile);
     ClassDB::bind_method(D_METHOD("update_projectile", "id", "position", "radius"), &VoxelCamera::update_projectile);
     ClassDB::bind_method(D_METHOD("remove_projectile", "id"), &VoxelCamera::remove_projectile);
+    ClassDB::bind_method(D_METHOD("update_projectiles", "ids", "data"), &VoxelCamera::update_projectiles);
 
     // Entity API
     ClassDB::bind_method(D_METHOD("register_entity", "transform", "aabb_size", "scale"), &VoxelCamera::register_entity);
+    ClassDB::bind_method(D_METHOD("register_voxel_entity", "entity"), &VoxelCamera::register_voxel_entity);
     ClassDB::bind_method(D_METHOD("update_entity", "id", "transform"), &VoxelCamera::update_entity);
     ClassDB::bind_method(D_METHOD("remove_entity", "id"), &VoxelCamera::remove_entity);
+    ClassDB::bind_method(D_METHOD("update_entities", "ids", "transforms"), &VoxelCamera::update_entities);
 }
 
 void VoxelCamera::_notification(int p_what)
@@ -81,6 +204,25 @@ void VoxelCamera::set_fov(float value)
     fov = value;
 }
 
+void VoxelCamera::set_min_render_scale(float value)
+{
+    min_render_scale = std::clamp(value, 0.25f, 1.0f);
+    max_render_scale = std::max(max_render_scale, min_render_scale);
+    render_scale = std::clamp(render_scale, min_render_scale, max_render_scale);
+}
+
+void VoxelCamera::set_max_render_scale(float value)
+{
+    max_render_scale = std::clamp(value, 0.25f, 1.0f);
+    min_render_scale = std::min(min_render_scale, max_render_scale);
+    render_scale = std::clamp(render_scale, min_render_scale, max_render_scale);
+}
+
+void VoxelCamera::set_render_scale(float value)
+{
+    render_scale = std::clamp(value, min_render_scale, max_render_scale);
+}
+
 // int VoxelCamera::get_num_bounces() const
 // {
 //     return num_bounces;
@@ -140,6 +282,7 @@ void VoxelCamera::init()
 
     //get resolution
     Vector2i resolution = DisplayServer::get_singleton()->window_get_size();
+    _output_size = resolution;
     auto near = 0.01f;
     auto far = 1000.0f;    
 
@@ -153,9 +296,11 @@ void VoxelCamera::init()
 
     //--------- GENERAL BUFFERS ---------
     { // input general buffer
-        render_parameters.width = resolution.x;
-        render_parameters.height = resolution.y;
+        render_parameters.width = std::max(1, int(std::round(resolution.x * render_scale)));
+        render_parameters.height = std::max(1, int(std::round(resolution.y * render_scale)));
         render_parameters.fov = fov;
+        render_parameters.beam_prepass = 0; // set once the pre-pass is ready
+        render_parameters.object_binning = 0; // same for the binning
 
         render_parameters_rid = cs->create_storage_buffer_uniform(render_parameters.to_packed_byte_array(), 2, 1);
     }
@@ -177,60 +322,148 @@ void VoxelCamera::init()
 
     //--------- PROJECTILE BUFFERS ---------
     {
-        // Initialize CPU-side cache
-        _projectiles.resize(MAX_PROJECTILES);
-        for (int i = 0; i < MAX_PROJECTILES; ++i) {
-            _projectiles.write[i].data = Vector4(0,0,0,0);
-            _projectiles.write[i].active = false;
-        }
-        _projectile_params.projectile_count = 0;
+        // Initialize CPU-side cache, kept when the buffers are re-created to grow
+        if (_projectiles.is_empty())
+            grow_projectiles();
+        _gpu_projectile_capacity = _projectiles.size();
+        _projectile_params.projectile_count = _projectile_slots_used;
 
         // GPU buffers: params + spheres array (vec4 per projectile)
         projectile_parameters_rid = cs->create_storage_buffer_uniform(_projectile_params.to_packed_byte_array(), 4, 1);
 
-        PackedByteArray spheres;
-        spheres.resize(sizeof(float) * 4 * MAX_PROJECTILES);
-        spheres.fill(0);
-        projectile_spheres_rid = cs->create_storage_buffer_uniform(spheres, 5, 1);
+        _projectile_staging.resize(sizeof(Vector4) * _gpu_projectile_capacity);
+        Vector4 *spheres = reinterpret_cast<Vector4 *>(_projectile_staging.ptrw());
+        for (int i = 0; i < _gpu_projectile_capacity; ++i)
+            spheres[i] = _projectiles[i].active ? _projectiles[i].data : Vector4(0, 0, 0, 0);
+        projectile_spheres_rid = cs->create_storage_buffer_uniform(_projectile_staging, 5, 1);
+        std::fill(_projectile_dirty.begin(), _projectile_dirty.end(), 0);
+        _projectile_count_dirty = false;
     }
 
     //--------- ENTITY BUFFERS ---------
     {
-        // Initialize CPU-side cache
-        _entities.resize(MAX_ENTITIES);
-        for (int i = 0; i < MAX_ENTITIES; ++i) {
-            _entities.write[i].active = false;
-            // Zero out descriptor
-            EntityDescriptor &desc = _entities.write[i].descriptor;
-            memset(&desc, 0, sizeof(EntityDescriptor));
-        }
-        _entity_count.entity_count = 0;
+        // Initialize CPU-side cache, kept when the buffers are re-created to grow
+        if (_entities.is_empty())
+            grow_entities();
+        _gpu_entity_capacity = _entities.size();
+        _entity_count.entity_count = _entity_slots_used;
 
         // GPU buffer: entity count
         entity_count_rid = cs->create_storage_buffer_uniform(_entity_count.to_packed_byte_array(), 6, 1);
 
-        // GPU buffer: entity bricks (empty for now, will populate when entities have voxel data)
+        // GPU buffers: bricks and voxels of the entity models, the whole pool so far
+        const std::vector<Brick> &pool_bricks = _entity_pool.get_bricks();
+        const std::vector<Voxel> &pool_voxels = _entity_pool.get_voxels();
+        _gpu_entity_brick_capacity = std::max<size_t>(pool_bricks.size(), EntityBrickPool::INITIAL_BRICK_CAPACITY);
+        _gpu_entity_voxel_capacity = std::max<size_t>(pool_voxels.size(), EntityBrickPool::INITIAL_BLOCK_CAPACITY *
+                                                                              VoxelWorldProperties::BRICK_VOLUME);
         PackedByteArray entity_bricks_data;
-        entity_bricks_data.resize(1024); // Dummy size
+        entity_bricks_data.resize(sizeof(Brick) * _gpu_entity_brick_capacity);
         entity_bricks_data.fill(0);
+        if (!pool_bricks.empty())
+            std::memcpy(entity_bricks_data.ptrw(), pool_bricks.data(), sizeof(Brick) * pool_bricks.size());
         entity_bricks_rid = cs->create_storage_buffer_uniform(entity_bricks_data, 7, 1);
 
-        // GPU buffer: entity voxels (empty for now)
         PackedByteArray entity_voxels_data;
-        entity_voxels_data.resize(4096); // Dummy size
+        entity_voxels_data.resize(sizeof(Voxel) * _gpu_entity_voxel_capacity);
         entity_voxels_data.fill(0);
+        if (!pool_voxels.empty())
+            std::memcpy(entity_voxels_data.ptrw(), pool_voxels.data(), sizeof(Voxel) * pool_voxels.size());
         entity_voxels_rid = cs->create_storage_buffer_uniform(entity_voxels_data, 8, 1);
+        uint32_t brick_first, brick_end, block_first, block_end; // all of it is uploaded already
+        _entity_pool.take_dirty(brick_first, brick_end, block_first, block_end);
 
         // GPU buffer: entity descriptors array
-        PackedByteArray entity_descriptors_data;
-        entity_descriptors_data.resize(sizeof(EntityDescriptor) * MAX_ENTITIES);
-        entity_descriptors_data.fill(0);
-        entity_descriptors_rid = cs->create_storage_buffer_uniform(entity_descriptors_data, 9, 1);
+        _entity_staging.resize(sizeof(EntityDescriptor) * _gpu_entity_capacity);
+        for (int i = 0; i < _gpu_entity_capacity; ++i)
+            std::memcpy(_entity_staging.ptrw() + i * sizeof(EntityDescriptor), &_entities[i].descriptor,
+                        sizeof(EntityDescriptor));
+        entity_descriptors_rid = cs->create_storage_buffer_uniform(_entity_staging, 9, 1);
+        std::fill(_entity_dirty.begin(), _entity_dirty.end(), 0);
+        _entity_count_dirty = false;
+    }
+
+    { // object BVH, one node per object at most
+        _bvh_staging.resize(sizeof(uint32_t) * 4 + sizeof(ObjectBvh::Node) * (_gpu_projectile_capacity + _gpu_entity_capacity));
+        _bvh_staging.fill(0);
+        object_bvh_rid = cs->create_storage_buffer_uniform(_bvh_staging, 12, 1);
+        update_object_bvh();
+    }
+
+    Ref<RDTextureView> render_texture_view = memnew(RDTextureView);
+    { // render texture, window sized so the render scale can change without reallocating
+        auto render_format = cs->create_texture_format(_output_size.x, _output_size.y, RenderingDevice::DATA_FORMAT_R32G32B32A32_SFLOAT);
+        output_image = Image::create(_output_size.x, _output_size.y, false, Image::FORMAT_RGBAF);
+        render_texture_rid = cs->create_image_uniform(output_image, render_format, render_texture_view, 0, 1);
+    }
+
+    Ref<RDTextureView> depth_texture_view = memnew(RDTextureView);
+    { // depth texture
+        auto depth_format = cs->create_texture_format(_output_size.x, _output_size.y, RenderingDevice::DATA_FORMAT_R32_SFLOAT);
+        depth_image = Image::create(_output_size.x, _output_size.y, false, Image::FORMAT_RF);
+        depth_texture_rid = cs->create_image_uniform(depth_image, depth_format, depth_texture_view, 1, 1);
+    }
+
+    Ref<RDTextureView> beam_texture_view = memnew(RDTextureView);
+    { // beam texture, one start distance per tile of the largest render size
+        const int tiles_x = (_output_size.x + BEAM_TILE_SIZE - 1) / BEAM_TILE_SIZE;
+        const int tiles_y = (_output_size.y + BEAM_TILE_SIZE - 1) / BEAM_TILE_SIZE;
+        auto beam_format = cs->create_texture_format(tiles_x, tiles_y, RenderingDevice::DATA_FORMAT_R32_SFLOAT);
+        Ref<Image> beam_image = Image::create(tiles_x, tiles_y, false, Image::FORMAT_RF);
+        beam_texture_rid = cs->create_image_uniform(beam_image, beam_format, beam_texture_view, 10, 1);
     }
 
+    { // object bins, for the tiles of the largest render size
+        const int tiles_x = (_output_size.x + BIN_TILE_SIZE - 1) / BIN_TILE_SIZE;
+        const int tiles_y = (_output_size.y + BIN_TILE_SIZE - 1) / BIN_TILE_SIZE;
+        PackedByteArray bins_data;
+        bins_data.resize(sizeof(uint32_t) * BIN_STRIDE * tiles_x * tiles_y);
+        bins_data.fill(0);
+        object_bins_rid = cs->create_storage_buffer_uniform(bins_data, 11, 1);
+    }
+
+    cs->finish_create_uniforms();
+
+    // projectiles and entities per screen tile
+    binning_cs = new ComputeShader("res://addons/voxel_playground/src/shaders/object_binning.glsl", _rd);
+    binning_cs->add_existing_buffer(render_parameters_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 2, 1);
+    binning_cs->add_existing_buffer(camera_parameters_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 3, 1);
+    binning_cs->add_existing_buffer(projectile_parameters_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 4, 1);
+    binning_cs->add_existing_buffer(projectile_spheres_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 5, 1);
+    binning_cs->add_existing_buffer(entity_count_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 6, 1);
+    binning_cs->add_existing_buffer(entity_descriptors_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 9, 1);
+    binning_cs->add_existing_buffer(object_bins_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 11, 1);
+    binning_cs->finish_create_uniforms();
+
+    // coarse cones ahead of the primary rays
+    beam_cs = new ComputeShader("res://addons/voxel_playground/src/shaders/beam_prepass.glsl", _rd);
+    voxel_world->get_voxel_world_rids().add_voxel_buffers(beam_cs);
+    beam_cs->add_existing_buffer(beam_texture_rid, RenderingDevice::UNIFORM_TYPE_IMAGE, 0, 1);
+    beam_cs->add_existing_buffer(render_parameters_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 1, 1);
+    beam_cs->add_existing_buffer(camera_parameters_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 2, 1);
+    beam_cs->finish_create_uniforms();
+
+    // particle splats, drawn on top of the ray marched image
+    VoxelParticleSystem *particle_system = voxel_world->get_particle_system();
+    if (particle_system != nullptr)
+    {
+        particle_splat_cs = new ComputeShader("res://addons/voxel_playground/src/shaders/particles/particle_splat.glsl", _rd);
+        voxel_world->get_voxel_world_rids().add_voxel_buffers(particle_splat_cs);
+        particle_splat_cs->add_existing_buffer(render_texture_rid, RenderingDevice::UNIFORM_TYPE_IMAGE, 0, 1);
+        particle_splat_cs->add_existing_buffer(depth_texture_rid, RenderingDevice::UNIFORM_TYPE_IMAGE, 1, 1);
+        particle_splat_cs->add_existing_buffer(render_parameters_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 2, 1);
+        particle_splat_cs->add_existing_buffer(camera_parameters_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 3, 1);
+        particle_system->get_rids().add_particle_buffers(particle_splat_cs, 4);
+        particle_splat_cs->finish_create_uniforms();
+    }
+
+    // upscale from the render size to the window
+    upscale_cs = new ComputeShader("res://addons/voxel_playground/src/shaders/upscale.glsl", _rd);
+    upscale_cs->add_existing_buffer(render_texture_rid, RenderingDevice::UNIFORM_TYPE_IMAGE, 0, 1);
+    upscale_cs->add_existing_buffer(depth_texture_rid, RenderingDevice::UNIFORM_TYPE_IMAGE, 1, 1);
     Ref<RDTextureView> output_texture_view = memnew(RDTextureView);
     { // output texture
-        auto output_format = cs->create_texture_format(render_parameters.width, render_parameters.height, RenderingDevice::DATA_FORMAT_R32G32B32A32_SFLOAT);
+        auto output_format = upscale_cs->create_texture_format(_output_size.x, _output_size.y, RenderingDevice::DATA_FORMAT_R32G32B32A32_SFLOAT);
         if (output_texture_rect == nullptr)
         {
             // Try to find a TextureRect child for convenience; fallback to headless rendering
@@ -243,8 +476,7 @@ void VoxelCamera::init()
                 UtilityFunctions::printerr("No output texture set. Rendering headless to RD texture.");
             }
         }
-        output_image = Image::create(render_parameters.width, render_parameters.height, false, Image::FORMAT_RGBAF);
-        output_texture_rid = cs->create_image_uniform(output_image, output_format, output_texture_view, 0, 1);
+        output_texture_rid = upscale_cs->create_image_uniform(output_image, output_format, output_texture_view, 2, 1);
 
         if (output_texture_rect != nullptr) {
             output_texture.instantiate();
@@ -252,23 +484,43 @@ void VoxelCamera::init()
             output_texture_rect->set_texture(output_texture);
         }
     }
-
-    Ref<RDTextureView> depth_texture_view = memnew(RDTextureView);
-    { // depth texture
-        auto depth_format = cs->create_texture_format(render_parameters.width, render_parameters.height, RenderingDevice::DATA_FORMAT_R32_SFLOAT);
-        depth_image = Image::create(render_parameters.width, render_parameters.height, false, Image::FORMAT_RF);        
-        depth_texture_rid = cs->create_image_uniform(depth_image, depth_format, depth_texture_view, 1, 1);
+    Ref<RDTextureView> history_texture_view = memnew(RDTextureView);
+    { // history texture
+        auto history_format = upscale_cs->create_texture_format(_output_size.x, _output_size.y, RenderingDevice::DATA_FORMAT_R32G32B32A32_SFLOAT);
+        history_texture_rid = upscale_cs->create_image_uniform(output_image, history_format, history_texture_view, 3, 1);
     }
-
-    cs->finish_create_uniforms();
+    { // upscale parameters, filled every frame
+        std::memset(&upscale_parameters, 0, sizeof(UpscaleParameters));
+        upscale_parameters.output_width = _output_size.x;
+        upscale_parameters.output_height = _output_size.y;
+        upscale_parameters.farPlane = far;
+        upscale_parameters_rid = upscale_cs->create_storage_buffer_uniform(upscale_parameters.to_packed_byte_array(), 4, 1);
+    }
+    upscale_cs->finish_create_uniforms();
+    _history_valid = false;
 }
 
 void VoxelCamera::clear_compute_shader()
 {
+    // the passes that borrow buffers of cs go first
+    for (ComputeShader **shader : {&binning_cs, &beam_cs, &upscale_cs, &particle_splat_cs, &cs})
+    {
+        delete *shader;
+        *shader = nullptr;
+    }
 }
 
 void VoxelCamera::render()
 {
+    if (cs != nullptr && (_projectiles.size() > _gpu_projectile_capacity || _entities.size() > _gpu_entity_capacity ||
+                          _entity_pool.get_bricks().size() > _gpu_entity_brick_capacity ||
+                          _entity_pool.get_voxels().size() > _gpu_entity_voxel_capacity))
+    {
+        // registration outgrew the object buffers or the entity models the pool. Rare with doubling, so everything
+        // is simply set up again.
+        clear_compute_shader();
+        init();
+    }
     if (cs == nullptr || !cs->check_ready())
         return;
 
@@ -276,11 +528,26 @@ void VoxelCamera::render()
 
     // update rendering parameters
     uint64_t camera_update_start = Time::get_singleton()->get_ticks_usec();
+    update_render_parameters();
     Vector3 camera_position = get_global_transform().get_origin();
     Projection VP = projection_matrix * get_global_transform().affine_inverse();
-    Projection IVP = VP.inverse();
 
-    Utils::projection_to_float(camera_parameters.vp, VP);
+    // shift the rays by a different sub-pixel offset every frame, the upscale gathers them over time
+    Vector2 jitter;
+    Projection jittered_VP = VP;
+    if (temporal_upscale)
+    {
+        const int phase = camera_parameters.frame_index % 8 + 1;
+        jitter = Vector2(halton(phase, 2) - 0.5f, halton(phase, 3) - 0.5f);
+        Projection offset;
+        offset.set_identity();
+        offset.columns[3][0] = 2.0f * jitter.x / render_parameters.width;
+        offset.columns[3][1] = -2.0f * jitter.y / render_parameters.height;
+        jittered_VP = offset * VP;
+    }
+    Projection IVP = jittered_VP.inverse();
+
+    Utils::projection_to_float(camera_parameters.vp, jittered_VP);
     Utils::projection_to_float(camera_parameters.ivp, IVP);
     camera_parameters.cameraPosition = Vector4(camera_position.x, camera_position.y, camera_position.z, 1.0f);
     camera_parameters.frame_index++;
@@ -288,72 +555,60 @@ void VoxelCamera::render()
     uint64_t camera_update_end = Time::get_singleton()->get_ticks_usec();
     _time_camera_update_us = camera_update_end - camera_update_start;
 
-    // Update projectile buffers
+    const bool objects_changed = _projectile_count_dirty || _entity_count_dirty ||
+                                 std::any_of(_projectile_dirty.begin(), _projectile_dirty.end(), [](uint64_t w) { return w != 0; }) ||
+                                 std::any_of(_entity_dirty.begin(), _entity_dirty.end(), [](uint64_t w) { return w != 0; });
+    upload_projectiles();
+    upload_entities();
+    if (objects_changed)
+        update_object_bvh();
+
+    // the passes are only recorded here and submitted with the frame, their GPU times come from the timestamps
+    read_gpu_timestamps();
+    _rd->capture_timestamp(TIMESTAMP_BEGIN);
+
+    if (render_parameters.beam_prepass != 0)
     {
-        // Count active projectiles and pack data
-        int count = 0;
-        PackedByteArray spheres;
-        spheres.resize(sizeof(float) * 4 * MAX_PROJECTILES);
-        uint8_t *ptr = spheres.ptrw();
-
-        for (int i = 0; i < MAX_PROJECTILES; ++i) {
-            const ProjectileEntry &e = _projectiles[i];
-            Vector4 v = e.active ? e.data : Vector4(0,0,0,0);
-            std::memcpy(ptr + i * sizeof(float) * 4, &v, sizeof(float) * 4);
-            if (e.active) count++;
-        }
-        _projectile_params.projectile_count = count;
-        cs->update_storage_buffer_uniform(projectile_parameters_rid, _projectile_params.to_packed_byte_array());
-        cs->update_storage_buffer_uniform(projectile_spheres_rid, spheres);
+        uint64_t beam_start = Time::get_singleton()->get_ticks_usec();
+        const int tiles_x = (render_parameters.width + BEAM_TILE_SIZE - 1) / BEAM_TILE_SIZE;
+        const int tiles_y = (render_parameters.height + BEAM_TILE_SIZE - 1) / BEAM_TILE_SIZE;
+        beam_cs->compute({(tiles_x + 7) / 8, (tiles_y + 7) / 8, 1}, false);
+        _rd->capture_timestamp(TIMESTAMP_BEAM);
+        _time_beam_prepass_us = Time::get_singleton()->get_ticks_usec() - beam_start;
     }
 
-    // Update entity buffers
+    if (render_parameters.object_binning != 0)
     {
-        // Count active entities and pack descriptors
-        int count = 0;
-        PackedByteArray descriptors_data;
-        descriptors_data.resize(sizeof(EntityDescriptor) * MAX_ENTITIES);
-        uint8_t *ptr = descriptors_data.ptrw();
-
-        for (int i = 0; i < MAX_ENTITIES; ++i) {
-            const EntityEntry &e = _entities[i];
-            if (e.active) {
-                std::memcpy(ptr + i * sizeof(EntityDescriptor), &e.descriptor, sizeof(EntityDescriptor));
-                count++;
-            } else {
-                // Zero out inactive slots
-                memset(ptr + i * sizeof(EntityDescriptor), 0, sizeof(EntityDescriptor));
-            }
-        }
-        _entity_count.entity_count = count;
-
-        // DEBUG: Print entity count every 60 frames
-        static int debug_frame = 0;
-        if (++debug_frame % 60 == 0 && count > 0) {
-            UtilityFunctions::print("VoxelCamera render: entity_count=", count);
-            for (int i = 0; i < MAX_ENTITIES; ++i) {
-                if (_entities[i].active) {
-                    UtilityFunctions::print("  Entity ", i, " enabled=", _entities[i].descriptor.enabled);
-                }
-            }
-        }
-
-        cs->update_storage_buffer_uniform(entity_count_rid, _entity_count.to_packed_byte_array());
-        cs->update_storage_buffer_uniform(entity_descriptors_rid, descriptors_data);
+        uint64_t binning_start = Time::get_singleton()->get_ticks_usec();
+        const int tiles_x = (render_parameters.width + BIN_TILE_SIZE - 1) / BIN_TILE_SIZE;
+        const int tiles_y = (render_parameters.height + BIN_TILE_SIZE - 1) / BIN_TILE_SIZE;
+        binning_cs->compute({(tiles_x + 7) / 8, (tiles_y + 7) / 8, 1}, false);
+        _rd->capture_timestamp(TIMESTAMP_BINNING);
+        _time_object_binning_us = Time::get_singleton()->get_ticks_usec() - binning_start;
     }
 
     // render
     uint64_t raymarching_start = Time::get_singleton()->get_ticks_usec();
     Vector2i Size = {render_parameters.width, render_parameters.height};
-    cs->compute({static_cast<int32_t>(std::ceil(Size.x / 32.0f)), static_cast<int32_t>(std::ceil(Size.y / 32.0f)), 1}, true);  // Enable sync for GPU timing
+    cs->compute({static_cast<int32_t>(std::ceil(Size.x / 32.0f)), static_cast<int32_t>(std::ceil(Size.y / 32.0f)), 1}, false);
+    _rd->capture_timestamp(TIMESTAMP_RAYMARCHING);
     uint64_t raymarching_end = Time::get_singleton()->get_ticks_usec();
     _time_raymarching_us = raymarching_end - raymarching_start;
-    _gpu_time_raymarching_ms = cs->get_last_gpu_time_ms();
 
     { // post processing
-
+        VoxelParticleSystem *particle_system = voxel_world->get_particle_system();
+        if (particle_splat_cs != nullptr && particle_splat_cs->check_ready() && particle_system != nullptr)
+        {
+            const int group_size = 64;
+            const int capacity = particle_system->get_rids().capacity;
+            particle_splat_cs->compute({(capacity + group_size - 1) / group_size, 1, 1}, false);
+        }
     }
 
+    upscale(VP, camera_position, jitter);
+    _rd->capture_timestamp(TIMESTAMP_END);
+    update_render_scale();
+
     // output_image->set_data(Size.x, Size.y, false, Image::FORMAT_RGBA8,
     //                        cs->get_image_uniform_buffer(output_texture_rid));
     // output_texture->update(output_image);
@@ -362,94 +617,408 @@ void VoxelCamera::render()
     _time_total_render_us = render_end - render_start;
 }
 
+void VoxelCamera::update_render_parameters()
+{
+    const int width = std::max(1, int(std::round(_output_size.x * render_scale)));
+    const int height = std::max(1, int(std::round(_output_size.y * render_scale)));
+    const int beam = beam_prepass && beam_cs != nullptr && beam_cs->check_ready() ? 1 : 0;
+    const int binning = object_binning && binning_cs != nullptr && binning_cs->check_ready() ? 1 : 0;
+    if (width == render_parameters.width && height == render_parameters.height &&
+        beam == render_parameters.beam_prepass && binning == render_parameters.object_binning)
+        return;
+    render_parameters.width = width;
+    render_parameters.height = height;
+    render_parameters.beam_prepass = beam;
+    render_parameters.object_binning = binning;
+    cs->update_storage_buffer_uniform(render_parameters_rid, render_parameters.to_packed_byte_array());
+}
+
+void VoxelCamera::read_gpu_timestamps()
+{
+    // the timestamps of the previous frame, the device keeps them until the frame slot comes around again
+    uint64_t begin = 0, beam = 0, binning = 0, raymarching = 0, end = 0;
+    const uint32_t count = _rd->get_captured_timestamps_count();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const String name = _rd->get_captured_timestamp_name(i);
+        const uint64_t time = _rd->get_captured_timestamp_gpu_time(i); // microseconds
+        if (name == TIMESTAMP_BEGIN)
+            begin = time;
+        else if (name == TIMESTAMP_BEAM)
+            beam = time;
+        else if (name == TIMESTAMP_BINNING)
+            binning = time;
+        else if (name == TIMESTAMP_RAYMARCHING)
+            raymarching = time;
+        else if (name == TIMESTAMP_END)
+            end = time;
+    }
+    if (begin == 0 || raymarching < begin || end < raymarching)
+        return;
+
+    // each pass runs from the timestamp before it, skipped passes have none
+    auto ms = [](uint64_t from, uint64_t to) { return to > from ? (to - from) / 1000.0f : 0.0f; };
+    uint64_t last = begin;
+    _gpu_time_beam_prepass_ms = beam >= last ? ms(last, beam) : 0.0f;
+    last = std::max(last, beam);
+    _gpu_time_object_binning_ms = binning >= last ? ms(last, binning) : 0.0f;
+    last = std::max(last, binning);
+    _gpu_time_raymarching_ms = ms(last, raymarching);
+    _gpu_time_upscale_ms = ms(raymarching, end); // with the particle splat
+    _gpu_time_total_ms = ms(begin, end);
+}
+
+void VoxelCamera::update_render_scale()
+{
+    if (!dynamic_resolution || _gpu_time_total_ms <= 0.0f)
+        return;
+    // the time of the whole frame, most of it the ray marching, is roughly proportional to the pixel count, the
+    // square of the scale. Move a tenth of the way each frame so a single slow frame does not make the image jump.
+    const float ideal = render_scale * std::sqrt(target_gpu_time_ms / _gpu_time_total_ms);
+    render_scale = std::clamp(render_scale + (ideal - render_scale) * 0.1f, min_render_scale, max_render_scale);
+}
+
+void VoxelCamera::upscale(const Projection &view_projection, const Vector3 &camera_position, const Vector2 &jitter)
+{
+    if (upscale_cs == nullptr || !upscale_cs->check_ready())
+        return;
+
+    uint64_t upscale_start = Time::get_singleton()->get_ticks_usec();
+    const Vector3i groups = {(_output_size.x + 7) / 8, (_output_size.y + 7) / 8, 1};
+    Utils::projection_to_float(upscale_parameters.prev_vp, _history_valid ? _prev_view_projection : view_projection);
+    Utils::projection_to_float(upscale_parameters.ivp, view_projection.inverse());
+    upscale_parameters.cameraPosition = Vector4(camera_position.x, camera_position.y, camera_position.z, 1.0f);
+    upscale_parameters.render_width = render_parameters.width;
+    upscale_parameters.render_height = render_parameters.height;
+    upscale_parameters.jitter_x = jitter.x;
+    upscale_parameters.jitter_y = jitter.y;
+    upscale_parameters.history_weight = temporal_upscale ? temporal_blend : 0.0f;
+    upscale_parameters.history_valid = _history_valid ? 1u : 0u;
+    upscale_parameters.mode = 0; // resolve
+    upscale_cs->update_storage_buffer_uniform(upscale_parameters_rid, upscale_parameters.to_packed_byte_array());
+    upscale_cs->compute(groups, false);
+
+    if (temporal_upscale)
+    {
+        upscale_parameters.mode = 1; // keep the output for the next frame
+        upscale_cs->update_storage_buffer_uniform(upscale_parameters_rid, upscale_parameters.to_packed_byte_array());
+        upscale_cs->compute(groups, false);
+        _prev_view_projection = view_projection;
+    }
+    _history_valid = temporal_upscale;
+    _time_upscale_us = Time::get_singleton()->get_ticks_usec() - upscale_start;
+}
+
+void VoxelCamera::grow_projectiles()
+{
+    const int old_size = _projectiles.size();
+    const int new_size = std::max(old_size * 2, int(INITIAL_PROJECTILE_CAPACITY));
+    _projectiles.resize(new_size);
+    for (int i = old_size; i < new_size; ++i)
+    {
+        _projectiles.write[i].data = Vector4(0, 0, 0, 0);
+        _projectiles.write[i].active = false;
+    }
+    _projectile_dirty.resize((new_size + 63) / 64, 0);
+}
+
+void VoxelCamera::grow_entities()
+{
+    const int old_size = _entities.size();
+    const int new_size = std::max(old_size * 2, int(INITIAL_ENTITY_CAPACITY));
+    _entities.resize(new_size);
+    for (int i = old_size; i < new_size; ++i)
+    {
+        _entities.write[i].active = false;
+        _entities.write[i].model = -1;
+        memset(&_entities.write[i].descriptor, 0, sizeof(EntityDescriptor));
+    }
+    _entity_dirty.resize((new_size + 63) / 64, 0);
+}
+
+void VoxelCamera::update_object_bvh()
+{
+    uint64_t bvh_start = Time::get_singleton()->get_ticks_usec();
+    _object_bvh.clear();
+    for (int i = 0; i < _projectile_slots_used; ++i)
+    {
+        const Vector4 &sphere = _projectiles[i].data;
+        if (_projectiles[i].active && sphere.w > 0.0f)
+            _object_bvh.add(AABB(Vector3(sphere.x, sphere.y, sphere.z) - Vector3(sphere.w, sphere.w, sphere.w),
+                                 Vector3(sphere.w, sphere.w, sphere.w) * 2.0f),
+                            ObjectBvh::LEAF_BIT | uint32_t(i));
+    }
+    for (int i = 0; i < _entity_slots_used; ++i)
+    {
+        const EntityDescriptor &desc = _entities[i].descriptor;
+        if (!_entities[i].active || desc.enabled == 0)
+            continue;
+        // world bounds of the oriented local box, the same as object_binning.glsl
+        const float *m = desc.local_to_world;
+        const Vector3 aabb_min(desc.aabb_min.x, desc.aabb_min.y, desc.aabb_min.z);
+        const Vector3 aabb_max(desc.aabb_max.x, desc.aabb_max.y, desc.aabb_max.z);
+        const Vector3 center = (aabb_min + aabb_max) * 0.5f;
+        const Vector3 half = (aabb_max - aabb_min) * 0.5f;
+        Vector3 world_center(m[12], m[13], m[14]);
+        Vector3 extent;
+        for (int row = 0; row < 3; ++row)
+            for (int column = 0; column < 3; ++column)
+            {
+                world_center[row] += m[column * 4 + row] * center[column];
+                extent[row] += std::abs(m[column * 4 + row]) * half[column];
+            }
+        _object_bvh.add(AABB(world_center - extent, extent * 2.0f),
+                        ObjectBvh::LEAF_BIT | ObjectBvh::ENTITY_BIT | uint32_t(i));
+    }
+    _object_bvh.build();
+
+    const std::vector<ObjectBvh::Node> &nodes = _object_bvh.get_nodes();
+    const int64_t size = sizeof(uint32_t) * 4 + sizeof(ObjectBvh::Node) * nodes.size();
+    uint32_t *header = reinterpret_cast<uint32_t *>(_bvh_staging.ptrw());
+    header[0] = uint32_t(nodes.size());
+    if (!nodes.empty())
+        std::memcpy(header + 4, nodes.data(), sizeof(ObjectBvh::Node) * nodes.size());
+    _rd->buffer_update(object_bvh_rid, 0, size, _bvh_staging.slice(0, size));
+    _time_object_bvh_us = Time::get_singleton()->get_ticks_usec() - bvh_start;
+}
+
+void VoxelCamera::upload_projectiles()
+{
+    // the shader scans the slots below the count, removed slots in that range are zero spheres
+    if (_projectile_count_dirty)
+    {
+        _projectile_params.projectile_count = _projectile_slots_used;
+        cs->update_storage_buffer_uniform(projectile_parameters_rid, _projectile_params.to_packed_byte_array());
+        _projectile_count_dirty = false;
+    }
+    upload_dirty_slots(_rd, projectile_spheres_rid, _projectile_staging, sizeof(Vector4), _gpu_projectile_capacity,
+                       _projectile_dirty, [this](int slot, uint8_t *dst) {
+                           const ProjectileEntry &e = _projectiles[slot];
+                           const Vector4 v = e.active ? e.data : Vector4(0, 0, 0, 0);
+                           std::memcpy(dst, &v, sizeof(Vector4));
+                       });
+}
+
+void VoxelCamera::upload_entity_pool()
+{
+    // new models since the last frame, the pool hands out the ranges that changed
+    uint32_t brick_first, brick_end, block_first, block_end;
+    _entity_pool.take_dirty(brick_first, brick_end, block_first, block_end);
+    if (brick_end > brick_first)
+    {
+        const int64_t size = sizeof(Brick) * (brick_end - brick_first);
+        PackedByteArray data;
+        data.resize(size);
+        std::memcpy(data.ptrw(), _entity_pool.get_bricks().data() + brick_first, size);
+        _rd->buffer_update(entity_bricks_rid, sizeof(Brick) * brick_first, size, data);
+    }
+    if (block_end > block_first)
+    {
+        const uint32_t voxel_first = block_first * VoxelWorldProperties::BRICK_VOLUME;
+        const int64_t size = sizeof(Voxel) * (block_end - block_first) * VoxelWorldProperties::BRICK_VOLUME;
+        PackedByteArray data;
+        data.resize(size);
+        std::memcpy(data.ptrw(), _entity_pool.get_voxels().data() + voxel_first, size);
+        _rd->buffer_update(entity_voxels_rid, sizeof(Voxel) * voxel_first, size, data);
+    }
+}
+
+void VoxelCamera::upload_entities()
+{
+    upload_entity_pool();
+    // removed entities are zeroed, so they are disabled descriptors for the shader
+    if (_entity_count_dirty)
+    {
+        _entity_count.entity_count = _entity_slots_used;
+        cs->update_storage_buffer_uniform(entity_count_rid, _entity_count.to_packed_byte_array());
+        _entity_count_dirty = false;
+    }
+    upload_dirty_slots(_rd, entity_descriptors_rid, _entity_staging, sizeof(EntityDescriptor), _gpu_entity_capacity,
+                       _entity_dirty, [this](int slot, uint8_t *dst) {
+                           std::memcpy(dst, &_entities[slot].descriptor, sizeof(EntityDescriptor));
+                       });
+}
+
 // ---------------- Projectile API ----------------
 int VoxelCamera::register_projectile(const Vector3 &position, float radius)
 {
-    for (int i = 0; i < MAX_PROJECTILES; ++i) {
+    for (int i = 0;; ++i) {
+        if (i == _projectiles.size())
+            grow_projectiles(); // the GPU buffer follows on the next render
         if (!_projectiles[i].active) {
             _projectiles.write[i].active = true;
             _projectiles.write[i].data = Vector4(position.x, position.y, position.z, radius);
+            mark_dirty(_projectile_dirty, i);
+            if (i >= _projectile_slots_used)
+            {
+                _projectile_slots_used = i + 1;
+                _projectile_count_dirty = true;
+            }
             return i;
         }
     }
-    UtilityFunctions::push_warning("VoxelCamera: Max projectiles reached, cannot register more.");
-    return -1;
 }
 
 void VoxelCamera::update_projectile(int id, const Vector3 &position, float radius)
 {
-    if (id < 0 || id >= MAX_PROJECTILES) return;
+    if (id < 0 || id >= _projectiles.size()) return;
     if (!_projectiles[id].active) return;
-    _projectiles.write[id].data = Vector4(position.x, position.y, position.z, radius);
+    const Vector4 data(position.x, position.y, position.z, radius);
+    if (_projectiles[id].data == data) return; // unchanged, keep the slot and the bvh as they are
+    _projectiles.write[id].data = data;
+    mark_dirty(_projectile_dirty, id);
+}
+
+void VoxelCamera::update_projectiles(const PackedInt32Array &ids, const PackedVector4Array &data)
+{
+    const int64_t count = std::min(ids.size(), data.size());
+    const int32_t *id_ptr = ids.ptr();
+    const Vector4 *data_ptr = data.ptr();
+    ProjectileEntry *entries = _projectiles.ptrw();
+    for (int64_t i = 0; i < count; ++i)
+    {
+        const int id = id_ptr[i];
+        // the gatherer sends every projectile every frame, only moved ones are uploaded
+        if (id < 0 || id >= _projectiles.size() || !entries[id].active || entries[id].data == data_ptr[i])
+            continue;
+        entries[id].data = data_ptr[i];
+        mark_dirty(_projectile_dirty, id);
+    }
 }
 
 void VoxelCamera::remove_projectile(int id)
 {
-    if (id < 0 || id >= MAX_PROJECTILES) return;
+    if (id < 0 || id >= _projectiles.size()) return;
     _projectiles.write[id].active = false;
     _projectiles.write[id].data = Vector4(0,0,0,0);
+    mark_dirty(_projectile_dirty, id);
+    // shrink the scanned range past the trailing free slots
+    while (_projectile_slots_used > 0 && !_projectiles[_projectile_slots_used - 1].active)
+    {
+        _projectile_slots_used--;
+        _projectile_count_dirty = true;
+    }
 }
 
 // ---------------- Entity API ----------------
 int VoxelCamera::register_entity(const Transform3D &transform, const Vector3 &aabb_size, float scale)
 {
-    for (int i = 0; i < MAX_ENTITIES; ++i) {
+    const Vector3i size = Vector3i((aabb_size / scale).round()).max(Vector3i(1, 1, 1));
+    const String key = "box:" + String::num_int64(size.x) + "," + String::num_int64(size.y) + "," +
+                       String::num_int64(size.z);
+    int model = _entity_pool.acquire(key);
+    if (model < 0)
+    {
+        // the solid box these entities always were
+        const Voxel solid = Voxel::create_solid_voxel(Color(0.2f, 0.9f, 0.45f));
+        model = _entity_pool.add(key, size, [&](const Vector3i &) { return solid; });
+    }
+    return add_entity(transform, model, scale, 100.0f);
+}
+
+int VoxelCamera::register_voxel_entity(VoxelEntity *entity)
+{
+    if (entity == nullptr)
+        return -1;
+    const String key = entity->get_model_key();
+    int model = _entity_pool.acquire(key);
+    if (model < 0)
+    {
+        entity->load_model();
+        model = _entity_pool.add(key, entity->get_model_size(),
+                                 [entity](const Vector3i &pos) { return entity->get_model_voxel(pos); });
+    }
+    return add_entity(entity->get_global_transform(), model, entity->get_voxel_scale(), entity->get_health());
+}
+
+int VoxelCamera::add_entity(const Transform3D &transform, int model, float scale, float health)
+{
+    for (int i = 0;; ++i) {
+        if (i == _entities.size())
+            grow_entities(); // the GPU buffer follows on the next render
         if (!_entities[i].active) {
             _entities.write[i].active = true;
+            _entities.write[i].model = model;
             EntityDescriptor &desc = _entities.write[i].descriptor;
 
-            // Set transforms using proper transform_to_float utility
             Utils::transform_to_float(desc.local_to_world, transform);
-            Transform3D inv_transform = transform.affine_inverse();
-            Utils::transform_to_float(desc.world_to_local, inv_transform);
-
-            // Set AABB
-            desc.aabb_min = Vector4(-aabb_size.x/2, -aabb_size.y/2, -aabb_size.z/2, 0);
-            desc.aabb_max = Vector4(aabb_size.x/2, aabb_size.y/2, aabb_size.z/2, 0);
-
-            // For now, set dummy grid size (will populate with real voxel data later)
-            desc.grid_size = Vector4(16, 16, 16, 0);
-            desc.brick_grid_size = Vector4(2, 2, 2, 0);
+            Utils::transform_to_float(desc.world_to_local, transform.affine_inverse());
+
+            // the local box is the voxel grid of the model, centered on the origin
+            const EntityBrickPool::Model &m = _entity_pool.get_model(model);
+            const Vector3 half = Vector3(m.grid_size) * scale * 0.5f;
+            desc.aabb_min = Vector4(-half.x, -half.y, -half.z, 0);
+            desc.aabb_max = Vector4(half.x, half.y, half.z, 0);
+            desc.grid_size = Vector4(m.grid_size.x, m.grid_size.y, m.grid_size.z, 0);
+            desc.brick_grid_size = Vector4(m.brick_grid_size.x, m.brick_grid_size.y, m.brick_grid_size.z, 0);
             desc.scale = scale;
-            desc.brick_offset = 0;
-            desc.voxel_offset = 0;
-            desc.brick_count = 0;
+            desc.brick_offset = m.brick_offset;
+            desc.voxel_offset = m.voxel_offset;
+            desc.brick_count = m.brick_count;
             desc.enabled = 1;
-            desc.health = 100.0f;
+            desc.health = health;
             desc._pad0 = desc._pad1 = desc._pad2 = 0.0f;
 
-            UtilityFunctions::print("VoxelCamera: Registered entity ", i,
-                " at pos ", transform.origin,
-                " with AABB min ", desc.aabb_min, " max ", desc.aabb_max,
-                " enabled=", desc.enabled);
-
-            // DEBUG: Print first few matrix values to verify
-            UtilityFunctions::print("  local_to_world[0-3]: ", desc.local_to_world[0], ", ", desc.local_to_world[1], ", ", desc.local_to_world[2], ", ", desc.local_to_world[3]);
-            UtilityFunctions::print("  world_to_local[0-3]: ", desc.world_to_local[0], ", ", desc.world_to_local[1], ", ", desc.world_to_local[2], ", ", desc.world_to_local[3]);
-
+            mark_dirty(_entity_dirty, i);
+            if (i >= _entity_slots_used)
+            {
+                _entity_slots_used = i + 1;
+                _entity_count_dirty = true;
+            }
             return i;
         }
     }
-    UtilityFunctions::push_warning("VoxelCamera: Max entities reached, cannot register more.");
-    return -1;
 }
 
 void VoxelCamera::update_entity(int id, const Transform3D &transform)
 {
-    if (id < 0 || id >= MAX_ENTITIES) return;
+    if (id < 0 || id >= _entities.size()) return;
     if (!_entities[id].active) return;
+    set_entity_transform(id, transform);
+}
 
-    EntityDescriptor &desc = _entities.write[id].descriptor;
+void VoxelCamera::update_entities(const PackedInt32Array &ids, const PackedFloat32Array &transforms)
+{
+    const int64_t count = std::min(ids.size(), transforms.size() / 12);
+    const int32_t *id_ptr = ids.ptr();
+    const float *t = transforms.ptr();
+    for (int64_t i = 0; i < count; ++i, t += 12)
+    {
+        const int id = id_ptr[i];
+        if (id < 0 || id >= _entities.size() || !_entities[id].active)
+            continue;
+        set_entity_transform(id, Transform3D(Basis(Vector3(t[0], t[1], t[2]), Vector3(t[3], t[4], t[5]),
+                                                   Vector3(t[6], t[7], t[8])),
+                                             Vector3(t[9], t[10], t[11])));
+    }
+}
 
-    // Update transforms using proper transform_to_float utility
-    Utils::transform_to_float(desc.local_to_world, transform);
+void VoxelCamera::set_entity_transform(int id, const Transform3D &transform)
+{
+    // the gatherer sends every entity every frame, idle ones keep their slot and the bvh as they are
+    float local_to_world[16];
+    Utils::transform_to_float(local_to_world, transform);
+    if (std::memcmp(local_to_world, _entities[id].descriptor.local_to_world, sizeof(local_to_world)) == 0)
+        return;
+
+    EntityDescriptor &desc = _entities.write[id].descriptor;
+    std::memcpy(desc.local_to_world, local_to_world, sizeof(local_to_world));
     Transform3D inv_transform = transform.affine_inverse();
     Utils::transform_to_float(desc.world_to_local, inv_transform);
+    mark_dirty(_entity_dirty, id);
 }
 
 void VoxelCamera::remove_entity(int id)
 {
-    if (id < 0 || id >= MAX_ENTITIES) return;
+    if (id < 0 || id >= _entities.size() || !_entities[id].active) return;
+    _entity_pool.release(_entities[id].model);
     _entities.write[id].active = false;
+    _entities.write[id].model = -1;
     memset(&_entities.write[id].descriptor, 0, sizeof(EntityDescriptor));
+    mark_dirty(_entity_dirty, id);
+    while (_entity_slots_used > 0 && !_entities[_entity_slots_used - 1].active)
+    {
+        _entity_slots_used--;
+        _entity_count_dirty = true;
+    }
 }
@@ -17,17 +17,24 @@
 #include <godot_cpp/classes/display_server.hpp>
 #include <godot_cpp/classes/time.hpp>
 #include <voxel_world.h>
+#include "entity_brick_pool.h"
+#include "object_bvh.h"
+#include <algorithm>
+#include <vector>
 
 using namespace godot;
 
+class VoxelEntity;
+
 class VoxelCamera : public Node3D
 {
     GDCLASS(VoxelCamera, Node3D);
 
   public:
 
-    static constexpr int MAX_PROJECTILES = 64;
-    static constexpr int MAX_ENTITIES = 32;
+    // the object buffers start at these sizes and double whenever registration runs out of slots
+    static constexpr int INITIAL_PROJECTILE_CAPACITY = 64;
+    static constexpr int INITIAL_ENTITY_CAPACITY = 32;
 
     struct RenderParameters // match the struct on the gpu
     {
@@ -35,6 +42,8 @@ class VoxelCamera : public Node3D
         int width;
         int height;
         float fov;
+        int beam_prepass;
+        int object_binning;
 
         PackedByteArray to_packed_byte_array()
         {
@@ -63,6 +72,32 @@ class VoxelCamera : public Node3D
         }
     };
 
+    struct UpscaleParameters // match the struct on the gpu
+    {
+        float prev_vp[16];
+        float ivp[16];
+        Vector4 cameraPosition;
+        int render_width;
+        int render_height;
+        int output_width;
+        int output_height;
+        float jitter_x;
+        float jitter_y;
+        float history_weight;
+        float farPlane;
+        uint32_t mode;
+        uint32_t history_valid;
+        float _pad0, _pad1;
+
+        PackedByteArray to_packed_byte_array()
+        {
+            PackedByteArray byte_array;
+            byte_array.resize(sizeof(UpscaleParameters));
+            std::memcpy(byte_array.ptrw(), this, sizeof(UpscaleParameters));
+            return byte_array;
+        }
+    };
+
     struct ProjectileParameters // gpu struct: current projectile count
     {
         int projectile_count;
@@ -129,36 +164,95 @@ class VoxelCamera : public Node3D
     VoxelWorld *get_voxel_world() const;
     void set_voxel_world(VoxelWorld* value);
 
+    // ---------------- Resolution ----------------
+    // The world is ray marched at render_scale times the window size and upscaled to output_texture. With
+    // dynamic_resolution the scale follows the GPU time of the whole camera frame towards target_gpu_time_ms. With
+    // temporal_upscale the rays are jittered every frame and the previous output is reprojected and blended in.
+    bool get_dynamic_resolution() const { return dynamic_resolution; }
+    void set_dynamic_resolution(bool value) { dynamic_resolution = value; }
+    float get_target_gpu_time_ms() const { return target_gpu_time_ms; }
+    void set_target_gpu_time_ms(float value) { target_gpu_time_ms = std::max(value, 0.1f); }
+    float get_min_render_scale() const { return min_render_scale; }
+    void set_min_render_scale(float value);
+    float get_max_render_scale() const { return max_render_scale; }
+    void set_max_render_scale(float value);
+    float get_render_scale() const { return render_scale; }
+    void set_render_scale(float value);
+    bool get_temporal_upscale() const { return temporal_upscale; }
+    void set_temporal_upscale(bool value) { temporal_upscale = value; }
+    float get_temporal_blend() const { return temporal_blend; }
+    void set_temporal_blend(float value) { temporal_blend = std::clamp(value, 0.0f, 0.98f); }
+    // Marches one cone per 8x8 pixel tile first, the primary rays of the tile skip the empty space it found.
+    bool get_beam_prepass() const { return beam_prepass; }
+    void set_beam_prepass(bool value) { beam_prepass = value; }
+    // Bins the projectiles and entities into 32x32 pixel tiles first, pixels only test the objects of their tile.
+    bool get_object_binning() const { return object_binning; }
+    void set_object_binning(bool value) { object_binning = value; }
+    Vector2i get_render_size() const { return Vector2i(render_parameters.width, render_parameters.height); }
+
     // Performance profiling getters (returns milliseconds)
     float get_time_camera_update() const { return _time_camera_update_us / 1000.0f; }
     float get_time_raymarching() const { return _time_raymarching_us / 1000.0f; }
     float get_time_total_render() const { return _time_total_render_us / 1000.0f; }
+    float get_time_upscale() const { return _time_upscale_us / 1000.0f; }
+    float get_time_beam_prepass() const { return _time_beam_prepass_us / 1000.0f; }
+    float get_time_object_binning() const { return _time_object_binning_us / 1000.0f; }
+    float get_time_object_bvh() const { return _time_object_bvh_us / 1000.0f; }
 
-    // GPU timing getter (returns milliseconds)
+    // GPU timing getter (returns milliseconds), measured with timestamps, so they lag one frame
     float get_gpu_time_raymarching() const { return _gpu_time_raymarching_ms; }
+    float get_gpu_time_upscale() const { return _gpu_time_upscale_ms; }
+    float get_gpu_time_beam_prepass() const { return _gpu_time_beam_prepass_ms; }
+    float get_gpu_time_object_binning() const { return _gpu_time_object_binning_ms; }
+    float get_gpu_time_total() const { return _gpu_time_total_ms; }
 
     // ---------------- Projectile (ray-marched) API ----------------
     // Register a sphere projectile to be ray-marched. Returns an id to update/remove later.
     int register_projectile(const Vector3 &position, float radius);
     void update_projectile(int id, const Vector3 &position, float radius);
     void remove_projectile(int id);
+    // one call for many projectiles: data[i] = vec4(position, radius) of ids[i], unknown ids are skipped
+    void update_projectiles(const PackedInt32Array &ids, const PackedVector4Array &data);
 
     // ---------------- Entity (voxel-based) API ----------------
-    // Register a voxel entity. Returns an id to update/remove later.
+    // Register a voxel entity. Returns an id to update/remove later. The model is a solid box of aabb_size at scale
+    // world units per voxel, shared by all entities of the same size.
     int register_entity(const Transform3D &transform, const Vector3 &aabb_size, float scale);
+    // the model of the VoxelEntity, built once per model key
+    int register_voxel_entity(VoxelEntity *entity);
     void update_entity(int id, const Transform3D &transform);
     void remove_entity(int id);
+    // 12 floats per id: basis x, y and z axis, then the origin
+    void update_entities(const PackedInt32Array &ids, const PackedFloat32Array &transforms);
 
   private:
     void init();
     void update(double delta);
     void clear_compute_shader();
     void render();
+    void update_render_parameters();
+    // the GPU times of the previous frame from its timestamps
+    void read_gpu_timestamps();
+    void update_render_scale();
+    void upscale(const Projection &view_projection, const Vector3 &camera_position, const Vector2 &jitter);
 
     float fov = 90.0f;
+    bool dynamic_resolution = true;
+    float target_gpu_time_ms = 8.0f;
+    float min_render_scale = 0.5f;
+    float max_render_scale = 1.0f;
+    float render_scale = 1.0f;
+    bool temporal_upscale = true;
+    float temporal_blend = 0.9f; // weight of the reprojected history
+    bool beam_prepass = true;
+    bool object_binning = true;
     // int num_bounces = 4;
 
     ComputeShader *cs = nullptr;
+    ComputeShader *particle_splat_cs = nullptr;
+    ComputeShader *upscale_cs = nullptr;
+    ComputeShader *beam_cs = nullptr;
+    ComputeShader *binning_cs = nullptr;
     TextureRect *output_texture_rect = nullptr;
     VoxelWorld *voxel_world = nullptr;
     Ref<Image> output_image;
@@ -167,39 +261,89 @@ class VoxelCamera : public Node3D
 
     RenderParameters render_parameters;
     CameraParameters camera_parameters;
+    UpscaleParameters upscale_parameters;
     Projection projection_matrix;
+    Projection _prev_view_projection; // without jitter
+    bool _history_valid = false;
+    Vector2i _output_size;
 
     // BUFFER IDs
-    RID output_texture_rid;
+    RID render_texture_rid;  // window sized, the ray marcher fills the top left render_size pixels
+    RID output_texture_rid;  // window sized, upscaled
+    RID history_texture_rid; // output of the previous frame
+    RID upscale_parameters_rid;
+    RID beam_texture_rid;    // start distance per 8x8 tile
+    RID object_bins_rid;     // projectile and entity lists per 32x32 tile
+    RID object_bvh_rid;      // node count, then the ObjectBvh nodes
     RID depth_texture_rid;
     RID render_parameters_rid;
     RID camera_parameters_rid;
     RID projectile_parameters_rid;
     RID projectile_spheres_rid;
     RID entity_count_rid;
-    RID entity_bricks_rid;
-    RID entity_voxels_rid;
+    RID entity_bricks_rid;   // bricks of the entity models, see EntityBrickPool
+    RID entity_voxels_rid;   // voxel blocks of the occupied model bricks
     RID entity_descriptors_rid;
     RenderingDevice *_rd;
 
     // CPU-side projectile cache. Packed as vec4(x,y,z,radius) per element.
     // We keep a free-list of ids for reuse.
     struct ProjectileEntry { Vector4 data; bool active; };
-    Vector<ProjectileEntry> _projectiles; // fixed capacity MAX_PROJECTILES
+    Vector<ProjectileEntry> _projectiles; // grows by doubling
     ProjectileParameters _projectile_params;
 
     // CPU-side entity cache
-    struct EntityEntry { EntityDescriptor descriptor; bool active; };
-    Vector<EntityEntry> _entities; // fixed capacity MAX_ENTITIES
+    struct EntityEntry { EntityDescriptor descriptor; bool active; int model; };
+    Vector<EntityEntry> _entities; // grows by doubling
     EntityCount _entity_count;
+    // voxel models of the entities, the descriptors point at their bricks and voxels
+    EntityBrickPool _entity_pool;
+
+    // Persistent staging copies of the GPU arrays. The API marks the slots it changes dirty, render uploads only
+    // those, merged into contiguous ranges. The counts are the used slot ranges and are uploaded when they change.
+    PackedByteArray _projectile_staging;
+    PackedByteArray _entity_staging;
+    std::vector<uint64_t> _projectile_dirty; // bit per slot
+    std::vector<uint64_t> _entity_dirty;
+    int _projectile_slots_used = 0;
+    int _entity_slots_used = 0;
+    bool _projectile_count_dirty = true;
+    bool _entity_count_dirty = true;
+    // slots of the GPU buffers, the caches outgrowing them re-creates the buffers and everything bound to them
+    int _gpu_projectile_capacity = 0;
+    int _gpu_entity_capacity = 0;
+    size_t _gpu_entity_brick_capacity = 0;
+    size_t _gpu_entity_voxel_capacity = 0;
+
+    // bounds of the active objects, refit when any of them moved, rebuilt when one was added or removed
+    ObjectBvh _object_bvh;
+    PackedByteArray _bvh_staging;
+
+    static void mark_dirty(std::vector<uint64_t> &dirty, int slot) { dirty[slot >> 6] |= 1ull << (slot & 63); }
+    int add_entity(const Transform3D &transform, int model, float scale, float health);
+    void set_entity_transform(int id, const Transform3D &transform);
+    void grow_projectiles();
+    void grow_entities();
+    void upload_projectiles();
+    void upload_entities();
+    void upload_entity_pool();
+    void update_object_bvh();
 
     // Performance profiling (microseconds)
     uint64_t _time_camera_update_us = 0;
     uint64_t _time_raymarching_us = 0;
     uint64_t _time_total_render_us = 0;
+    uint64_t _time_upscale_us = 0;
+    uint64_t _time_beam_prepass_us = 0;
+    uint64_t _time_object_binning_us = 0;
+    uint64_t _time_object_bvh_us = 0;
 
     // GPU timing (milliseconds)
     float _gpu_time_raymarching_ms = 0.0f;
+    float _gpu_time_upscale_ms = 0.0f;
+    float _gpu_time_beam_prepass_ms = 0.0f;
+    float _gpu_time_object_binning_ms = 0.0f;
+    float _gpu_time_total_ms = 0.0f;
 };
 
 #endif // PATH_TRACING_CAMERA_H
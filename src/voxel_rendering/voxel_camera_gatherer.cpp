@@ -0,0 +1,134 @@
+#include "voxel_camera_gatherer.h"
+#include <godot_cpp/classes/scene_tree.hpp>
+
+void VoxelCameraGatherer::_bind_methods()
+{
+    ClassDB::bind_method(D_METHOD("get_voxel_camera"), &VoxelCameraGatherer::get_voxel_camera);
+    ClassDB::bind_method(D_METHOD("set_voxel_camera", "camera"), &VoxelCameraGatherer::set_voxel_camera);
+    ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "voxel_camera", PROPERTY_HINT_NODE_TYPE, "VoxelCamera"),
+                 "set_voxel_camera", "get_voxel_camera");
+
+    ClassDB::bind_method(D_METHOD("get_projectile_group"), &VoxelCameraGatherer::get_projectile_group);
+    ClassDB::bind_method(D_METHOD("set_projectile_group", "group"), &VoxelCameraGatherer::set_projectile_group);
+    ADD_PROPERTY(PropertyInfo(Variant::STRING_NAME, "projectile_group"), "set_projectile_group",
+                 "get_projectile_group");
+    ClassDB::bind_method(D_METHOD("get_projectile_id_property"), &VoxelCameraGatherer::get_projectile_id_property);
+    ClassDB::bind_method(D_METHOD("set_projectile_id_property", "property"),
+                         &VoxelCameraGatherer::set_projectile_id_property);
+    ADD_PROPERTY(PropertyInfo(Variant::STRING_NAME, "projectile_id_property"), "set_projectile_id_property",
+                 "get_projectile_id_property");
+    ClassDB::bind_method(D_METHOD("get_radius_property"), &VoxelCameraGatherer::get_radius_property);
+    ClassDB::bind_method(D_METHOD("set_radius_property", "property"), &VoxelCameraGatherer::set_radius_property);
+    ADD_PROPERTY(PropertyInfo(Variant::STRING_NAME, "radius_property"), "set_radius_property",
+                 "get_radius_property");
+
+    ClassDB::bind_method(D_METHOD("get_entity_group"), &VoxelCameraGatherer::get_entity_group);
+    ClassDB::bind_method(D_METHOD("set_entity_group", "group"), &VoxelCameraGatherer::set_entity_group);
+    ADD_PROPERTY(PropertyInfo(Variant::STRING_NAME, "entity_group"), "set_entity_group", "get_entity_group");
+    ClassDB::bind_method(D_METHOD("get_entity_id_property"), &VoxelCameraGatherer::get_entity_id_property);
+    ClassDB::bind_method(D_METHOD("set_entity_id_property", "property"),
+                         &VoxelCameraGatherer::set_entity_id_property);
+    ADD_PROPERTY(PropertyInfo(Variant::STRING_NAME, "entity_id_property"), "set_entity_id_property",
+                 "get_entity_id_property");
+}
+
+void VoxelCameraGatherer::_notification(int p_what)
+{
+    if (godot::Engine::get_singleton()->is_editor_hint())
+    {
+        return;
+    }
+    switch (p_what)
+    {
+    case NOTIFICATION_ENTER_TREE: {
+        // before the camera renders, wherever the gatherer sits in the tree
+        set_process_priority(-1);
+        set_process_internal(true);
+        add_to_group(GROUP);
+        break;
+    }
+    case NOTIFICATION_EXIT_TREE: {
+        set_process_internal(false);
+        break;
+    }
+    case NOTIFICATION_INTERNAL_PROCESS: {
+        gather();
+        break;
+    }
+    }
+}
+
+void VoxelCameraGatherer::gather()
+{
+    if (voxel_camera == nullptr)
+    {
+        voxel_camera = Object::cast_to<VoxelCamera>(get_parent());
+        if (voxel_camera == nullptr)
+            voxel_camera = Object::cast_to<VoxelCamera>(get_tree()->get_first_node_in_group("voxel_camera"));
+        if (voxel_camera == nullptr)
+            return;
+    }
+
+    if (!projectile_group.is_empty())
+    {
+        TypedArray<Node> nodes = get_tree()->get_nodes_in_group(projectile_group);
+        _projectile_ids.resize(nodes.size());
+        _projectile_data.resize(nodes.size());
+        int32_t *ids = _projectile_ids.ptrw();
+        Vector4 *data = _projectile_data.ptrw();
+        int count = 0;
+        for (int64_t i = 0; i < nodes.size(); ++i)
+        {
+            Node3D *node = Object::cast_to<Node3D>(nodes[i]);
+            if (node == nullptr)
+                continue;
+            const Variant id_value = node->get(projectile_id_property);
+            if (id_value.get_type() != Variant::INT || int(id_value) < 0)
+                continue; // not registered with the camera (yet)
+            const int id = id_value;
+            const Vector3 position = node->get_global_position();
+            ids[count] = id;
+            data[count] = Vector4(position.x, position.y, position.z, float(node->get(radius_property)));
+            count++;
+        }
+        _projectile_ids.resize(count);
+        _projectile_data.resize(count);
+        voxel_camera->update_projectiles(_projectile_ids, _projectile_data);
+    }
+
+    if (!entity_group.is_empty())
+    {
+        TypedArray<Node> nodes = get_tree()->get_nodes_in_group(entity_group);
+        _entity_ids.resize(nodes.size());
+        _entity_transforms.resize(nodes.size() * 12);
+        int32_t *ids = _entity_ids.ptrw();
+        float *t = _entity_transforms.ptrw();
+        int count = 0;
+        for (int64_t i = 0; i < nodes.size(); ++i)
+        {
+            Node3D *node = Object::cast_to<Node3D>(nodes[i]);
+            if (node == nullptr)
+                continue;
+            const Variant id_value = node->get(entity_id_property);
+            if (id_value.get_type() != Variant::INT || int(id_value) < 0)
+                continue; // not registered with the camera (yet)
+            const int id = id_value;
+            const Transform3D transform = node->get_global_transform();
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const Vector3 column = transform.basis.get_column(axis);
+                t[count * 12 + axis * 3 + 0] = column.x;
+                t[count * 12 + axis * 3 + 1] = column.y;
+                t[count * 12 + axis * 3 + 2] = column.z;
+            }
+            t[count * 12 + 9] = transform.origin.x;
+            t[count * 12 + 10] = transform.origin.y;
+            t[count * 12 + 11] = transform.origin.z;
+            ids[count] = id;
+            count++;
+        }
+        _entity_ids.resize(count);
+        _entity_transforms.resize(count * 12);
+        voxel_camera->update_entities(_entity_ids, _entity_transforms);
+    }
+}
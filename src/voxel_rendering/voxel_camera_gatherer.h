@@ -0,0 +1,62 @@
+#ifndef VOXEL_CAMERA_GATHERER_H
+#define VOXEL_CAMERA_GATHERER_H
+
+#include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/packed_float32_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_vector4_array.hpp>
+#include <godot_cpp/variant/string_name.hpp>
+
+#include "voxel_camera.h"
+
+using namespace godot;
+
+// Pushes the positions of the projectiles and the transforms of the entities in two groups to a VoxelCamera once
+// per frame, so the nodes do not call update_projectile / update_entity from their scripts. Every node keeps its
+// camera id in a script variable, the names of those variables are configurable.
+class VoxelCameraGatherer : public Node
+{
+    GDCLASS(VoxelCameraGatherer, Node);
+
+  protected:
+    static void _bind_methods();
+
+  public:
+    static constexpr const char *GROUP = "voxel_camera_gatherer";
+
+    void _notification(int what);
+
+    VoxelCamera *get_voxel_camera() const { return voxel_camera; }
+    void set_voxel_camera(VoxelCamera *camera) { voxel_camera = camera; }
+
+    StringName get_projectile_group() const { return projectile_group; }
+    void set_projectile_group(const StringName &group) { projectile_group = group; }
+    StringName get_projectile_id_property() const { return projectile_id_property; }
+    void set_projectile_id_property(const StringName &property) { projectile_id_property = property; }
+    StringName get_radius_property() const { return radius_property; }
+    void set_radius_property(const StringName &property) { radius_property = property; }
+
+    StringName get_entity_group() const { return entity_group; }
+    void set_entity_group(const StringName &group) { entity_group = group; }
+    StringName get_entity_id_property() const { return entity_id_property; }
+    void set_entity_id_property(const StringName &property) { entity_id_property = property; }
+
+  private:
+    void gather();
+
+    VoxelCamera *voxel_camera = nullptr;
+    StringName projectile_group = "projectile";
+    StringName projectile_id_property = "_vm_id";
+    StringName radius_property = "radius_visual";
+    StringName entity_group = "enemy";
+    StringName entity_id_property = "_entity_id";
+
+    // reused every frame
+    PackedInt32Array _projectile_ids;
+    PackedVector4Array _projectile_data;
+    PackedInt32Array _entity_ids;
+    PackedFloat32Array _entity_transforms;
+};
+
+#endif // VOXEL_CAMERA_GATHERER_H
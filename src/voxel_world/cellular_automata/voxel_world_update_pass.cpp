@@ -1,14 +1,17 @@
 
 
 #include "voxel_world_update_pass.h"
+#include "utility/bit_logic.h"
 #include <godot_cpp/core/print_string.hpp>  // For print_line()
+#include <algorithm>
 
 using namespace godot;
 
 
-VoxelWorldUpdatePass::VoxelWorldUpdatePass(String shader_path, RenderingDevice * rd, VoxelWorldRIDs& voxel_world_rids, const Vector3i size) : _size(size){
+VoxelWorldUpdatePass::VoxelWorldUpdatePass(String shader_path, RenderingDevice * rd, VoxelWorldRIDs& voxel_world_rids, const VoxelParticleRIDs &particle_rids, const Vector3i size) : _size(size), _rd(rd){
     automata_cs_1 = new ComputeShader(shader_path, rd);
     voxel_world_rids.add_voxel_buffers(automata_cs_1);
+    particle_rids.add_particle_buffers(automata_cs_1, 0); // free falling voxels become particles
     automata_cs_1->finish_create_uniforms();
 
     automata_cs_2 = new ComputeShader("res://addons/voxel_playground/src/shaders/automata/freeze_lava.glsl", rd);
@@ -17,7 +20,31 @@ VoxelWorldUpdatePass::VoxelWorldUpdatePass(String shader_path, RenderingDevice *
 
     cleanup_shader = new ComputeShader("res://addons/voxel_playground/src/shaders/automata/cleanup_pass.glsl", rd);
     voxel_world_rids.add_voxel_buffers(cleanup_shader);
+    _changed_bricks_rid = voxel_world_rids.changed_bricks;
+    _changed_bricks_bytes = ((voxel_world_rids.brick_count + 31) / 32) * sizeof(uint32_t);
+    cleanup_shader->add_existing_buffer(_changed_bricks_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 0, 1);
     cleanup_shader->finish_create_uniforms();
+
+    // temporally blocked liquid kernel, advances several generations per dispatch
+    liquid_blocked_shader = new ComputeShader("res://addons/voxel_playground/src/shaders/automata/liquid_blocked.glsl", rd);
+    voxel_world_rids.add_voxel_buffers(liquid_blocked_shader);
+    _liquid_params.steps = _substeps;
+    _liquid_params_rid = liquid_blocked_shader->create_storage_buffer_uniform(_liquid_params.to_packed_byte_array(), 0, 1);
+    particle_rids.add_particle_buffers(liquid_blocked_shader, 1);
+    liquid_blocked_shader->finish_create_uniforms();
+}
+
+VoxelWorldUpdatePass::~VoxelWorldUpdatePass()
+{
+    delete automata_cs_1;
+    delete automata_cs_2;
+    delete cleanup_shader;
+    delete liquid_blocked_shader;
+}
+
+void VoxelWorldUpdatePass::set_substeps(int substeps)
+{
+    _substeps = std::clamp(substeps, 1, MAX_SUBSTEPS);
 }
 
 void VoxelWorldUpdatePass::update(float delta)
@@ -32,10 +59,20 @@ void VoxelWorldUpdatePass::update(float delta)
         uint64_t start = Time::get_singleton()->get_ticks_usec();
         const Vector3 group_size = Vector3(8, 8, 8);
         const Vector3i group_count = Vector3i(std::ceil(_size.x / group_size.x), std::ceil(_size.y / group_size.y), std::ceil(_size.z / group_size.z));
-        automata_cs_1->compute(group_count, true);  // Enable sync for GPU timing
+        ComputeShader *liquid_shader = automata_cs_1;
+        if (_substeps > 1 && liquid_blocked_shader != nullptr && liquid_blocked_shader->check_ready())
+        {
+            if (_liquid_params.steps != _substeps)
+            {
+                _liquid_params.steps = _substeps;
+                liquid_blocked_shader->update_storage_buffer_uniform(_liquid_params_rid, _liquid_params.to_packed_byte_array());
+            }
+            liquid_shader = liquid_blocked_shader;
+        }
+        liquid_shader->compute(group_count, true);  // Enable sync for GPU timing
         uint64_t end = Time::get_singleton()->get_ticks_usec();
         _time_liquid_us = end - start;
-        _gpu_time_liquid_ms = automata_cs_1->get_last_gpu_time_ms();
+        _gpu_time_liquid_ms = liquid_shader->get_last_gpu_time_ms();
     }
 
     { // Freeze lava pass
@@ -54,6 +91,7 @@ void VoxelWorldUpdatePass::update(float delta)
         const Vector3 group_size = Vector3(4, 2, 4);
         const Vector3 brick_span = thread_span * group_size;
         const Vector3i group_count = Vector3i(std::ceil(_size.x / brick_span.x), std::ceil(_size.y / brick_span.y), std::ceil(_size.z / brick_span.z));
+        _rd->buffer_clear(_changed_bricks_rid, 0, _changed_bricks_bytes);
         cleanup_shader->compute(group_count, true);  // Enable sync for GPU timing
         uint64_t end = Time::get_singleton()->get_ticks_usec();
         _time_cleanup_us = end - start;
@@ -61,3 +99,20 @@ void VoxelWorldUpdatePass::update(float delta)
     }
 
 }
+
+void VoxelWorldUpdatePass::fetch_changed_bricks(const Callable &on_fetched)
+{
+    if (_changed_bricks_rid.is_valid())
+        _rd->buffer_get_data_async(_changed_bricks_rid, on_fetched, 0, _changed_bricks_bytes);
+}
+
+std::vector<uint32_t> VoxelWorldUpdatePass::get_changed_bricks(const PackedByteArray &data)
+{
+    std::vector<uint32_t> bricks;
+    const uint32_t *words = reinterpret_cast<const uint32_t *>(data.ptr());
+    const int64_t word_count = data.size() / int64_t(sizeof(uint32_t));
+    for (int64_t w = 0; w < word_count; ++w)
+        for (uint32_t bits = words[w]; bits != 0; bits &= bits - 1)
+            bricks.push_back(uint32_t(w) * 32 + ctz32(bits));
+    return bricks;
+}
@@ -10,18 +10,44 @@
 
 #include "gdcs/include/gdcs.h"
 #include "voxel_world/voxel_properties.h"
+#include "voxel_world/particles/voxel_particle_system.h"
 
 using namespace godot;
 
 class VoxelWorldUpdatePass
 {
+    struct LiquidBlockedParams
+    {
+        int steps;
+
+        PackedByteArray to_packed_byte_array()
+        {
+            PackedByteArray byte_array;
+            byte_array.resize(sizeof(LiquidBlockedParams));
+            std::memcpy(byte_array.ptrw(), this, sizeof(LiquidBlockedParams));
+            return byte_array;
+        }
+    };
 
   public:
-    VoxelWorldUpdatePass(String shader_path, RenderingDevice *rd, VoxelWorldRIDs& voxel_world_rids, const Vector3i size);
-    ~VoxelWorldUpdatePass() {};
+    // matches MAX_STEPS (and therefore the halo) in liquid_blocked.glsl
+    static constexpr int MAX_SUBSTEPS = 3;
+
+    VoxelWorldUpdatePass(String shader_path, RenderingDevice *rd, VoxelWorldRIDs& voxel_world_rids,
+                         const VoxelParticleRIDs &particle_rids, const Vector3i size);
+    ~VoxelWorldUpdatePass();
 
     void update(float delta);
 
+    // reads back which bricks the last update changed, on_fetched gets the bit mask (see get_changed_bricks)
+    void fetch_changed_bricks(const Callable &on_fetched);
+    static std::vector<uint32_t> get_changed_bricks(const PackedByteArray &data);
+
+    // Number of liquid generations advanced per update. Values above 1 switch to the temporally blocked kernel,
+    // which advances all of them in a single dispatch using shared memory.
+    void set_substeps(int substeps);
+    int get_substeps() const { return _substeps; }
+
     // Performance profiling getters (microseconds for CPU, milliseconds for GPU)
     uint64_t get_time_liquid_us() const { return _time_liquid_us; }
     uint64_t get_time_freeze_us() const { return _time_freeze_us; }
@@ -36,7 +62,17 @@ class VoxelWorldUpdatePass
     ComputeShader *automata_cs_1 = nullptr;
     ComputeShader *automata_cs_2 = nullptr;
     ComputeShader *cleanup_shader = nullptr;
+    ComputeShader *liquid_blocked_shader = nullptr;
     Vector3i _size;
+    RenderingDevice *_rd = nullptr;
+
+    // VoxelWorldRIDs::changed_bricks, cleared before the cleanup pass sets the bits of the automata
+    RID _changed_bricks_rid;
+    uint32_t _changed_bricks_bytes = 0;
+
+    int _substeps = 1;
+    LiquidBlockedParams _liquid_params;
+    RID _liquid_params_rid;
 
     // Performance profiling (CPU: microseconds, GPU: milliseconds)
     uint64_t _time_liquid_us = 0;
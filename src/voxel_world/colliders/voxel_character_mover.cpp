@@ -0,0 +1,179 @@
+#include "voxel_character_mover.h"
+#include <cmath>
+
+#include "voxel_world/voxel_world.h"
+
+static constexpr float EPSILON = 1e-3f; // voxels, faces closer than this are touching
+static constexpr float GROUND_PROBE = 0.05f; // voxels, how far below the box the floor still counts as touched
+
+void VoxelCharacterMover::_bind_methods()
+{
+    ClassDB::bind_method(D_METHOD("move_and_slide", "world", "position", "delta"),
+                         &VoxelCharacterMover::move_and_slide);
+    ClassDB::bind_method(D_METHOD("is_on_floor"), &VoxelCharacterMover::is_on_floor);
+    ClassDB::bind_method(D_METHOD("is_on_wall"), &VoxelCharacterMover::is_on_wall);
+    ClassDB::bind_method(D_METHOD("is_on_ceiling"), &VoxelCharacterMover::is_on_ceiling);
+
+    ClassDB::bind_method(D_METHOD("get_velocity"), &VoxelCharacterMover::get_velocity);
+    ClassDB::bind_method(D_METHOD("set_velocity", "velocity"), &VoxelCharacterMover::set_velocity);
+    ADD_PROPERTY(PropertyInfo(Variant::VECTOR3, "velocity"), "set_velocity", "get_velocity");
+
+    ClassDB::bind_method(D_METHOD("get_half_extents"), &VoxelCharacterMover::get_half_extents);
+    ClassDB::bind_method(D_METHOD("set_half_extents", "half_extents"), &VoxelCharacterMover::set_half_extents);
+    ADD_PROPERTY(PropertyInfo(Variant::VECTOR3, "half_extents"), "set_half_extents", "get_half_extents");
+
+    ClassDB::bind_method(D_METHOD("get_center_offset"), &VoxelCharacterMover::get_center_offset);
+    ClassDB::bind_method(D_METHOD("set_center_offset", "offset"), &VoxelCharacterMover::set_center_offset);
+    ADD_PROPERTY(PropertyInfo(Variant::VECTOR3, "center_offset"), "set_center_offset", "get_center_offset");
+
+    ClassDB::bind_method(D_METHOD("get_step_height"), &VoxelCharacterMover::get_step_height);
+    ClassDB::bind_method(D_METHOD("set_step_height", "height"), &VoxelCharacterMover::set_step_height);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "step_height", PROPERTY_HINT_RANGE, "0,2,0.01,or_greater"),
+                 "set_step_height", "get_step_height");
+
+    ClassDB::bind_method(D_METHOD("get_snap_length"), &VoxelCharacterMover::get_snap_length);
+    ClassDB::bind_method(D_METHOD("set_snap_length", "length"), &VoxelCharacterMover::set_snap_length);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "snap_length", PROPERTY_HINT_RANGE, "0,2,0.01,or_greater"),
+                 "set_snap_length", "get_snap_length");
+}
+
+bool VoxelCharacterMover::is_solid(const VoxelWorldMirror &mirror, const Vector3i &voxel) const
+{
+    // liquids can be walked through, outside the world is air
+    return VoxelWorldMirror::is_solid_type(mirror.get_voxel_type(voxel));
+}
+
+float VoxelCharacterMover::sweep_axis(const VoxelWorldMirror &mirror, Box &box, int axis, float distance) const
+{
+    if (distance == 0.0f)
+        return 0.0f;
+
+    // voxels under the cross section of the box, faces that only touch do not count
+    const int a1 = (axis + 1) % 3, a2 = (axis + 2) % 3;
+    const int min1 = int(std::floor(box.min[a1] + EPSILON)), max1 = int(std::floor(box.max[a1] - EPSILON));
+    const int min2 = int(std::floor(box.min[a2] + EPSILON)), max2 = int(std::floor(box.max[a2] - EPSILON));
+    auto layer_blocked = [&](int layer) {
+        Vector3i voxel;
+        voxel[axis] = layer;
+        for (voxel[a2] = min2; voxel[a2] <= max2; voxel[a2]++)
+            for (voxel[a1] = min1; voxel[a1] <= max1; voxel[a1]++)
+                if (is_solid(mirror, voxel))
+                    return true;
+        return false;
+    };
+
+    // walk the layers the leading face crosses, the ones the box already overlaps are skipped so it can get
+    // out of voxels that were placed inside it
+    float moved = distance;
+    if (distance > 0.0f)
+    {
+        const float lead = box.max[axis];
+        for (int layer = int(std::ceil(lead - EPSILON)); layer < lead + distance; layer++)
+            if (layer_blocked(layer))
+            {
+                moved = std::max(layer - lead, 0.0f);
+                break;
+            }
+    }
+    else
+    {
+        const float lead = box.min[axis];
+        for (int layer = int(std::floor(lead + EPSILON)) - 1; layer + 1 > lead + distance; layer--)
+            if (layer_blocked(layer))
+            {
+                moved = std::min(layer + 1 - lead, 0.0f);
+                break;
+            }
+    }
+    box.min[axis] += moved;
+    box.max[axis] += moved;
+    return moved;
+}
+
+float VoxelCharacterMover::sweep_with_step(const VoxelWorldMirror &mirror, Box &box, int axis, float distance,
+                                           float step) const
+{
+    Box plain = box;
+    const float moved = sweep_axis(mirror, plain, axis, distance);
+    if (step <= 0.0f || std::abs(moved) >= std::abs(distance) - EPSILON)
+    {
+        box = plain;
+        return moved;
+    }
+
+    // up, across, and back down onto whatever is below
+    Box stepped = box;
+    const float up = sweep_axis(mirror, stepped, 1, step);
+    const float stepped_moved = sweep_axis(mirror, stepped, axis, distance);
+    sweep_axis(mirror, stepped, 1, -up);
+    if (std::abs(stepped_moved) > std::abs(moved) + EPSILON)
+    {
+        box = stepped;
+        return stepped_moved;
+    }
+    box = plain;
+    return moved;
+}
+
+Vector3 VoxelCharacterMover::move_and_slide(VoxelWorld *world, const Vector3 &position, float delta)
+{
+    const VoxelWorldMirror *mirror = world != nullptr ? world->get_mirror() : nullptr;
+    if (mirror == nullptr)
+    {
+        // nothing to collide with until the world has a CPU mirror
+        _on_floor = _on_wall = _on_ceiling = false;
+        return position + _velocity * delta;
+    }
+    if (!mirror->is_synced())
+    {
+        // the mirror is still empty during its first readback, wait instead of falling through the world
+        return position;
+    }
+
+    const float scale = mirror->get_properties().scale;
+    const Vector3 center = (position + _center_offset) / scale;
+    const Vector3 half_extents = _half_extents / scale;
+    Box box{center - half_extents, center + half_extents};
+    const Vector3 motion = _velocity * delta / scale;
+    const bool was_on_floor = _on_floor;
+    _on_floor = _on_wall = _on_ceiling = false;
+
+    if (std::abs(sweep_axis(*mirror, box, 1, motion.y)) < std::abs(motion.y) - EPSILON)
+    {
+        (motion.y < 0.0f ? _on_floor : _on_ceiling) = true;
+        _velocity.y = 0.0f;
+    }
+
+    // only grounded characters step up, a jump against a wall should not climb it
+    const float step = was_on_floor || _on_floor ? _step_height / scale : 0.0f;
+    for (int axis : {0, 2})
+        if (std::abs(sweep_with_step(*mirror, box, axis, motion[axis], step)) < std::abs(motion[axis]) - EPSILON)
+        {
+            _on_wall = true;
+            _velocity[axis] = 0.0f;
+        }
+
+    // keep walking characters on the ground down stairs, but not while they jump
+    if (!_on_floor && was_on_floor && _velocity.y <= 0.0f)
+    {
+        Box probe = box;
+        const float snap = _snap_length / scale;
+        if (-sweep_axis(*mirror, probe, 1, -snap) < snap - EPSILON)
+        {
+            box = probe;
+            _on_floor = true;
+            _velocity.y = 0.0f;
+        }
+    }
+
+    // a character resting on the floor does not move down, so the vertical sweep alone never reports it, not even
+    // without a snap length
+    if (!_on_floor && _velocity.y <= 0.0f)
+    {
+        Box probe = box;
+        if (-sweep_axis(*mirror, probe, 1, -GROUND_PROBE) < GROUND_PROBE - EPSILON)
+            _on_floor = true;
+    }
+
+    return (box.min + box.max) * 0.5f * scale - _center_offset;
+}
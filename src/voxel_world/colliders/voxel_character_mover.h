@@ -0,0 +1,77 @@
+#ifndef VOXEL_CHARACTER_MOVER_H
+#define VOXEL_CHARACTER_MOVER_H
+
+#include <algorithm>
+#include <godot_cpp/classes/resource.hpp>
+#include <godot_cpp/core/class_db.hpp>
+
+#include "voxel_world/queries/voxel_world_mirror.h"
+
+using namespace godot;
+
+class VoxelWorld;
+
+// Kinematic character controller that moves a box straight against the voxels of the CPU mirror, so the actor
+// needs no collider mesh. The motion is swept one axis at a time, vertical first, and every sweep walks the voxel
+// layers the leading face crosses, so fast falls cannot tunnel. Voxel slopes are staircases and are climbed by
+// stepping up, grounded characters are snapped down onto the floor below them.
+//
+// The mirror is a copy the GPU reads back asynchronously, edits and the simulation reach it a few frames late
+// (the dirty bricks are fetched first, within mirror_bricks_per_frame per frame). Until then the mover collides
+// with the voxels as they were, a freshly dug hole can still be walked over for those frames.
+class VoxelCharacterMover : public Resource
+{
+    GDCLASS(VoxelCharacterMover, Resource)
+
+  protected:
+    static void _bind_methods();
+
+  public:
+    VoxelCharacterMover() = default;
+    ~VoxelCharacterMover() override = default;
+
+    // Moves a character at position (meters) by velocity * delta and returns the new position. Velocity components
+    // that hit a voxel are zeroed, like CharacterBody3D::move_and_slide.
+    Vector3 move_and_slide(VoxelWorld *world, const Vector3 &position, float delta);
+
+    bool is_on_floor() const { return _on_floor; }
+    bool is_on_wall() const { return _on_wall; }
+    bool is_on_ceiling() const { return _on_ceiling; }
+
+    Vector3 get_velocity() const { return _velocity; }
+    void set_velocity(const Vector3 &velocity) { _velocity = velocity; }
+
+    Vector3 get_half_extents() const { return _half_extents; }
+    void set_half_extents(const Vector3 &half_extents) { _half_extents = half_extents.abs(); }
+    Vector3 get_center_offset() const { return _center_offset; }
+    void set_center_offset(const Vector3 &offset) { _center_offset = offset; }
+    float get_step_height() const { return _step_height; }
+    void set_step_height(float height) { _step_height = std::max(height, 0.0f); }
+    float get_snap_length() const { return _snap_length; }
+    void set_snap_length(float length) { _snap_length = std::max(length, 0.0f); }
+
+  private:
+    struct Box // in voxels
+    {
+        Vector3 min;
+        Vector3 max;
+    };
+
+    bool is_solid(const VoxelWorldMirror &mirror, const Vector3i &voxel) const;
+    // moves the box by distance along axis until its leading face touches a solid voxel, returns the distance moved
+    float sweep_axis(const VoxelWorldMirror &mirror, Box &box, int axis, float distance) const;
+    // horizontal sweep that steps onto ledges up to step_height (voxels) when the plain sweep is blocked
+    float sweep_with_step(const VoxelWorldMirror &mirror, Box &box, int axis, float distance, float step) const;
+
+    Vector3 _velocity;
+    Vector3 _half_extents = Vector3(0.4f, 0.9f, 0.4f); // meters
+    Vector3 _center_offset = Vector3(0.0f, 0.9f, 0.0f); // box center relative to the position
+    float _step_height = 0.3f;                          // meters
+    float _snap_length = 0.3f;                          // meters
+
+    bool _on_floor = false;
+    bool _on_wall = false;
+    bool _on_ceiling = false;
+};
+
+#endif // VOXEL_CHARACTER_MOVER_H
@@ -1,8 +1,41 @@
 #include "voxel_world_collider.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+
+#include <godot_cpp/classes/collision_object3d.hpp>
+#include <godot_cpp/classes/world3d.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/core/object.hpp>
+
+#include "utility/bit_logic.h"
+
+// floor division that behaves for negative coordinates
+static inline int floor_div(int v, int d)
+{
+    return v >= 0 ? v / d : -((-v + d - 1) / d);
+}
+
+static const Vector3i FACE_NEIGHBOURS[6] = {Vector3i(-1, 0, 0), Vector3i(1, 0, 0), Vector3i(0, -1, 0),
+                                            Vector3i(0, 1, 0),  Vector3i(0, 0, -1), Vector3i(0, 0, 1)};
 
 void VoxelWorldCollider::_bind_methods()
 {
     ClassDB::bind_method(D_METHOD("_on_data_fetched", "data"), &VoxelWorldCollider::onDataFetched);
+    ClassDB::bind_method(D_METHOD("get_chunk_count"), &VoxelWorldCollider::getChunkCount);
+    ClassDB::bind_method(D_METHOD("get_chunks_meshed_last_fetch"), &VoxelWorldCollider::getChunksMeshedLastFetch);
+    ClassDB::bind_method(D_METHOD("get_box_count"), &VoxelWorldCollider::getBoxCount);
+    ClassDB::bind_method(D_METHOD("add_agent", "agent"), &VoxelWorldCollider::addAgent);
+    ClassDB::bind_method(D_METHOD("remove_agent", "agent"), &VoxelWorldCollider::removeAgent);
+    ClassDB::bind_method(D_METHOD("get_agent_count"), &VoxelWorldCollider::getAgentCount);
+
+    ClassDB::bind_method(D_METHOD("get_collider_mode"), &VoxelWorldCollider::getColliderMode);
+    ClassDB::bind_method(D_METHOD("set_collider_mode", "mode"), &VoxelWorldCollider::setColliderMode);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "collider_mode", PROPERTY_HINT_ENUM, "Trimesh,Boxes"),
+                 "set_collider_mode", "get_collider_mode");
+    BIND_ENUM_CONSTANT(MODE_TRIMESH);
+    BIND_ENUM_CONSTANT(MODE_BOXES);
 
     ClassDB::bind_method(D_METHOD("get_collider_size"), &VoxelWorldCollider::getColliderSize);
     ClassDB::bind_method(D_METHOD("set_collider_size", "size"), &VoxelWorldCollider::setColliderSize);
@@ -13,11 +46,27 @@ void VoxelWorldCollider::_bind_methods()
     ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "collision_shape", PROPERTY_HINT_NODE_TYPE, "CollisionShape3D"),
                  "set_collision_shape", "get_collision_shape");
 
+    ClassDB::bind_method(D_METHOD("get_max_fetch_chunks"), &VoxelWorldCollider::getMaxFetchChunks);
+    ClassDB::bind_method(D_METHOD("set_max_fetch_chunks", "count"), &VoxelWorldCollider::setMaxFetchChunks);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "max_fetch_chunks", PROPERTY_HINT_RANGE, "1,16384,1,or_greater"),
+                 "set_max_fetch_chunks", "get_max_fetch_chunks");
+}
+
+VoxelWorldCollider::~VoxelWorldCollider()
+{
+    // the workers write into _mesh_jobs
+    if (_mesh_group_id >= 0)
+        WorkerThreadPool::get_singleton()->wait_for_group_task_completion(_mesh_group_id);
 
-    ClassDB::bind_method(D_METHOD("get_update_interval"), &VoxelWorldCollider::getUpdateInterval);
-    ClassDB::bind_method(D_METHOD("set_update_interval", "interval"), &VoxelWorldCollider::setUpdateInterval);
-    ADD_PROPERTY(PropertyInfo(Variant::INT, "update_interval", PROPERTY_HINT_RANGE, "1,60,1"),
-                 "set_update_interval", "get_update_interval");
+    PhysicsServer3D *physics = PhysicsServer3D::get_singleton();
+    if (physics == nullptr)
+        return;
+    for (Chunk &chunk : _chunks)
+        if (chunk.body.is_valid())
+            physics->free_rid(chunk.body);
+    for (const RID &shape : _box_shapes)
+        if (shape.is_valid())
+            physics->free_rid(shape);
 }
 
 void VoxelWorldCollider::init(RenderingDevice *rd, VoxelWorldRIDs& voxel_world_rids, float scale)
@@ -28,41 +77,174 @@ void VoxelWorldCollider::init(RenderingDevice *rd, VoxelWorldRIDs& voxel_world_r
         UtilityFunctions::printerr("Collider shape is null, cannot initialize VoxelWorldCollider");
         return;
     }
+    Node *body = _collision_shape->get_parent();
+    if (body == nullptr)
+    {
+        UtilityFunctions::printerr("Collider shape has no parent body, cannot initialize VoxelWorldCollider");
+        return;
+    }
 
-    // init collision
+    // the scene shape stays empty, every chunk gets its own shape on the same body
     _collision_polygon.instantiate();
     _collision_shape->set_shape(_collision_polygon);
+    _body = body;
 
-    // init shader
-    _collider_params = {
-        Vector4i(0, 0, 0, 1),                                              // min corner
-        Vector4i(_collider_size.x, _collider_size.y, _collider_size.z, 0), // size
-    };
-
-    // Number of voxels
-    const int64_t nvox = int64_t(_collider_size.x) * _collider_size.y * _collider_size.z;
+    if (_mode == MODE_BOXES)
+    {
+        // Boxes skip the scene tree: every chunk is a static body on the physics server that reports the scene
+        // body as its owner, so queries and contacts see the same object as in trimesh mode.
+        _collision_object = Object::cast_to<CollisionObject3D>(body);
+        if (_collision_object == nullptr || !_collision_object->is_inside_tree())
+        {
+            UtilityFunctions::printerr("Collider shape parent is not a collision object in the tree, cannot "
+                                       "initialize VoxelWorldCollider boxes");
+            _collision_object = nullptr;
+            return;
+        }
+        _box_shapes.assign(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE, RID());
+    }
 
-    // Storage as 32-bit words (1 bit per voxel)
-    const int64_t uint_count = (nvox + 31) / 32;            // ceil(nvox / 32)
-    const int64_t byte_size  = uint_count * sizeof(uint32_t);
+    // one chunk more per axis, so a window is covered wherever its corner falls inside a chunk
+    _chunk_counts = Vector3i(floor_div(_collider_size.x + CHUNK_SIZE - 1, CHUNK_SIZE) + 1,
+                             floor_div(_collider_size.y + CHUNK_SIZE - 1, CHUNK_SIZE) + 1,
+                             floor_div(_collider_size.z + CHUNK_SIZE - 1, CHUNK_SIZE) + 1);
+    _chunks.clear();
+    _chunk_slots.clear();
+    _free_slots.clear();
 
-    PackedByteArray collider_voxel_data;
-    collider_voxel_data.resize((int)byte_size);
+    // init shader
+    _collider_params = {};
+    PackedByteArray chunk_list, collider_voxel_data;
+    chunk_list.resize(_max_fetch_chunks * sizeof(Vector4i));
+    collider_voxel_data.resize(size_t(_max_fetch_chunks) * CHUNK_WORDS * sizeof(uint32_t));
     collider_voxel_data.fill(0);
 
     _fetch_data_shader =
         new ComputeShader("res://addons/voxel_playground/src/shaders/voxel_edit/fetch_solid_mask.glsl", rd);
-        voxel_world_rids.add_voxel_buffers(_fetch_data_shader);
+    voxel_world_rids.add_voxel_buffers(_fetch_data_shader);
     _collider_params_rid =
         _fetch_data_shader->create_storage_buffer_uniform(_collider_params.to_packed_byte_array(), 0, 1);
-    _collider_voxel_data_rid = _fetch_data_shader->create_storage_buffer_uniform(collider_voxel_data, 1, 1);
+    _chunk_list_rid = _fetch_data_shader->create_storage_buffer_uniform(chunk_list, 1, 1);
+    _collider_voxel_data_rid = _fetch_data_shader->create_storage_buffer_uniform(collider_voxel_data, 2, 1);
     _fetch_data_shader->finish_create_uniforms();
+    _rd = rd;
 
     _is_updating = false;
-    frames_since_last_update = 0;
 }
 
-void VoxelWorldCollider::addQuad(const Vector3 &p1, const int dir, const bool flip)
+void VoxelWorldCollider::addAgent(Node3D *agent)
+{
+    if (agent == nullptr)
+        return;
+    const ObjectID id(agent->get_instance_id());
+    if (std::find(_agents.begin(), _agents.end(), id) == _agents.end())
+        _agents.push_back(id);
+}
+
+void VoxelWorldCollider::removeAgent(Node3D *agent)
+{
+    if (agent == nullptr)
+        return;
+    _agents.erase(std::remove(_agents.begin(), _agents.end(), ObjectID(agent->get_instance_id())), _agents.end());
+}
+
+uint64_t VoxelWorldCollider::chunkKey(const Vector3i &coord)
+{
+    // 21 bits per axis, two's complement keeps negative coordinates apart
+    return uint64_t(coord.x & 0x1FFFFF) | uint64_t(coord.y & 0x1FFFFF) << 21 | uint64_t(coord.z & 0x1FFFFF) << 42;
+}
+
+int VoxelWorldCollider::findSlot(const Vector3i &coord) const
+{
+    auto it = _chunk_slots.find(chunkKey(coord));
+    return it == _chunk_slots.end() ? -1 : it->second;
+}
+
+int VoxelWorldCollider::acquireSlot(const Vector3i &coord)
+{
+    int slot;
+    if (!_free_slots.empty())
+    {
+        slot = _free_slots.back();
+        _free_slots.pop_back();
+    }
+    else
+    {
+        // the pool grows to the largest set of chunks the windows covered so far
+        slot = int(_chunks.size());
+        _chunks.emplace_back();
+        Chunk &chunk = _chunks.back();
+        if (_mode == MODE_BOXES)
+        {
+            PhysicsServer3D *physics = PhysicsServer3D::get_singleton();
+            chunk.body = physics->body_create();
+            physics->body_set_mode(chunk.body, PhysicsServer3D::BODY_MODE_STATIC);
+            physics->body_set_collision_layer(chunk.body, _collision_object->get_collision_layer());
+            physics->body_set_collision_mask(chunk.body, _collision_object->get_collision_mask());
+            physics->body_attach_object_instance_id(chunk.body, _collision_object->get_instance_id());
+            physics->body_set_state(chunk.body, PhysicsServer3D::BODY_STATE_TRANSFORM,
+                                    _collision_object->get_global_transform());
+            physics->body_set_space(chunk.body, _collision_object->get_world_3d()->get_space());
+        }
+        else
+        {
+            chunk.polygon.instantiate();
+            chunk.shape = memnew(CollisionShape3D);
+            chunk.shape->set_shape(chunk.polygon);
+            _body->call_deferred("add_child", chunk.shape);
+        }
+    }
+
+    Chunk &chunk = _chunks[slot];
+    chunk.coord = coord;
+    chunk.ready = false;
+    chunk.dirty = false;
+    chunk.remesh = false;
+    _chunk_slots[chunkKey(coord)] = slot;
+    return slot;
+}
+
+void VoxelWorldCollider::releaseSlot(int slot)
+{
+    Chunk &chunk = _chunks[slot];
+    // the neighbours emitted no faces towards this chunk, they are meshed again with it as air. Entering chunks
+    // remesh their neighbours once their voxels arrive, see onDataFetched.
+    if (_mode == MODE_TRIMESH && chunk.ready)
+        for (const Vector3i &offset : FACE_NEIGHBOURS)
+            if (Chunk *neighbour = findChunk(chunk.coord + offset))
+                neighbour->remesh = true;
+    chunk.ready = false;
+    chunk.dirty = false;
+    chunk.remesh = false;
+    if (_mode == MODE_BOXES)
+    {
+        chunk.boxes.clear();
+        PhysicsServer3D::get_singleton()->body_clear_shapes(chunk.body);
+    }
+    else
+        chunk.polygon->set_faces(PackedVector3Array());
+    _free_slots.push_back(slot);
+}
+
+VoxelWorldCollider::Chunk *VoxelWorldCollider::findChunk(const Vector3i &coord)
+{
+    const int slot = findSlot(coord);
+    return slot >= 0 && _chunks[slot].ready ? &_chunks[slot] : nullptr;
+}
+
+bool VoxelWorldCollider::isSolid(const Vector3i &voxel)
+{
+    const Vector3i coord(floor_div(voxel.x, CHUNK_SIZE), floor_div(voxel.y, CHUNK_SIZE),
+                         floor_div(voxel.z, CHUNK_SIZE));
+    const Chunk *chunk = findChunk(coord);
+    if (chunk == nullptr)
+        return false; // outside the collider is air
+    const Vector3i local = voxel - coord * CHUNK_SIZE;
+    return (chunk->solid[local.z] >> (local.x + local.y * CHUNK_SIZE)) & 1u;
+}
+
+void VoxelWorldCollider::addQuad(PackedVector3Array &vertices, const Vector3 &p1, const int dir, const bool flip,
+                                 const Vector3 &size)
 {
     const static Vector3 offsets[3][4] = {{// YZ plane
                                            Vector3(0, 0, 0), Vector3(0, 1, 0), Vector3(0, 1, 1), Vector3(0, 0, 1)},
@@ -72,147 +254,437 @@ void VoxelWorldCollider::addQuad(const Vector3 &p1, const int dir, const bool fl
                                            Vector3(0, 0, 0), Vector3(1, 0, 0), Vector3(1, 1, 0), Vector3(0, 1, 0)}};
     // add triangle
     Vector3 v0 = p1;
-    Vector3 v1 = p1 + offsets[dir][1] * scale;
-    Vector3 v2 = p1 + offsets[dir][2] * scale;
-    Vector3 v3 = p1 + offsets[dir][3] * scale;
+    Vector3 v1 = p1 + offsets[dir][1] * size;
+    Vector3 v2 = p1 + offsets[dir][2] * size;
+    Vector3 v3 = p1 + offsets[dir][3] * size;
 
     if (flip)
     {
-        _collider_vertices.push_back(v0);
-        _collider_vertices.push_back(v1);
-        _collider_vertices.push_back(v2);
+        vertices.push_back(v0);
+        vertices.push_back(v1);
+        vertices.push_back(v2);
 
-        _collider_vertices.push_back(v0);
-        _collider_vertices.push_back(v2);
-        _collider_vertices.push_back(v3);
+        vertices.push_back(v0);
+        vertices.push_back(v2);
+        vertices.push_back(v3);
     }
     else
     {
-        _collider_vertices.push_back(v0);
-        _collider_vertices.push_back(v2);
-        _collider_vertices.push_back(v1);
+        vertices.push_back(v0);
+        vertices.push_back(v2);
+        vertices.push_back(v1);
 
-        _collider_vertices.push_back(v0);
-        _collider_vertices.push_back(v3);
-        _collider_vertices.push_back(v2);
+        vertices.push_back(v0);
+        vertices.push_back(v3);
+        vertices.push_back(v2);
     }
 }
 
-void VoxelWorldCollider::onDataFetched(const PackedByteArray &data)
+void VoxelWorldCollider::emitPlane(MeshJob &job, float scale, uint64_t *rows, int row_count, int stride, int axis,
+                                   int slice, int bit_axis, int row_axis, int bit_offset, bool flip)
 {
-    if (data.size() % sizeof(unsigned int) != 0)
+    // greedy merge: take the lowest run of set bits, grow it over the following rows while they contain it
+    for (int r = 0; r < row_count; r++)
     {
-        UtilityFunctions::printerr("Data size is not a multiple of 4 bytes.");
-        return;
+        uint64_t &row = rows[r * stride];
+        while (row != 0)
+        {
+            const int start = ctz64(row);
+            const uint64_t shifted = row >> start;
+            const int width = ~shifted == 0 ? 64 - start : ctz64(~shifted);
+            const uint64_t run = (width == 64 ? ~0ull : (1ull << width) - 1) << start;
+            row &= ~run;
+            int height = 1;
+            while (r + height < row_count && (rows[(r + height) * stride] & run) == run)
+            {
+                rows[(r + height) * stride] &= ~run;
+                height++;
+            }
+
+            Vector3 corner;
+            corner[axis] = slice;
+            corner[bit_axis] = bit_offset + start;
+            corner[row_axis] = r;
+            Vector3 size(1, 1, 1);
+            size[bit_axis] = width;
+            size[row_axis] = height;
+            addQuad(job.vertices, scale * corner + job.offset, axis, flip, scale * size);
+        }
     }
+}
 
-    const size_t num_uints = data.size() / sizeof(unsigned int);
-    _collider_voxel_data.resize(num_uints);
-    memcpy(_collider_voxel_data.data(), data.ptr(), data.size());
+int VoxelWorldCollider::getBoxCount() const
+{
+    int count = 0;
+    for (const Chunk &chunk : _chunks)
+        count += int(chunk.boxes.size());
+    return count;
+}
 
-    _collider_vertices.clear();
-    for (size_t x = 0; x < _collider_size.x; x++)
-    {
-        for (size_t y = 0; y < _collider_size.y; y++)
+void VoxelWorldCollider::decomposeBoxes(const uint64_t *solid, std::vector<ColliderBox> &boxes)
+{
+    static constexpr uint64_t ROW_BITS = 0xFFull;
+    uint64_t remaining[CHUNK_SIZE];
+    std::memcpy(remaining, solid, sizeof(remaining));
+    boxes.clear();
+    for (int z = 0; z < CHUNK_SIZE; z++)
+        while (remaining[z] != 0)
         {
-            for (size_t z = 0; z < _collider_size.z; z++)
+            // the lowest voxel left starts a run along x
+            const int bit = ctz64(remaining[z]);
+            const int x = bit % CHUNK_SIZE, y = bit / CHUNK_SIZE;
+            const uint64_t row = (remaining[z] >> (y * CHUNK_SIZE)) & ROW_BITS;
+            const int width = ctz64(~(row >> x)); // row has 8 bits, so the complement is never 0
+            const uint64_t run = ((1ull << width) - 1) << x;
+
+            // grow it along y while the next row holds the whole run, then the face along z
+            uint64_t face = run << (y * CHUNK_SIZE);
+            int height = 1;
+            while (y + height < CHUNK_SIZE && ((remaining[z] >> ((y + height) * CHUNK_SIZE)) & run) == run)
             {
-                Vector3i ipos(x, y, z);
-                Vector3 pos = scale * Vector3(x, y, z) + collider_offset;
-                bool is_solid = is_voxel_air(ipos);
+                face |= run << ((y + height) * CHUNK_SIZE);
+                height++;
+            }
+            int depth = 1;
+            while (z + depth < CHUNK_SIZE && (remaining[z + depth] & face) == face)
+                depth++;
+            for (int i = 0; i < depth; i++)
+                remaining[z + i] &= ~face;
 
-                // Internal faces (compare against negative neighbor)
-                if (x > 0 && (is_solid ^ is_voxel_air(Vector3i(x - 1, y, z))))
-                {
-                    addQuad(pos, 0, is_solid);
-                }
-                if (y > 0 && (is_solid ^ is_voxel_air(Vector3i(x, y - 1, z))))
-                {
-                    addQuad(pos, 1, is_solid);
-                }
-                if (z > 0 && (is_solid ^ is_voxel_air(Vector3i(x, y, z - 1))))
-                {
-                    addQuad(pos, 2, is_solid);
-                }
+            boxes.push_back({Vector3i(x, y, z), Vector3i(width, height, depth)});
+        }
+}
 
-                // Boundary faces at the min edges (outside is air)
-                if (x == 0 && is_solid)
-                {
-                    addQuad(pos, 0, true);
-                }
-                if (y == 0 && is_solid)
-                {
-                    addQuad(pos, 1, true);
-                }
-                if (z == 0 && is_solid)
-                {
-                    addQuad(pos, 2, true);
-                }
+RID VoxelWorldCollider::getBoxShape(const Vector3i &size)
+{
+    RID &shape = _box_shapes[(size.x - 1) + CHUNK_SIZE * ((size.y - 1) + CHUNK_SIZE * (size.z - 1))];
+    if (!shape.is_valid())
+    {
+        PhysicsServer3D *physics = PhysicsServer3D::get_singleton();
+        shape = physics->box_shape_create();
+        physics->shape_set_data(shape, Vector3(size) * (scale * 0.5f)); // half extents
+    }
+    return shape;
+}
 
-                // Boundary faces at the max edges (outside is air)
-                if (x + 1 == (size_t)_collider_size.x && is_solid)
-                {
-                    addQuad(pos + Vector3(scale, 0, 0), 0, false);
-                }
-                if (y + 1 == (size_t)_collider_size.y && is_solid)
-                {
-                    addQuad(pos + Vector3(0, scale, 0), 1, false);
-                }
-                if (z + 1 == (size_t)_collider_size.z && is_solid)
-                {
-                    addQuad(pos + Vector3(0, 0, scale), 2, false);
-                }
+void VoxelWorldCollider::applyBoxes(Chunk &chunk)
+{
+    PhysicsServer3D *physics = PhysicsServer3D::get_singleton();
+    physics->body_clear_shapes(chunk.body);
+    const Vector3 origin = Vector3(chunk.coord * CHUNK_SIZE) * scale;
+    for (const ColliderBox &box : chunk.boxes)
+    {
+        const Vector3 center = origin + (Vector3(box.min) + Vector3(box.size) * 0.5f) * scale;
+        physics->body_add_shape(chunk.body, getBoxShape(box.size), Transform3D(Basis(), center));
+    }
+}
+
+void VoxelWorldCollider::prepareMeshJob(int slot, MeshJob &job)
+{
+    // Solid rows along x padded with the neighbouring voxels: bit 0 is x = -1, bits 1-8 the chunk, bit 9 x = 8.
+    // rows[z + 1][y + 1], neighbours that are not loaded count as air. Built on the main thread, so the worker
+    // never reads the chunks.
+    const Chunk &chunk = _chunks[slot];
+    const Vector3i origin = chunk.coord * CHUNK_SIZE;
+    job.slot = slot;
+    job.coord = chunk.coord;
+    job.offset = Vector3(origin) * scale;
+    job.vertices.clear();
+    if (_mode == MODE_BOXES)
+    {
+        // boxes only depend on the chunk's own voxels
+        std::memcpy(job.solid, chunk.solid, sizeof(job.solid));
+        return;
+    }
+    uint64_t(&rows)[CHUNK_SIZE + 2][CHUNK_SIZE + 2] = job.rows;
+    for (int z = -1; z <= CHUNK_SIZE; z++)
+        for (int y = -1; y <= CHUNK_SIZE; y++)
+        {
+            const bool inside_yz = y >= 0 && y < CHUNK_SIZE && z >= 0 && z < CHUNK_SIZE;
+            uint64_t row = inside_yz ? ((chunk.solid[z] >> (y * CHUNK_SIZE)) & 0xFFull) << 1 : 0;
+            if (inside_yz)
+            {
+                row |= uint64_t(isSolid(origin + Vector3i(-1, y, z)));
+                row |= uint64_t(isSolid(origin + Vector3i(CHUNK_SIZE, y, z))) << (CHUNK_SIZE + 1);
             }
+            else if ((y >= 0 && y < CHUNK_SIZE) || (z >= 0 && z < CHUNK_SIZE))
+            {
+                // face neighbours only, edges and corners are never compared
+                for (int x = 0; x < CHUNK_SIZE; x++)
+                    row |= uint64_t(isSolid(origin + Vector3i(x, y, z))) << (x + 1);
+            }
+            rows[z + 1][y + 1] = row;
         }
+}
+
+void VoxelWorldCollider::meshJob(void *userdata, uint32_t index)
+{
+    VoxelWorldCollider *collider = static_cast<VoxelWorldCollider *>(userdata);
+    MeshJob &job = collider->_mesh_jobs[index];
+    if (collider->_mode == MODE_BOXES)
+    {
+        decomposeBoxes(job.solid, job.boxes);
+        return;
+    }
+    const float scale = collider->scale;
+    static constexpr uint64_t OWN_BITS = 0x1FEull;
+    const uint64_t(&rows)[CHUNK_SIZE + 2][CHUNK_SIZE + 2] = job.rows;
+    // Only faces of this chunk's solid voxels are emitted, the neighbour emits the other side of a shared plane.
+
+    // x planes: compare each row with itself shifted by one voxel, scatter the face bits into yz planes
+    uint64_t x_front[CHUNK_SIZE + 1][CHUNK_SIZE] = {};
+    uint64_t x_back[CHUNK_SIZE + 1][CHUNK_SIZE] = {};
+    for (int z = 0; z < CHUNK_SIZE; z++)
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            const uint64_t row = rows[z + 1][y + 1];
+            uint64_t front = row & ~(row << 1) & OWN_BITS;   // bit b: voxel b - 1 solid, b - 2 air
+            uint64_t back = (row << 1) & ~row & (OWN_BITS << 1); // bit b: voxel b - 2 solid, b - 1 air
+            while (front != 0)
+            {
+                x_front[ctz64(front) - 1][z] |= 1ull << y;
+                front &= front - 1;
+            }
+            while (back != 0)
+            {
+                x_back[ctz64(back) - 1][z] |= 1ull << y;
+                back &= back - 1;
+            }
+        }
+    for (int x = 0; x <= CHUNK_SIZE; x++)
+    {
+        emitPlane(job, scale, x_front[x], CHUNK_SIZE, 1, 0, x, 1, 2, 0, true);
+        emitPlane(job, scale, x_back[x], CHUNK_SIZE, 1, 0, x, 1, 2, 0, false);
     }
 
-    _collision_polygon->set_faces(_collider_vertices);
+    // y and z planes: compare each row with the row one voxel below / behind it
+    uint64_t front[CHUNK_SIZE], back[CHUNK_SIZE];
+    for (int slice = 0; slice <= CHUNK_SIZE; slice++)
+    {
+        for (int z = 0; z < CHUNK_SIZE; z++)
+        {
+            const uint64_t current = rows[z + 1][slice + 1], previous = rows[z + 1][slice];
+            front[z] = slice < CHUNK_SIZE ? current & ~previous & OWN_BITS : 0;
+            back[z] = slice > 0 ? previous & ~current & OWN_BITS : 0;
+        }
+        emitPlane(job, scale, front, CHUNK_SIZE, 1, 1, slice, 0, 2, -1, true);
+        emitPlane(job, scale, back, CHUNK_SIZE, 1, 1, slice, 0, 2, -1, false);
 
-    _is_updating = false;
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            const uint64_t current = rows[slice + 1][y + 1], previous = rows[slice][y + 1];
+            front[y] = slice < CHUNK_SIZE ? current & ~previous & OWN_BITS : 0;
+            back[y] = slice > 0 ? previous & ~current & OWN_BITS : 0;
+        }
+        emitPlane(job, scale, front, CHUNK_SIZE, 1, 2, slice, 0, 1, -1, true);
+        emitPlane(job, scale, back, CHUNK_SIZE, 1, 2, slice, 0, 1, -1, false);
+    }
 }
 
-void VoxelWorldCollider::update(Vector3i position)
+void VoxelWorldCollider::onDataFetched(const PackedByteArray &data)
 {
-    if (_fetch_data_shader == nullptr || !_fetch_data_shader->check_ready())
+    _is_updating = false;
+    if (data.size() % sizeof(unsigned int) != 0)
     {
-        UtilityFunctions::printerr("Collider fetch voxel data shader is null or not ready");
+        UtilityFunctions::printerr("Data size is not a multiple of 4 bytes.");
         return;
     }
 
-    frames_since_last_update--;
-    if (_is_updating || frames_since_last_update > 0)
+    const uint32_t *words = reinterpret_cast<const uint32_t *>(data.ptr());
+    const size_t fetched = std::min<size_t>(_fetch_coords.size(), data.size() / (CHUNK_WORDS * sizeof(uint32_t)));
+    std::vector<int> remesh;
+    for (size_t i = 0; i < fetched; i++)
+    {
+        const Vector3i &coord = _fetch_coords[i];
+        const int slot = findSlot(coord);
+        if (slot < 0)
+            continue;
+        Chunk &chunk = _chunks[slot];
+
+        uint64_t solid[CHUNK_SIZE];
+        for (int z = 0; z < CHUNK_SIZE; z++)
+            solid[z] = words[i * CHUNK_WORDS + 2 * z] | uint64_t(words[i * CHUNK_WORDS + 2 * z + 1]) << 32;
+        if (chunk.ready && std::memcmp(solid, chunk.solid, sizeof(solid)) == 0)
+            continue;
+        std::memcpy(chunk.solid, solid, sizeof(solid));
+        chunk.ready = true;
+
+        // the neighbours own the faces towards this chunk, boxes ignore the neighbours
+        remesh.push_back(slot);
+        if (_mode == MODE_BOXES)
+            continue;
+        for (const Vector3i &offset : FACE_NEIGHBOURS)
+            if (findChunk(coord + offset) != nullptr)
+                remesh.push_back(findSlot(coord + offset));
+    }
+    _chunks_meshed_last_fetch = 0;
+    startMeshing(remesh);
+}
+
+void VoxelWorldCollider::startMeshing(std::vector<int> &remesh)
+{
+    // chunks whose neighbours left the windows go along
+    for (const auto &entry : _chunk_slots)
+        if (_chunks[entry.second].remesh && _chunks[entry.second].ready)
+            remesh.push_back(entry.second);
+    if (remesh.empty())
         return;
+    std::sort(remesh.begin(), remesh.end());
+    remesh.erase(std::unique(remesh.begin(), remesh.end()), remesh.end());
+    _chunks_meshed_last_fetch = int(remesh.size());
+    for (int slot : remesh)
+        _chunks[slot].remesh = false;
+
+    // mesh into the back buffer on the worker threads, update() swaps the result in once it is done
+    _mesh_jobs.resize(remesh.size());
+    for (size_t i = 0; i < remesh.size(); i++)
+        prepareMeshJob(remesh[i], _mesh_jobs[i]);
+    _mesh_group_id = WorkerThreadPool::get_singleton()->add_native_group_task(
+        &VoxelWorldCollider::meshJob, this, int(_mesh_jobs.size()), -1, false, "VoxelWorldCollider meshing");
     _is_updating = true;
-    frames_since_last_update = _update_interval;
+}
 
-    position -= (_collider_size / 2); // set it to the min corner
-    collider_offset = Vector3(position.x, position.y, position.z) * scale;
-    _collider_params.bounds_min = Vector4i(position.x, position.y, position.z, 0);
+bool VoxelWorldCollider::finishMeshing()
+{
+    if (_mesh_group_id < 0)
+        return true;
+    WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+    if (!pool->is_group_task_completed(_mesh_group_id))
+        return false;
+    pool->wait_for_group_task_completion(_mesh_group_id);
+    _mesh_group_id = -1;
+
+    for (MeshJob &job : _mesh_jobs)
+    {
+        Chunk &chunk = _chunks[job.slot];
+        if (!chunk.ready || chunk.coord != job.coord)
+            continue;
+        if (_mode == MODE_BOXES)
+        {
+            chunk.boxes.swap(job.boxes);
+            applyBoxes(chunk);
+        }
+        else
+            chunk.polygon->set_faces(job.vertices);
+    }
+    _is_updating = false;
+    return true;
+}
 
-    _fetch_data_shader->update_storage_buffer_uniform(_collider_params_rid, _collider_params.to_packed_byte_array());
+void VoxelWorldCollider::markBricksDirty(const std::vector<uint32_t> &bricks, const Vector3i &brick_grid_size)
+{
+    if (_chunk_slots.empty())
+        return;
+    // chunks are brick aligned
+    for (uint32_t brick : bricks)
+    {
+        const Vector3i coord(brick % brick_grid_size.x, (brick / brick_grid_size.x) % brick_grid_size.y,
+                             brick / (brick_grid_size.x * brick_grid_size.y));
+        const int slot = findSlot(coord);
+        if (slot >= 0)
+            _chunks[slot].dirty = true;
+    }
+}
 
-    static constexpr int GX = 8, GY = 8, GZ = 8;
+void VoxelWorldCollider::update()
+{
+    if (_fetch_data_shader == nullptr || !_fetch_data_shader->check_ready())
+    {
+        UtilityFunctions::printerr("Collider fetch voxel data shader is null or not ready");
+        return;
+    }
+    // single flight: a fetch or its meshing is still running
+    if (!finishMeshing())
+        return;
+    if (_is_updating)
+        return;
 
-    auto ceil_div = [](int a, int b) { return (a + b - 1) / b; };
+    // merge the windows of all agents, in agent order so the first agents are fetched first
+    std::vector<Vector3i> window_coords;
+    std::unordered_set<uint64_t> in_window;
+    for (size_t a = 0; a < _agents.size();)
+    {
+        Node3D *agent = Object::cast_to<Node3D>(ObjectDB::get_instance(uint64_t(_agents[a])));
+        if (agent == nullptr)
+        {
+            _agents.erase(_agents.begin() + a);
+            continue;
+        }
+        a++;
+
+        const Vector3 position = agent->get_global_position() / scale;
+        const Vector3i voxel(floor_div(int(std::floor(position.x)), SNAP_VOXELS) * SNAP_VOXELS,
+                             floor_div(int(std::floor(position.y)), SNAP_VOXELS) * SNAP_VOXELS,
+                             floor_div(int(std::floor(position.z)), SNAP_VOXELS) * SNAP_VOXELS);
+        const Vector3i corner = voxel - _collider_size / 2; // the min corner
+        const Vector3i window_min(floor_div(corner.x, CHUNK_SIZE), floor_div(corner.y, CHUNK_SIZE),
+                                  floor_div(corner.z, CHUNK_SIZE));
+        for (int z = 0; z < _chunk_counts.z; z++)
+            for (int y = 0; y < _chunk_counts.y; y++)
+                for (int x = 0; x < _chunk_counts.x; x++)
+                {
+                    const Vector3i coord = window_min + Vector3i(x, y, z);
+                    if (in_window.insert(chunkKey(coord)).second)
+                        window_coords.push_back(coord);
+                }
+    }
 
-    const Vector3i group_count(
-        std::max(1, ceil_div(_collider_size.x, GX)),
-        std::max(1, ceil_div(_collider_size.y, GY)),
-        std::max(1, ceil_div(_collider_size.z, GZ))
-    );
+    // chunks that left every window go back to the pool, the ones that entered take their slots
+    for (auto it = _chunk_slots.begin(); it != _chunk_slots.end();)
+    {
+        if (in_window.count(it->first) == 0)
+        {
+            releaseSlot(it->second);
+            it = _chunk_slots.erase(it);
+        }
+        else
+            ++it;
+    }
+    for (const Vector3i &coord : window_coords)
+        if (findSlot(coord) < 0)
+            acquireSlot(coord);
+
+    // Only chunks that entered a window or whose bricks were reported dirty are fetched, the simulation reports
+    // the bricks it changes like the edits do. New chunks first, then the dirty ones, as many as the fetch buffer
+    // holds. The rest waits for the next update. dirty is cleared here, so bricks marked while the fetch is in
+    // flight fetch the chunk again.
+    _fetch_coords.clear();
+    for (int pass = 0; pass < 2; pass++)
+        for (const Vector3i &coord : window_coords)
+        {
+            if (int(_fetch_coords.size()) >= _max_fetch_chunks)
+                break;
+            Chunk &chunk = _chunks[findSlot(coord)];
+            if (pass == 0 ? !chunk.ready : chunk.ready && chunk.dirty)
+            {
+                chunk.dirty = false;
+                _fetch_coords.push_back(coord);
+            }
+        }
+    if (_fetch_coords.empty())
+    {
+        std::vector<int> remesh;
+        startMeshing(remesh);
+        return;
+    }
+    _is_updating = true;
 
-    _fetch_data_shader->compute(group_count, false);
+    PackedByteArray chunk_list;
+    chunk_list.resize(_fetch_coords.size() * sizeof(Vector4i));
+    Vector4i *corners = reinterpret_cast<Vector4i *>(chunk_list.ptrw());
+    for (size_t i = 0; i < _fetch_coords.size(); i++)
+    {
+        const Vector3i corner = _fetch_coords[i] * CHUNK_SIZE;
+        corners[i] = Vector4i(corner.x, corner.y, corner.z, 0);
+    }
+    _rd->buffer_update(_chunk_list_rid, 0, chunk_list.size(), chunk_list);
+    _collider_params.chunk_count = _fetch_coords.size();
+    _fetch_data_shader->update_storage_buffer_uniform(_collider_params_rid, _collider_params.to_packed_byte_array());
 
-    _fetch_data_shader->get_storage_buffer_uniform_async(_collider_voxel_data_rid, Callable(this, "_on_data_fetched"));
-}
+    // one workgroup per chunk
+    _fetch_data_shader->compute(Vector3i(_fetch_coords.size(), 1, 1), false);
 
-bool VoxelWorldCollider::is_voxel_air(Vector3i pos)
-{
-    unsigned int index = pos.x + pos.y * _collider_params.bounds_size.x +
-                         pos.z * _collider_params.bounds_size.x * _collider_params.bounds_size.y;
-    unsigned int bit_index = index % 32;
-    unsigned int data_index = index / 32;
-    
-    if (data_index < 0 || data_index >= _collider_voxel_data.size()) return true;
-    return ((_collider_voxel_data[data_index] & (1u << bit_index)) != 0);
+    // read back the masks of this fetch only, not the whole buffer
+    _rd->buffer_get_data_async(_collider_voxel_data_rid, Callable(this, "_on_data_fetched"), 0,
+                               _fetch_coords.size() * CHUNK_WORDS * sizeof(uint32_t));
 }
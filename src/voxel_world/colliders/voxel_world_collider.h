@@ -5,22 +5,42 @@
 #include <godot_cpp/classes/rendering_device.hpp>
 #include <godot_cpp/classes/collision_shape3d.hpp>
 #include <godot_cpp/classes/concave_polygon_shape3d.hpp>
+#include <godot_cpp/classes/collision_object3d.hpp>
+#include <godot_cpp/classes/physics_server3d.hpp>
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/object_id.hpp>
 #include <godot_cpp/variant/rid.hpp>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 #include "gdcs/include/gdcs.h"
 #include "voxel_world/voxel_properties.h"
 
 using namespace godot;
 
+// Collision for the voxels around any number of agents. Every agent has a window of collider_size voxels around
+// it, the windows are merged into one set of brick aligned chunks, so agents standing near each other share the
+// chunks and their meshing. The masks of all chunks that need it are fetched with one dispatch and one readback.
 class VoxelWorldCollider : public Node3D
 {
     GDCLASS(VoxelWorldCollider, Node3D);
 
-    struct VoxelColliderParams
+  public:
+    enum ColliderMode
+    {
+        MODE_TRIMESH = 0, // merged voxel faces in a ConcavePolygonShape3D per chunk
+        MODE_BOXES = 1,   // maximal boxes per chunk, added as BoxShape3Ds to a physics server body
+    };
+
+  private:
+
+    struct VoxelColliderParams // match the struct on the gpu
     {
-        Vector4i bounds_min;
-        Vector4i bounds_size;
+        unsigned int chunk_count;
+        unsigned int _pad0;
+        unsigned int _pad1;
+        unsigned int _pad2;
 
         PackedByteArray to_packed_byte_array()
         {
@@ -29,14 +49,43 @@ class VoxelWorldCollider : public Node3D
             std::memcpy(byte_array.ptrw(), this, sizeof(VoxelColliderParams));
             return byte_array;
         }
+    };
 
-          bool is_valid_pos(Vector3i grid_pos) const {
-            return grid_pos.x >= 0 && grid_pos.x < bounds_size.x &&
-                grid_pos.y >= 0 && grid_pos.y < bounds_size.y &&
-                grid_pos.z >= 0 && grid_pos.z < bounds_size.z;
-        }
+    static constexpr int CHUNK_SIZE = 8;   // voxels per axis, chunks line up with the bricks
+    static constexpr int CHUNK_WORDS = 16; // uints per chunk in the fetched solid masks
+    static constexpr int SNAP_VOXELS = 4;  // agent positions are snapped, so small moves do not shift the window
 
+    struct ColliderBox
+    {
+        Vector3i min;  // in voxels, relative to the chunk origin
+        Vector3i size; // in voxels
+    };
 
+    // A cube of the merged windows with its own collision shape. Chunks that leave every window go back to a pool
+    // of slots, so their shapes and bodies are reused by the chunks entering.
+    struct Chunk
+    {
+        Vector3i coord; // in chunks
+        bool ready = false;
+        bool dirty = false;
+        bool remesh = false; // trimesh mode, a neighbour left the windows
+        uint64_t solid[CHUNK_SIZE] = {}; // word z, bit x + y * 8
+        CollisionShape3D *shape = nullptr; // trimesh mode
+        Ref<ConcavePolygonShape3D> polygon;
+        RID body;                        // boxes mode, a static body on the physics server
+        std::vector<ColliderBox> boxes; // boxes mode, decomposition of solid, kept until the bits change
+    };
+
+    // meshing input and output of one chunk, the back buffer the worker threads write into
+    struct MeshJob
+    {
+        int slot = 0;
+        Vector3i coord;
+        Vector3 offset; // chunk origin in meters
+        uint64_t rows[CHUNK_SIZE + 2][CHUNK_SIZE + 2]; // trimesh mode
+        PackedVector3Array vertices;
+        uint64_t solid[CHUNK_SIZE]; // boxes mode
+        std::vector<ColliderBox> boxes;
     };
 
   protected:
@@ -44,44 +93,98 @@ class VoxelWorldCollider : public Node3D
 
   public:
     void init(RenderingDevice *rd, VoxelWorldRIDs& voxel_world_rids, float scale);
-    void addQuad(const Vector3 &p1, const int dir, const bool flip);
+    // size is the extent of the quad in meters along the two axes of its plane
+    static void addQuad(PackedVector3Array &vertices, const Vector3 &p1, const int dir, const bool flip,
+                        const Vector3 &size);
     void onDataFetched(const PackedByteArray &data);
+    // chunks of edited or simulated bricks are fetched again on the next update
+    void markBricksDirty(const std::vector<uint32_t> &bricks, const Vector3i &brick_grid_size);
     VoxelWorldCollider() {};
-    ~VoxelWorldCollider() {};
+    ~VoxelWorldCollider();
+
+    // agents are tracked by instance id, freed nodes are dropped on the next update
+    void addAgent(Node3D *agent);
+    void removeAgent(Node3D *agent);
+    int getAgentCount() const { return int(_agents.size()); }
 
-    void update(Vector3i position);
+    void update();
 
     Vector3i getColliderSize() const { return _collider_size;}
     void setColliderSize(const Vector3i &size) { _collider_size = size; }
 
-    int getUpdateInterval() const { return _update_interval;}
-    void setUpdateInterval(const int interval) { _update_interval = interval; }
+    // read on init, changing it afterwards has no effect
+    ColliderMode getColliderMode() const { return _mode; }
+    void setColliderMode(const ColliderMode mode) { _mode = mode; }
+
+    // read on init, the size of the fetch buffers. More chunks are fetched over several updates.
+    int getMaxFetchChunks() const { return _max_fetch_chunks; }
+    void setMaxFetchChunks(const int count) { _max_fetch_chunks = std::max(count, 1); }
+
+    int getChunkCount() const { return int(_chunk_slots.size()); }
+    int getChunksMeshedLastFetch() const { return _chunks_meshed_last_fetch; }
+    int getBoxCount() const;
 
     CollisionShape3D *getCollisionShape() const { return _collision_shape; }
     void setCollisionShape(CollisionShape3D *shape) { _collision_shape = shape; }
 
   private:
-    bool is_voxel_air(Vector3i pos);
+    // turns the set bits of a plane of row masks into merged quads. Bits run along bit_axis, rows (stride words
+    // apart) along row_axis, the plane sits at slice on axis.
+    static void emitPlane(MeshJob &job, float scale, uint64_t *rows, int row_count, int stride, int axis, int slice,
+                          int bit_axis, int row_axis, int bit_offset, bool flip);
+
+    static uint64_t chunkKey(const Vector3i &coord);
+    int findSlot(const Vector3i &coord) const; // -1 if the chunk is in no window
+    int acquireSlot(const Vector3i &coord);
+    void releaseSlot(int slot);
+    Chunk *findChunk(const Vector3i &coord); // nullptr unless the chunk is loaded
+    bool isSolid(const Vector3i &voxel);
+    void prepareMeshJob(int slot, MeshJob &job);
+    // greedy decomposition of a chunk's solid voxels into disjoint maximal boxes: x runs, grown along y, then z
+    static void decomposeBoxes(const uint64_t *solid, std::vector<ColliderBox> &boxes);
+    // replaces the shapes of the chunk body with its boxes
+    void applyBoxes(Chunk &chunk);
+    RID getBoxShape(const Vector3i &size); // shared between all chunks, one per box size
+    // WorkerThreadPool group task, meshes _mesh_jobs[index]
+    static void meshJob(void *userdata, uint32_t index);
+    // meshes the given slots and the chunks flagged remesh on the worker threads
+    void startMeshing(std::vector<int> &remesh);
+    // swaps finished meshes into the shapes, false while the workers are still busy
+    bool finishMeshing();
 
-    int frames_since_last_update = 0;
-    int _update_interval = 15;
     bool _is_updating = false;
 
     Vector3i _collider_size;
 
-    Vector3 collider_offset = Vector3(0, 0, 0);
     float scale = 0.125f;
+    ColliderMode _mode = MODE_TRIMESH;
+    int _max_fetch_chunks = 1024;
 
     CollisionShape3D *_collision_shape = nullptr;
+    Node *_body = nullptr;                           // parent of the chunk shapes in trimesh mode
+    CollisionObject3D *_collision_object = nullptr; // owner of the chunk bodies in boxes mode
     Ref<ConcavePolygonShape3D> _collision_polygon = nullptr;
     ComputeShader *_fetch_data_shader = nullptr;
 
+    Vector3i _chunk_counts; // per agent window
+    std::vector<ObjectID> _agents;
+    std::vector<Chunk> _chunks;
+    std::unordered_map<uint64_t, int> _chunk_slots; // chunk key -> slot, the chunks of all windows
+    std::vector<int> _free_slots;
+    std::vector<Vector3i> _fetch_coords; // chunks of the fetch in flight
+    int _chunks_meshed_last_fetch = 0;
+
+    RenderingDevice *_rd = nullptr;
     VoxelColliderParams _collider_params;
-    std::vector<unsigned int> _collider_voxel_data;
-    PackedVector3Array _collider_vertices;
+    std::vector<MeshJob> _mesh_jobs;
+    int64_t _mesh_group_id = -1;
+    std::vector<RID> _box_shapes; // indexed by size - 1, x fastest
 
     RID _collider_params_rid;
+    RID _chunk_list_rid;
     RID _collider_voxel_data_rid;
 };
 
+VARIANT_ENUM_CAST(VoxelWorldCollider::ColliderMode);
+
 #endif // VOXEL_WORLD_COLLIDER_H
@@ -1,7 +1,24 @@
 #include "voxel_entity.h"
+#include "voxel_rendering/voxel_camera.h"
+#include <godot_cpp/classes/engine.hpp>
+#include <godot_cpp/classes/scene_tree.hpp>
+#include <godot_cpp/core/object.hpp>
 
 void VoxelEntity::_bind_methods()
 {
+    ClassDB::bind_method(D_METHOD("set_voxel_camera", "camera"), &VoxelEntity::set_voxel_camera);
+    ClassDB::bind_method(D_METHOD("get_voxel_camera"), &VoxelEntity::get_voxel_camera);
+    ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "voxel_camera", PROPERTY_HINT_NODE_TYPE, "VoxelCamera"),
+                 "set_voxel_camera", "get_voxel_camera");
+
+    ClassDB::bind_method(D_METHOD("set_voxel_data", "data"), &VoxelEntity::set_voxel_data);
+    ClassDB::bind_method(D_METHOD("get_voxel_data"), &VoxelEntity::get_voxel_data);
+    ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "voxel_data", PROPERTY_HINT_RESOURCE_TYPE, "VoxelData"), "set_voxel_data", "get_voxel_data");
+
+    ClassDB::bind_method(D_METHOD("set_voxel_scale", "scale"), &VoxelEntity::set_voxel_scale);
+    ClassDB::bind_method(D_METHOD("get_voxel_scale"), &VoxelEntity::get_voxel_scale);
+    ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "voxel_scale", PROPERTY_HINT_RANGE, "0.01,1,0.01"), "set_voxel_scale", "get_voxel_scale");
+
     ClassDB::bind_method(D_METHOD("set_brick_map_size", "size"), &VoxelEntity::set_brick_map_size);
     ClassDB::bind_method(D_METHOD("get_brick_map_size"), &VoxelEntity::get_brick_map_size);
     ADD_PROPERTY(PropertyInfo(Variant::VECTOR3I, "brick_map_size"), "set_brick_map_size", "get_brick_map_size");
@@ -17,16 +34,115 @@ void VoxelEntity::_bind_methods()
     ClassDB::bind_method(D_METHOD("set_health", "value"), &VoxelEntity::set_health);
     ClassDB::bind_method(D_METHOD("get_health"), &VoxelEntity::get_health);
     ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "health"), "set_health", "get_health");
+
+    ClassDB::bind_method(D_METHOD("get_entity_id"), &VoxelEntity::get_entity_id);
 }
 
 void VoxelEntity::_notification(int what)
 {
+    if (godot::Engine::get_singleton()->is_editor_hint())
+    {
+        return;
+    }
     switch (what) {
-        case NOTIFICATION_READY: {
+        case NOTIFICATION_ENTER_TREE: {
+            // paired with EXIT_TREE, so an entity moved to another parent registers again
             add_to_group("voxel_entities");
+            register_with_camera();
+            break;
+        }
+        case NOTIFICATION_READY: {
+            // the camera may enter the tree after the entity
+            if (entity_id < 0)
+                register_with_camera();
+            break;
+        }
+        case NOTIFICATION_TRANSFORM_CHANGED: {
+            VoxelCamera *camera = get_voxel_camera();
+            if (camera != nullptr && entity_id >= 0)
+                camera->update_entity(entity_id, get_global_transform());
+            break;
+        }
+        case NOTIFICATION_EXIT_TREE: {
+            unregister_from_camera();
             break;
         }
         default: break;
     }
 }
 
+void VoxelEntity::set_voxel_camera(VoxelCamera *camera)
+{
+    voxel_camera_id = camera != nullptr ? ObjectID(camera->get_instance_id()) : ObjectID();
+}
+
+VoxelCamera *VoxelEntity::get_voxel_camera() const
+{
+    if (voxel_camera_id.is_null())
+        return nullptr;
+    return Object::cast_to<VoxelCamera>(ObjectDB::get_instance(uint64_t(voxel_camera_id)));
+}
+
+void VoxelEntity::register_with_camera()
+{
+    VoxelCamera *camera = get_voxel_camera();
+    if (camera == nullptr)
+    {
+        camera = Object::cast_to<VoxelCamera>(get_tree()->get_first_node_in_group("voxel_camera"));
+        set_voxel_camera(camera);
+    }
+    if (camera == nullptr)
+    {
+        // ready reports it, the camera may still enter the tree until then
+        if (is_node_ready())
+            UtilityFunctions::printerr("VoxelEntity: no VoxelCamera found, the entity is not rendered.");
+        return;
+    }
+    entity_id = camera->register_voxel_entity(this);
+    set_notify_transform(true);
+}
+
+void VoxelEntity::unregister_from_camera()
+{
+    set_notify_transform(false);
+    VoxelCamera *camera = get_voxel_camera();
+    if (camera != nullptr && entity_id >= 0)
+        camera->remove_entity(entity_id);
+    entity_id = -1;
+}
+
+String VoxelEntity::get_model_key() const
+{
+    if (voxel_data.is_valid())
+    {
+        const String path = voxel_data->get_path();
+        return "data:" + (path.is_empty() ? String::num_uint64(voxel_data->get_instance_id()) : path);
+    }
+    return "sphere:" + String::num_int64(brick_map_size.x) + "," + String::num_int64(brick_map_size.y) + "," +
+           String::num_int64(brick_map_size.z) + ":" + String::num_int64(radius_voxels) + ":" + color.to_html();
+}
+
+void VoxelEntity::load_model()
+{
+    if (voxel_data.is_valid() && voxel_data->get_count() == 0)
+        voxel_data->load();
+}
+
+Vector3i VoxelEntity::get_model_size() const
+{
+    if (voxel_data.is_valid())
+        return voxel_data->get_size();
+    return brick_map_size * VoxelWorldProperties::BRICK_SIZE;
+}
+
+Voxel VoxelEntity::get_model_voxel(const Vector3i &pos) const
+{
+    if (voxel_data.is_valid())
+        return voxel_data->get_voxel_at(pos);
+    // sphere around the center of the brick map
+    const Vector3 center = Vector3(brick_map_size * VoxelWorldProperties::BRICK_SIZE) * 0.5f;
+    const Vector3 offset = Vector3(pos) + Vector3(0.5f, 0.5f, 0.5f) - center;
+    if (offset.length_squared() > float(radius_voxels * radius_voxels))
+        return Voxel::create_air_voxel();
+    return Voxel::create_solid_voxel(color);
+}
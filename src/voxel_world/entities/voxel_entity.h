@@ -3,11 +3,19 @@
 
 #include <godot_cpp/classes/node3d.hpp>
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/object_id.hpp>
 #include <godot_cpp/variant/vector3i.hpp>
 #include <godot_cpp/variant/color.hpp>
 
+#include "voxel_world/data/voxel_data.h"
+
 using namespace godot;
 
+class VoxelCamera;
+
+// A voxel model rendered by the VoxelCamera, registered while the node is in the tree. The voxels come from
+// voxel_data, or without it from a sphere of radius_voxels in color inside brick_map_size bricks. Entities with the
+// same content share one model in the entity brick pool of the camera.
 class VoxelEntity : public Node3D {
     GDCLASS(VoxelEntity, Node3D);
 
@@ -19,6 +27,16 @@ class VoxelEntity : public Node3D {
     VoxelEntity() = default;
     ~VoxelEntity() = default;
 
+    // the camera is held by instance id, a freed camera reads as null
+    void set_voxel_camera(VoxelCamera *camera);
+    VoxelCamera *get_voxel_camera() const;
+
+    void set_voxel_data(const Ref<VoxelData> &data) { voxel_data = data; }
+    Ref<VoxelData> get_voxel_data() const { return voxel_data; }
+
+    void set_voxel_scale(float s) { voxel_scale = s; }
+    float get_voxel_scale() const { return voxel_scale; }
+
     void set_brick_map_size(const Vector3i &p) { brick_map_size = p; }
     Vector3i get_brick_map_size() const { return brick_map_size; }
 
@@ -31,12 +49,28 @@ class VoxelEntity : public Node3D {
     void set_health(float h) { health = h; }
     float get_health() const { return health; }
 
+    int get_entity_id() const { return entity_id; }
+
+    // ---------------- Model ----------------
+    // equal keys are equal voxels, the camera builds a model only for a key it does not have yet
+    String get_model_key() const;
+    // loads voxel_data when it is not loaded yet
+    void load_model();
+    Vector3i get_model_size() const;
+    Voxel get_model_voxel(const Vector3i &pos) const;
+
   private:
+    void register_with_camera();
+    void unregister_from_camera();
+
+    ObjectID voxel_camera_id;
+    Ref<VoxelData> voxel_data;
+    float voxel_scale = 0.1f; // world units per voxel
     Vector3i brick_map_size = Vector3i(3, 3, 3); // ~24^3 voxels
     int radius_voxels = 10;
     Color color = Color(0.2f, 0.9f, 0.45f, 1.0f); // green-ish
     float health = 50.0f;
+    int entity_id = -1;
 };
 
 #endif // VOXEL_ENTITY_H
-
@@ -0,0 +1,82 @@
+#include "voxel_particle_system.h"
+#include <algorithm>
+
+using namespace godot;
+
+void VoxelParticleRIDs::add_particle_buffers(ComputeShader *shader, int first_binding) const
+{
+    shader->add_existing_buffer(params, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, first_binding, 1);
+    shader->add_existing_buffer(free_list, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, first_binding + 1, 1);
+    shader->add_existing_buffer(particles, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, first_binding + 2, 1);
+}
+
+VoxelParticleSystem::VoxelParticleSystem(RenderingDevice *rd, VoxelWorldRIDs &voxel_world_rids, int capacity,
+                                         float scale)
+    : _rd(rd)
+{
+    capacity = std::max(capacity, 1);
+    _rids.capacity = capacity;
+
+    // gravity in voxels / s^2
+    _params.gravity = Vector4(0.0f, -9.81f / scale, 0.0f, 0.0f);
+    _params.delta = 1.0f / 60.0f;
+    _params.capacity = capacity;
+    _params.spawn_enabled = 1u;
+    _params._pad0 = 0.0f;
+
+    PackedByteArray params_data = _params.to_packed_byte_array();
+    _rids.params = _rd->storage_buffer_create(params_data.size(), params_data);
+
+    // free list: count followed by every slot
+    PackedByteArray free_list;
+    free_list.resize((capacity + 1) * sizeof(uint32_t));
+    uint32_t *free_ptr = reinterpret_cast<uint32_t *>(free_list.ptrw());
+    free_ptr[0] = capacity;
+    for (int i = 0; i < capacity; ++i)
+    {
+        free_ptr[i + 1] = capacity - 1 - i;
+    }
+    _rids.free_list = _rd->storage_buffer_create(free_list.size(), free_list);
+
+    PackedByteArray particles;
+    particles.resize(capacity * PARTICLE_SIZE);
+    particles.fill(0);
+    _rids.particles = _rd->storage_buffer_create(particles.size(), particles);
+
+    update_shader = new ComputeShader("res://addons/voxel_playground/src/shaders/particles/particle_update.glsl", rd);
+    voxel_world_rids.add_voxel_buffers(update_shader);
+    _rids.add_particle_buffers(update_shader, 0);
+    update_shader->add_existing_buffer(voxel_world_rids.changed_bricks, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER,
+                                       3, 1); // landed particles
+    update_shader->finish_create_uniforms();
+}
+
+VoxelParticleSystem::~VoxelParticleSystem()
+{
+    // the shader's uniform set uses the buffers, so it goes first
+    delete update_shader;
+    for (const RID &rid : {_rids.params, _rids.free_list, _rids.particles})
+        if (rid.is_valid())
+            _rd->free_rid(rid);
+}
+
+void VoxelParticleSystem::begin_frame(float delta)
+{
+    _params.delta = delta;
+    PackedByteArray params_data = _params.to_packed_byte_array();
+    _rd->buffer_update(_rids.params, 0, params_data.size(), params_data);
+}
+
+void VoxelParticleSystem::update()
+{
+    if (update_shader == nullptr || !update_shader->check_ready())
+    {
+        UtilityFunctions::printerr("VoxelParticleSystem::update() compute shader is null or not ready");
+        return;
+    }
+
+    uint64_t start = Time::get_singleton()->get_ticks_usec();
+    const int group_size = 64;
+    update_shader->compute(Vector3i((_rids.capacity + group_size - 1) / group_size, 1, 1), false);
+    _time_update_us = Time::get_singleton()->get_ticks_usec() - start;
+}
@@ -0,0 +1,75 @@
+#ifndef VOXEL_PARTICLE_SYSTEM_H
+#define VOXEL_PARTICLE_SYSTEM_H
+
+#include <godot_cpp/classes/rendering_device.hpp>
+#include <godot_cpp/variant/rid.hpp>
+#include <godot_cpp/classes/time.hpp>
+
+#include "gdcs/include/gdcs.h"
+#include "voxel_world/voxel_properties.h"
+
+using namespace godot;
+
+// RIDs of the particle pool, shared by every shader that spawns, simulates or draws particles.
+// Matches the buffers declared in particles/particle_pool.glsl.
+struct VoxelParticleRIDs
+{
+    RID params;
+    RID free_list;
+    RID particles;
+
+    unsigned int capacity = 0;
+
+    void add_particle_buffers(ComputeShader *shader, int first_binding) const;
+};
+
+// Hybrid particle representation: dynamic voxels that are ejected (explosions) or in free fall leave the grid
+// and are integrated ballistically as particles, turning back into grid voxels once they hit something.
+class VoxelParticleSystem
+{
+    struct ParticleParams // match the struct on the gpu
+    {
+        Vector4 gravity;
+        float delta;
+        unsigned int capacity;
+        unsigned int spawn_enabled;
+        float _pad0;
+
+        PackedByteArray to_packed_byte_array()
+        {
+            PackedByteArray byte_array;
+            byte_array.resize(sizeof(ParticleParams));
+            std::memcpy(byte_array.ptrw(), this, sizeof(ParticleParams));
+            return byte_array;
+        }
+    };
+
+  public:
+    static constexpr int PARTICLE_SIZE = 2 * sizeof(Vector4);
+
+    VoxelParticleSystem(RenderingDevice *rd, VoxelWorldRIDs &voxel_world_rids, int capacity, float scale);
+    ~VoxelParticleSystem();
+
+    // uploads the frame parameters, call before the automata run so spawns see the current delta
+    void begin_frame(float delta);
+    // integrates all particles and deposits the ones that landed, call after the automata
+    void update();
+
+    void set_spawn_enabled(bool enabled) { _params.spawn_enabled = enabled ? 1u : 0u; }
+    bool get_spawn_enabled() const { return _params.spawn_enabled != 0u; }
+
+    const VoxelParticleRIDs &get_rids() const { return _rids; }
+
+    uint64_t get_time_update_us() const { return _time_update_us; }
+
+  private:
+    RenderingDevice *_rd = nullptr;
+    ComputeShader *update_shader = nullptr;
+
+    ParticleParams _params;
+    VoxelParticleRIDs _rids;
+
+    uint64_t _time_update_us = 0;
+};
+
+#endif // VOXEL_PARTICLE_SYSTEM_H
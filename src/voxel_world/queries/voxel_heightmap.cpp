@@ -0,0 +1,57 @@
+#include "voxel_heightmap.h"
+#include "voxel_world_mirror.h"
+#include <algorithm>
+
+using namespace godot;
+
+void VoxelHeightmap::resize(const Vector3i &grid_size)
+{
+    _grid_size = grid_size;
+    _tops.assign(size_t(grid_size.x) * grid_size.z, NO_GROUND);
+    _types.assign(size_t(grid_size.x) * grid_size.z, 0);
+}
+
+void VoxelHeightmap::rebuild(const VoxelWorldMirror &mirror)
+{
+    for (int z = 0; z < _grid_size.z; ++z)
+        for (int x = 0; x < _grid_size.x; ++x)
+            scan_column(mirror, x, z);
+}
+
+void VoxelHeightmap::update_brick(const VoxelWorldMirror &mirror, const Vector3i &brick)
+{
+    const Vector3i brick_min = brick * VoxelWorldProperties::BRICK_SIZE;
+    const int brick_top = brick_min.y + VoxelWorldProperties::BRICK_SIZE - 1;
+    for (int z = brick_min.z; z < std::min(brick_min.z + VoxelWorldProperties::BRICK_SIZE, _grid_size.z); ++z)
+        for (int x = brick_min.x; x < std::min(brick_min.x + VoxelWorldProperties::BRICK_SIZE, _grid_size.x); ++x)
+        {
+            // a change below the current top cannot move it
+            if (_tops[x + z * _grid_size.x] > brick_top)
+                continue;
+            scan_column(mirror, x, z);
+        }
+}
+
+void VoxelHeightmap::scan_column(const VoxelWorldMirror &mirror, int x, int z)
+{
+    const size_t column = x + z * _grid_size.x;
+    _tops[column] = NO_GROUND;
+    _types[column] = 0;
+    const int top_brick = (_grid_size.y - 1) / VoxelWorldProperties::BRICK_SIZE;
+    for (int brick_y = top_brick; brick_y >= 0; --brick_y)
+    {
+        const int brick_min = brick_y * VoxelWorldProperties::BRICK_SIZE;
+        if (mirror.is_brick_empty(mirror.get_properties().getBrickIndex(Vector3i(x, brick_min, z))))
+            continue;
+        for (int y = std::min(brick_min + VoxelWorldProperties::BRICK_SIZE, _grid_size.y) - 1; y >= brick_min; --y)
+        {
+            const uint8_t type = mirror.get_voxel_type(Vector3i(x, y, z));
+            if (VoxelWorldMirror::is_solid_type(type))
+            {
+                _tops[column] = int16_t(y);
+                _types[column] = type;
+                return;
+            }
+        }
+    }
+}
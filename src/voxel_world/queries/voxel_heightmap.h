@@ -0,0 +1,46 @@
+#ifndef VOXEL_HEIGHTMAP_H
+#define VOXEL_HEIGHTMAP_H
+
+#include <godot_cpp/variant/vector3i.hpp>
+#include <vector>
+
+using namespace godot;
+
+class VoxelWorldMirror;
+
+// Topmost solid voxel of every (x, z) column of the CPU mirror, with its type, so ground queries are a lookup.
+// Solid means the same as isVoxelSolid on the GPU: not air and not liquid. The mirror keeps it up to date: only the
+// columns of bricks that changed are rescanned, and only if the change can reach their top.
+class VoxelHeightmap
+{
+  public:
+    static constexpr int NO_GROUND = -1;
+
+    void resize(const Vector3i &grid_size);
+    void rebuild(const VoxelWorldMirror &mirror);
+    void update_brick(const VoxelWorldMirror &mirror, const Vector3i &brick);
+
+    // grid y of the topmost solid voxel, NO_GROUND if the column is empty or outside the world
+    int get_top(int x, int z) const
+    {
+        if (x < 0 || z < 0 || x >= _grid_size.x || z >= _grid_size.z)
+            return NO_GROUND;
+        return _tops[x + z * _grid_size.x];
+    }
+    uint8_t get_type(int x, int z) const
+    {
+        if (x < 0 || z < 0 || x >= _grid_size.x || z >= _grid_size.z)
+            return 0;
+        return _types[x + z * _grid_size.x];
+    }
+
+  private:
+    Vector3i _grid_size;
+    std::vector<int16_t> _tops;
+    std::vector<uint8_t> _types;
+
+    // walks down from the top, empty bricks are skipped whole
+    void scan_column(const VoxelWorldMirror &mirror, int x, int z);
+};
+
+#endif // VOXEL_HEIGHTMAP_H
@@ -0,0 +1,146 @@
+#include "voxel_raycast_pass.h"
+#include <godot_cpp/classes/time.hpp>
+#include <algorithm>
+
+using namespace godot;
+
+VoxelRaycastPass::VoxelRaycastPass(RenderingDevice *rd, VoxelWorldRIDs &voxel_world_rids) : _rd(rd)
+{
+    _params = {};
+    raycast_shader = create_shader(voxel_world_rids, _params_rid, _rays_rid, _hits_rid);
+    async_shader = create_shader(voxel_world_rids, _async_params_rid, _async_rays_rid, _async_hits_rid);
+}
+
+VoxelRaycastPass::~VoxelRaycastPass()
+{
+    // the shaders own their buffers
+    delete raycast_shader;
+    delete async_shader;
+}
+
+ComputeShader *VoxelRaycastPass::create_shader(VoxelWorldRIDs &voxel_world_rids, RID &params_rid, RID &rays_rid,
+                                               RID &hits_rid)
+{
+    ComputeShader *shader =
+        new ComputeShader("res://addons/voxel_playground/src/shaders/queries/raycast_batch.glsl", _rd);
+    voxel_world_rids.add_voxel_buffers(shader);
+
+    PackedByteArray rays, hits;
+    rays.resize(MAX_RAYS * sizeof(Ray));
+    hits.resize(MAX_RAYS * HIT_STRIDE * sizeof(float));
+    params_rid = shader->create_storage_buffer_uniform(_params.to_packed_byte_array(), 0, 1);
+    rays_rid = shader->create_storage_buffer_uniform(rays, 1, 1);
+    hits_rid = shader->create_storage_buffer_uniform(hits, 2, 1);
+    shader->finish_create_uniforms();
+    return shader;
+}
+
+void VoxelRaycastPass::upload(RID params_rid, RID rays_rid, const Ray *rays, uint32_t count)
+{
+    PackedByteArray ray_data;
+    ray_data.resize(count * sizeof(Ray));
+    std::memcpy(ray_data.ptrw(), rays, ray_data.size());
+    _rd->buffer_update(rays_rid, 0, ray_data.size(), ray_data);
+
+    _params.ray_count = count;
+    PackedByteArray params_data = _params.to_packed_byte_array();
+    _rd->buffer_update(params_rid, 0, params_data.size(), params_data);
+}
+
+PackedFloat32Array VoxelRaycastPass::raycast_batch(const PackedVector3Array &origins,
+                                                   const PackedVector3Array &directions,
+                                                   const PackedFloat32Array &ranges, float near)
+{
+    PackedFloat32Array result;
+    const int64_t ray_count = origins.size();
+    if (directions.size() != ray_count || (ranges.size() != ray_count && ranges.size() != 1))
+    {
+        UtilityFunctions::printerr("VoxelRaycastPass::raycast_batch() origins and directions must have the same "
+                                   "size, ranges the same size or a single value");
+        return result;
+    }
+    if (raycast_shader == nullptr || !raycast_shader->check_ready())
+    {
+        UtilityFunctions::printerr("VoxelRaycastPass::raycast_batch() shader is null or not ready");
+        return result;
+    }
+
+    uint64_t start = Time::get_singleton()->get_ticks_usec();
+    result.resize(ray_count * HIT_STRIDE);
+
+    std::vector<Ray> rays;
+    for (int64_t first = 0; first < ray_count; first += MAX_RAYS)
+    {
+        const int64_t count = std::min<int64_t>(MAX_RAYS, ray_count - first);
+        rays.resize(count);
+        for (int64_t i = 0; i < count; ++i)
+        {
+            const Vector3 &origin = origins[first + i];
+            const Vector3 direction = directions[first + i].normalized();
+            const float far = ranges.size() == 1 ? ranges[0] : ranges[first + i];
+            rays[i].origin = Vector4(origin.x, origin.y, origin.z, near);
+            rays[i].direction = Vector4(direction.x, direction.y, direction.z, far);
+        }
+        upload(_params_rid, _rays_rid, rays.data(), count);
+
+        const int group_size = 64;
+        raycast_shader->compute(Vector3i((count + group_size - 1) / group_size, 1, 1), false);
+
+        // the hits are laid out exactly like the result, copy them straight over
+        PackedByteArray hit_data = raycast_shader->get_storage_buffer_uniform(_hits_rid);
+        std::memcpy(result.ptrw() + first * HIT_STRIDE, hit_data.ptr(), count * HIT_STRIDE * sizeof(float));
+    }
+
+    _time_last_batch_us = Time::get_singleton()->get_ticks_usec() - start;
+    return result;
+}
+
+void VoxelRaycastPass::queue_async(const Vector3 &origin, const Vector3 &direction, float near, float far,
+                                   const Callable &callback)
+{
+    const Vector3 normalized = direction.normalized();
+    Ray ray;
+    ray.origin = Vector4(origin.x, origin.y, origin.z, near);
+    ray.direction = Vector4(normalized.x, normalized.y, normalized.z, far);
+    _queued_rays.push_back(ray);
+    _queued_callbacks.push_back(callback);
+}
+
+void VoxelRaycastPass::flush_async(const Callable &on_fetched)
+{
+    // single flight: the next batch goes out once the previous one has been delivered
+    if (_queued_rays.empty() || !_in_flight_callbacks.empty())
+        return;
+    if (async_shader == nullptr || !async_shader->check_ready())
+    {
+        UtilityFunctions::printerr("VoxelRaycastPass::flush_async() shader is null or not ready");
+        return;
+    }
+
+    const uint32_t count = std::min<size_t>(MAX_RAYS, _queued_rays.size());
+    upload(_async_params_rid, _async_rays_rid, _queued_rays.data(), count);
+    const int group_size = 64;
+    async_shader->compute(Vector3i((count + group_size - 1) / group_size, 1, 1), false);
+    async_shader->get_storage_buffer_uniform_async(_async_hits_rid, on_fetched);
+
+    _in_flight_callbacks.assign(_queued_callbacks.begin(), _queued_callbacks.begin() + count);
+    _queued_rays.erase(_queued_rays.begin(), _queued_rays.begin() + count);
+    _queued_callbacks.erase(_queued_callbacks.begin(), _queued_callbacks.begin() + count);
+}
+
+void VoxelRaycastPass::on_async_fetched(const PackedByteArray &data)
+{
+    // the callbacks may queue new rays, so take the list first
+    std::vector<Callable> callbacks;
+    callbacks.swap(_in_flight_callbacks);
+
+    const float *hits = reinterpret_cast<const float *>(data.ptr());
+    const size_t hit_count = std::min<size_t>(callbacks.size(), data.size() / (HIT_STRIDE * sizeof(float)));
+    for (size_t i = 0; i < hit_count; ++i)
+    {
+        if (!callbacks[i].is_valid())
+            continue; // the receiver was freed in the meantime
+        const float *hit = hits + i * HIT_STRIDE;
+        callbacks[i].call(hit[0] >= 0.0f ? Vector4(hit[4], hit[5], hit[6], 1.0f) : Vector4(0, 0, 0, -1));
+    }
+}
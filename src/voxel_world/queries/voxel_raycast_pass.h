@@ -0,0 +1,87 @@
+#ifndef VOXEL_RAYCAST_PASS_H
+#define VOXEL_RAYCAST_PASS_H
+
+#include <godot_cpp/classes/rendering_device.hpp>
+#include <godot_cpp/variant/packed_float32_array.hpp>
+#include <godot_cpp/variant/packed_vector3_array.hpp>
+#include <godot_cpp/variant/callable.hpp>
+#include <godot_cpp/variant/rid.hpp>
+#include <vector>
+
+#include "gdcs/include/gdcs.h"
+#include "voxel_world/voxel_properties.h"
+
+using namespace godot;
+
+// Traces many rays against the voxel world with one dispatch and one readback.
+class VoxelRaycastPass
+{
+    struct RaycastParams // match the struct on the gpu
+    {
+        unsigned int ray_count;
+        unsigned int _pad0;
+        unsigned int _pad1;
+        unsigned int _pad2;
+
+        PackedByteArray to_packed_byte_array()
+        {
+            PackedByteArray byte_array;
+            byte_array.resize(sizeof(RaycastParams));
+            std::memcpy(byte_array.ptrw(), this, sizeof(RaycastParams));
+            return byte_array;
+        }
+    };
+
+    struct Ray // match the struct on the gpu
+    {
+        Vector4 origin;    // xyz origin in meters, w near
+        Vector4 direction; // xyz direction, w far
+    };
+
+  public:
+    static constexpr int MAX_RAYS = 1024; // per dispatch, larger batches take several
+    // floats per hit: distance (< 0 if nothing was hit), normal xyz, grid position xyz, voxel type
+    static constexpr int HIT_STRIDE = 8;
+
+    VoxelRaycastPass(RenderingDevice *rd, VoxelWorldRIDs &voxel_world_rids);
+    ~VoxelRaycastPass();
+
+    // ranges holds the far distance of every ray, or a single value for all of them
+    PackedFloat32Array raycast_batch(const PackedVector3Array &origins, const PackedVector3Array &directions,
+                                     const PackedFloat32Array &ranges, float near = 0.0f);
+
+    // Queues a ray for the next async batch, callback receives Vector4(grid position, w >= 0 if hit) like
+    // raycast_voxels once the readback completes. Never blocks.
+    void queue_async(const Vector3 &origin, const Vector3 &direction, float near, float far, const Callable &callback);
+    // dispatches the queued rays unless a batch is still in flight, call once per frame.
+    // on_fetched must forward the data to on_async_fetched().
+    void flush_async(const Callable &on_fetched);
+    void on_async_fetched(const PackedByteArray &data);
+
+    float get_time_last_batch_ms() const { return _time_last_batch_us / 1000.0f; }
+
+  private:
+    RenderingDevice *_rd = nullptr;
+    ComputeShader *raycast_shader = nullptr;
+
+    RaycastParams _params;
+    RID _params_rid;
+    RID _rays_rid;
+    RID _hits_rid;
+
+    // async batches use their own buffers, so a blocking batch never overwrites hits that are still being read
+    ComputeShader *async_shader = nullptr;
+    RID _async_params_rid;
+    RID _async_rays_rid;
+    RID _async_hits_rid;
+    std::vector<Ray> _queued_rays;
+    std::vector<Callable> _queued_callbacks;
+    std::vector<Callable> _in_flight_callbacks;
+
+    uint64_t _time_last_batch_us = 0;
+
+    ComputeShader *create_shader(VoxelWorldRIDs &voxel_world_rids, RID &params_rid, RID &rays_rid, RID &hits_rid);
+    void upload(RID params_rid, RID rays_rid, const Ray *rays, uint32_t count);
+};
+
+#endif // VOXEL_RAYCAST_PASS_H
@@ -0,0 +1,116 @@
+#include "voxel_shape_query_pass.h"
+#include <godot_cpp/classes/time.hpp>
+#include <algorithm>
+
+using namespace godot;
+
+VoxelShapeQueryPass::VoxelShapeQueryPass(RenderingDevice *rd, VoxelWorldRIDs &voxel_world_rids) : _rd(rd)
+{
+    _params = {};
+    shape_query_shader =
+        new ComputeShader("res://addons/voxel_playground/src/shaders/queries/shape_queries.glsl", rd);
+    voxel_world_rids.add_voxel_buffers(shape_query_shader);
+
+    PackedByteArray queries, results;
+    queries.resize(MAX_QUERIES * sizeof(ShapeQuery));
+    results.resize(MAX_QUERIES * RESULT_STRIDE * sizeof(uint32_t));
+    _params_rid = shape_query_shader->create_storage_buffer_uniform(_params.to_packed_byte_array(), 0, 1);
+    _queries_rid = shape_query_shader->create_storage_buffer_uniform(queries, 1, 1);
+    _results_rid = shape_query_shader->create_storage_buffer_uniform(results, 2, 1);
+    shape_query_shader->finish_create_uniforms();
+}
+
+VoxelShapeQueryPass::~VoxelShapeQueryPass()
+{
+    // the shader owns the params, query and result buffers
+    delete shape_query_shader;
+}
+
+void VoxelShapeQueryPass::run(Mode mode, const std::vector<ShapeQuery> &queries, uint32_t *result)
+{
+    uint64_t start = Time::get_singleton()->get_ticks_usec();
+    PackedByteArray query_data;
+    for (size_t first = 0; first < queries.size(); first += MAX_QUERIES)
+    {
+        const uint32_t count = std::min<size_t>(MAX_QUERIES, queries.size() - first);
+        query_data.resize(count * sizeof(ShapeQuery));
+        std::memcpy(query_data.ptrw(), queries.data() + first, query_data.size());
+        _rd->buffer_update(_queries_rid, 0, query_data.size(), query_data);
+
+        _params.mode = mode;
+        _params.query_count = count;
+        PackedByteArray params_data = _params.to_packed_byte_array();
+        _rd->buffer_update(_params_rid, 0, params_data.size(), params_data);
+
+        // one workgroup per query
+        shape_query_shader->compute(Vector3i(count, 1, 1), false);
+
+        PackedByteArray result_data = shape_query_shader->get_storage_buffer_uniform(_results_rid);
+        std::memcpy(result + first * RESULT_STRIDE, result_data.ptr(), count * RESULT_STRIDE * sizeof(uint32_t));
+    }
+    _time_last_batch_us = Time::get_singleton()->get_ticks_usec() - start;
+}
+
+PackedFloat32Array VoxelShapeQueryPass::sweep_sphere_batch(const PackedVector3Array &froms,
+                                                           const PackedVector3Array &tos,
+                                                           const PackedFloat32Array &radii)
+{
+    PackedFloat32Array result;
+    const int64_t query_count = froms.size();
+    if (tos.size() != query_count || (radii.size() != query_count && radii.size() != 1))
+    {
+        UtilityFunctions::printerr("VoxelShapeQueryPass::sweep_sphere_batch() froms and tos must have the same "
+                                   "size, radii the same size or a single value");
+        return result;
+    }
+    if (shape_query_shader == nullptr || !shape_query_shader->check_ready())
+    {
+        UtilityFunctions::printerr("VoxelShapeQueryPass::sweep_sphere_batch() shader is null or not ready");
+        return result;
+    }
+
+    std::vector<ShapeQuery> queries(query_count);
+    for (int64_t i = 0; i < query_count; ++i)
+    {
+        const Vector3 &from = froms[i];
+        const Vector3 &to = tos[i];
+        queries[i] = {};
+        queries[i].from = Vector4(from.x, from.y, from.z, radii.size() == 1 ? radii[0] : radii[i]);
+        queries[i].to = Vector4(to.x, to.y, to.z, 0.0f);
+    }
+    result.resize(query_count * RESULT_STRIDE);
+    // the shader writes the float bits, so the results can be copied straight over
+    static_assert(sizeof(float) == sizeof(uint32_t));
+    run(MODE_SWEEP, queries, reinterpret_cast<uint32_t *>(result.ptrw()));
+    return result;
+}
+
+PackedInt32Array VoxelShapeQueryPass::overlap_count_batch(const PackedVector3Array &centers,
+                                                          const PackedFloat32Array &radii, uint32_t type_mask)
+{
+    PackedInt32Array result;
+    const int64_t query_count = centers.size();
+    if (radii.size() != query_count && radii.size() != 1)
+    {
+        UtilityFunctions::printerr("VoxelShapeQueryPass::overlap_count_batch() radii must have the same size as "
+                                   "centers or a single value");
+        return result;
+    }
+    if (shape_query_shader == nullptr || !shape_query_shader->check_ready())
+    {
+        UtilityFunctions::printerr("VoxelShapeQueryPass::overlap_count_batch() shader is null or not ready");
+        return result;
+    }
+
+    std::vector<ShapeQuery> queries(query_count);
+    for (int64_t i = 0; i < query_count; ++i)
+    {
+        const Vector3 &center = centers[i];
+        queries[i] = {};
+        queries[i].from = Vector4(center.x, center.y, center.z, radii.size() == 1 ? radii[0] : radii[i]);
+        queries[i].type_mask = type_mask;
+    }
+    result.resize(query_count * RESULT_STRIDE);
+    run(MODE_OVERLAP, queries, reinterpret_cast<uint32_t *>(result.ptrw()));
+    return result;
+}
@@ -0,0 +1,85 @@
+#ifndef VOXEL_SHAPE_QUERY_PASS_H
+#define VOXEL_SHAPE_QUERY_PASS_H
+
+#include <godot_cpp/classes/rendering_device.hpp>
+#include <godot_cpp/variant/packed_float32_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_vector3_array.hpp>
+#include <godot_cpp/variant/rid.hpp>
+#include <vector>
+
+#include "gdcs/include/gdcs.h"
+#include "voxel_world/voxel_properties.h"
+
+using namespace godot;
+
+// Sphere sweeps and overlap counts on the GPU, one workgroup per query, one dispatch and readback per batch.
+// Results match the CPU versions in VoxelWorldMirror.
+class VoxelShapeQueryPass
+{
+    struct ShapeQueryParams // match the struct on the gpu
+    {
+        unsigned int mode;
+        unsigned int query_count;
+        unsigned int _pad0;
+        unsigned int _pad1;
+
+        PackedByteArray to_packed_byte_array()
+        {
+            PackedByteArray byte_array;
+            byte_array.resize(sizeof(ShapeQueryParams));
+            std::memcpy(byte_array.ptrw(), this, sizeof(ShapeQueryParams));
+            return byte_array;
+        }
+    };
+
+    struct ShapeQuery // match the struct on the gpu
+    {
+        Vector4 from; // xyz sphere center in meters, w radius in meters
+        Vector4 to;   // xyz end of the sweep in meters
+        unsigned int type_mask;
+        unsigned int _pad0;
+        unsigned int _pad1;
+        unsigned int _pad2;
+    };
+
+    enum Mode
+    {
+        MODE_SWEEP = 0,
+        MODE_OVERLAP = 1,
+    };
+
+  public:
+    static constexpr int MAX_QUERIES = 1024; // per dispatch, larger batches take several
+    // values per query: a raycast hit (see VoxelRaycastPass::HIT_STRIDE) or the voxel count of every type
+    static constexpr int RESULT_STRIDE = 8;
+
+    VoxelShapeQueryPass(RenderingDevice *rd, VoxelWorldRIDs &voxel_world_rids);
+    ~VoxelShapeQueryPass();
+
+    // radii holds the radius of every query in meters, or a single value for all of them. Sweeps stop at solid
+    // voxels only.
+    PackedFloat32Array sweep_sphere_batch(const PackedVector3Array &froms, const PackedVector3Array &tos,
+                                          const PackedFloat32Array &radii);
+    // type_mask has a bit per voxel type, counts of the other types stay 0
+    PackedInt32Array overlap_count_batch(const PackedVector3Array &centers, const PackedFloat32Array &radii,
+                                         uint32_t type_mask);
+
+    float get_time_last_batch_ms() const { return _time_last_batch_us / 1000.0f; }
+
+  private:
+    RenderingDevice *_rd = nullptr;
+    ComputeShader *shape_query_shader = nullptr;
+
+    ShapeQueryParams _params;
+    RID _params_rid;
+    RID _queries_rid;
+    RID _results_rid;
+
+    uint64_t _time_last_batch_us = 0;
+
+    // runs the queries in chunks of MAX_QUERIES and writes RESULT_STRIDE values per query to result
+    void run(Mode mode, const std::vector<ShapeQuery> &queries, uint32_t *result);
+};
+
+#endif // VOXEL_SHAPE_QUERY_PASS_H
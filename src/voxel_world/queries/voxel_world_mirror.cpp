@@ -0,0 +1,568 @@
+#include "voxel_world_mirror.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace godot;
+
+static constexpr float RAY_INFINITY = std::numeric_limits<float>::infinity();
+static constexpr float MIN_DIRECTION = 1e-8f;
+
+VoxelWorldMirror::VoxelWorldMirror(RenderingDevice *rd, const VoxelWorldRIDs &voxel_world_rids,
+                                   const VoxelWorldProperties &properties)
+    : _rd(rd), _voxel_world_rids(voxel_world_rids), _properties(properties)
+{
+    _grid_size = Vector3i(properties.grid_size.x, properties.grid_size.y, properties.grid_size.z);
+    _brick_grid_size = Vector3i(properties.brick_grid_size.x, properties.brick_grid_size.y, properties.brick_grid_size.z);
+    _brick_count = _brick_grid_size.x * _brick_grid_size.y * _brick_grid_size.z;
+    _types.resize(size_t(_brick_count) * VoxelWorldProperties::BRICK_VOLUME, 0);
+    _occupancy.resize(_brick_count, 0);
+    _heightmap.resize(_grid_size);
+}
+
+void VoxelWorldMirror::store_bricks(const uint8_t *data, uint32_t first_brick, uint32_t brick_count,
+                                    bool update_heightmap)
+{
+    const uint32_t *voxels = reinterpret_cast<const uint32_t *>(data);
+    brick_count = std::min(brick_count, _brick_count - std::min(first_brick, _brick_count));
+    for (uint32_t b = 0; b < brick_count; ++b)
+    {
+        const size_t offset = size_t(first_brick + b) * VoxelWorldProperties::BRICK_VOLUME;
+        uint16_t occupancy = 0;
+        bool changed = false;
+        for (int v = 0; v < VoxelWorldProperties::BRICK_VOLUME; ++v)
+        {
+            const uint8_t type = voxels[size_t(b) * VoxelWorldProperties::BRICK_VOLUME + v] >> 24;
+            changed |= _types[offset + v] != type;
+            _types[offset + v] = type;
+            occupancy += type != 0;
+        }
+        _occupancy[first_brick + b] = occupancy;
+
+        if (changed && update_heightmap)
+        {
+            const uint32_t brick = first_brick + b;
+            _heightmap.update_brick(*this, Vector3i(brick % _brick_grid_size.x,
+                                                    (brick / _brick_grid_size.x) % _brick_grid_size.y,
+                                                    brick / (_brick_grid_size.x * _brick_grid_size.y)));
+        }
+    }
+}
+
+void VoxelWorldMirror::mark_dirty(const std::vector<uint32_t> &bricks)
+{
+    _dirty_bricks.insert(_dirty_bricks.end(), bricks.begin(), bricks.end());
+}
+
+void VoxelWorldMirror::request_updates(unsigned int frame, const Callable &on_fetched, int bricks_per_frame)
+{
+    if (_brick_count == 0)
+        return;
+    // read the buffer the simulation just wrote
+    RID source = frame % 2 == 0 ? _voxel_world_rids.voxel_data : _voxel_world_rids.voxel_data2;
+    uint32_t budget = std::max(bricks_per_frame, 1);
+
+    auto fetch = [&](uint32_t first, uint32_t count) {
+        _rd->buffer_get_data_async(source, on_fetched.bind(first), first * BRICK_BYTES, count * BRICK_BYTES);
+    };
+
+    // the first copy streams in over a few frames instead of stalling on the whole world at once. Bricks edited
+    // meanwhile stay dirty until it is complete, so only its ranges are in flight.
+    if (!is_synced())
+    {
+        if (_sync_next < _brick_count)
+        {
+            const uint32_t count = std::min(SYNC_BRICKS_PER_FRAME, _brick_count - _sync_next);
+            fetch(_sync_next, count);
+            _sync_next += count;
+        }
+        return;
+    }
+
+    // edited bricks first, one readback per contiguous run
+    std::sort(_dirty_bricks.begin(), _dirty_bricks.end());
+    _dirty_bricks.erase(std::unique(_dirty_bricks.begin(), _dirty_bricks.end()), _dirty_bricks.end());
+    size_t taken = 0;
+    while (taken < _dirty_bricks.size() && budget > 0)
+    {
+        const uint32_t first = _dirty_bricks[taken];
+        uint32_t count = 1;
+        while (taken + count < _dirty_bricks.size() && count < budget && _dirty_bricks[taken + count] == first + count)
+            ++count;
+        fetch(first, count);
+        taken += count;
+        budget -= count;
+    }
+    _dirty_bricks.erase(_dirty_bricks.begin(), _dirty_bricks.begin() + taken);
+
+    // the rest of the budget continues the round robin
+    budget = std::min(budget, _brick_count);
+    while (budget > 0)
+    {
+        const uint32_t count = std::min(budget, _brick_count - _next_brick);
+        fetch(_next_brick, count);
+        _next_brick = (_next_brick + count) % _brick_count;
+        budget -= count;
+    }
+}
+
+void VoxelWorldMirror::on_bricks_fetched(const PackedByteArray &data, uint32_t first_brick)
+{
+    const uint32_t brick_count = data.size() / BRICK_BYTES;
+    if (is_synced())
+    {
+        store_bricks(data.ptr(), first_brick, brick_count, true);
+        return;
+    }
+
+    // a range of the first copy, the heightmap is built once they are all in
+    store_bricks(data.ptr(), first_brick, brick_count, false);
+    _sync_received += brick_count;
+    if (is_synced())
+        _heightmap.rebuild(*this);
+}
+
+uint8_t VoxelWorldMirror::get_voxel_type(const Vector3i &grid_position) const
+{
+    if (!_properties.isValidPos(grid_position))
+        return 0;
+    return _types[_properties.pos_to_voxel_index(grid_position)];
+}
+
+bool VoxelWorldMirror::trace(const Vector3 &o, const Vector3 &d, float t, float t_end, int entry_axis,
+                             VoxelRayHit &hit) const
+{
+    int step[3];
+    float t_delta[3], t_max[3];
+    Vector3i voxel;
+    Vector3 normal;
+    if (entry_axis >= 0)
+        normal[entry_axis] = d[entry_axis] > 0.0f ? -1.0f : 1.0f;
+
+    const Vector3 start = o + d * t;
+    for (int a = 0; a < 3; ++a)
+    {
+        voxel[a] = std::clamp(int(std::floor(start[a])), 0, _grid_size[a] - 1);
+        if (std::abs(d[a]) < MIN_DIRECTION)
+        {
+            step[a] = 0;
+            t_delta[a] = t_max[a] = RAY_INFINITY;
+            continue;
+        }
+        step[a] = d[a] > 0.0f ? 1 : -1;
+        t_delta[a] = 1.0f / std::abs(d[a]);
+        t_max[a] = ((step[a] > 0 ? voxel[a] + 1 : voxel[a]) - o[a]) / d[a];
+    }
+
+    int max_steps = 2 * (_grid_size.x + _grid_size.y + _grid_size.z) + 16;
+    while (t <= t_end && max_steps-- > 0)
+    {
+        if (!_properties.isValidPos(voxel))
+            return false;
+
+        const Vector3i brick_min = (voxel / VoxelWorldProperties::BRICK_SIZE) * VoxelWorldProperties::BRICK_SIZE;
+        if (_occupancy[_properties.getBrickIndex(voxel)] == 0)
+        {
+            // empty brick: continue from where the ray leaves it
+            float t_leave = RAY_INFINITY;
+            int axis = -1;
+            for (int a = 0; a < 3; ++a)
+            {
+                if (step[a] == 0)
+                    continue;
+                const float boundary = step[a] > 0 ? brick_min[a] + VoxelWorldProperties::BRICK_SIZE : brick_min[a];
+                const float t_boundary = (boundary - o[a]) / d[a];
+                if (t_boundary < t_leave)
+                {
+                    t_leave = t_boundary;
+                    axis = a;
+                }
+            }
+            if (axis < 0)
+                return false;
+
+            t = std::max(t, t_leave);
+            const Vector3 p = o + d * t;
+            for (int a = 0; a < 3; ++a)
+                voxel[a] = std::clamp(int(std::floor(p[a])), brick_min[a], brick_min[a] + VoxelWorldProperties::BRICK_SIZE - 1);
+            voxel[axis] = step[axis] > 0 ? brick_min[axis] + VoxelWorldProperties::BRICK_SIZE : brick_min[axis] - 1;
+            for (int a = 0; a < 3; ++a)
+                if (step[a] != 0)
+                    t_max[a] = ((step[a] > 0 ? voxel[a] + 1 : voxel[a]) - o[a]) / d[a];
+            normal = Vector3();
+            normal[axis] = -step[axis];
+            continue;
+        }
+
+        const uint8_t type = _types[_properties.pos_to_voxel_index(voxel)];
+        if (type != 0)
+        {
+            hit.distance = t * _properties.scale;
+            hit.normal = normal;
+            hit.grid_position = voxel;
+            hit.type = type;
+            return true;
+        }
+
+        int axis = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+        t = t_max[axis];
+        t_max[axis] += t_delta[axis];
+        voxel[axis] += step[axis];
+        normal = Vector3();
+        normal[axis] = -step[axis];
+    }
+    return false;
+}
+
+// Normalizes and clips a packet of rays against the world box, laid out as structure of arrays so the compiler can
+// vectorize it. Everything is converted to voxel units.
+struct RayPacket
+{
+    float o[3][VoxelWorldMirror::PACKET_SIZE];
+    float d[3][VoxelWorldMirror::PACKET_SIZE];
+    float t_start[VoxelWorldMirror::PACKET_SIZE];
+    float t_end[VoxelWorldMirror::PACKET_SIZE];
+    int entry_axis[VoxelWorldMirror::PACKET_SIZE];
+
+    void clip(const Vector3i &grid_size, float inv_scale, float near, const float *far)
+    {
+        constexpr int P = VoxelWorldMirror::PACKET_SIZE;
+        float length[P];
+        for (int i = 0; i < P; ++i)
+            length[i] = std::sqrt(d[0][i] * d[0][i] + d[1][i] * d[1][i] + d[2][i] * d[2][i]);
+        for (int a = 0; a < 3; ++a)
+            for (int i = 0; i < P; ++i)
+            {
+                o[a][i] *= inv_scale;
+                d[a][i] = length[i] > 0.0f ? d[a][i] / length[i] : 0.0f;
+            }
+
+        float t_entry[P], t_exit[P];
+        for (int i = 0; i < P; ++i)
+        {
+            t_entry[i] = -RAY_INFINITY;
+            t_exit[i] = RAY_INFINITY;
+            entry_axis[i] = -1;
+        }
+        for (int a = 0; a < 3; ++a)
+            for (int i = 0; i < P; ++i)
+            {
+                const float dir = std::abs(d[a][i]) < MIN_DIRECTION ? std::copysign(MIN_DIRECTION, d[a][i]) : d[a][i];
+                const float t0 = (0.0f - o[a][i]) / dir;
+                const float t1 = (grid_size[a] - o[a][i]) / dir;
+                const float t_near = std::min(t0, t1);
+                entry_axis[i] = t_near > t_entry[i] ? a : entry_axis[i];
+                t_entry[i] = std::max(t_entry[i], t_near);
+                t_exit[i] = std::min(t_exit[i], std::max(t0, t1));
+            }
+
+        for (int i = 0; i < P; ++i)
+        {
+            const float t_near = near * inv_scale;
+            // starting inside the world (or past near) there is no entry face
+            entry_axis[i] = t_entry[i] >= t_near ? entry_axis[i] : -1;
+            t_start[i] = std::max(t_entry[i], t_near);
+            t_end[i] = length[i] > 0.0f && t_exit[i] >= 0.0f ? std::min(t_exit[i], far[i] * inv_scale) : -1.0f;
+        }
+    }
+};
+
+bool VoxelWorldMirror::raycast(const Vector3 &origin, const Vector3 &direction, float near, float far,
+                               VoxelRayHit &hit) const
+{
+    RayPacket packet;
+    float fars[PACKET_SIZE];
+    for (int i = 0; i < PACKET_SIZE; ++i)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            packet.o[a][i] = origin[a];
+            packet.d[a][i] = direction[a];
+        }
+        fars[i] = far;
+    }
+    packet.clip(_grid_size, 1.0f / _properties.scale, near, fars);
+    if (packet.t_start[0] > packet.t_end[0])
+        return false;
+    return trace(Vector3(packet.o[0][0], packet.o[1][0], packet.o[2][0]),
+                 Vector3(packet.d[0][0], packet.d[1][0], packet.d[2][0]), packet.t_start[0], packet.t_end[0],
+                 packet.entry_axis[0], hit);
+}
+
+Vector4 VoxelWorldMirror::raycast_voxels(const Vector3 &origin, const Vector3 &direction, float near, float far) const
+{
+    VoxelRayHit hit;
+    if (!raycast(origin, direction, near, far, hit))
+        return Vector4(0, 0, 0, -1);
+    return Vector4(hit.grid_position.x, hit.grid_position.y, hit.grid_position.z, 1);
+}
+
+PackedFloat32Array VoxelWorldMirror::raycast_batch(const PackedVector3Array &origins,
+                                                   const PackedVector3Array &directions,
+                                                   const PackedFloat32Array &ranges, float near) const
+{
+    static constexpr int HIT_STRIDE = 8; // matches VoxelRaycastPass::HIT_STRIDE
+    PackedFloat32Array result;
+    const int64_t ray_count = origins.size();
+    if (directions.size() != ray_count || (ranges.size() != ray_count && ranges.size() != 1))
+    {
+        UtilityFunctions::printerr("VoxelWorldMirror::raycast_batch() origins and directions must have the same "
+                                   "size, ranges the same size or a single value");
+        return result;
+    }
+    result.resize(ray_count * HIT_STRIDE);
+    float *out = result.ptrw();
+
+    for (int64_t first = 0; first < ray_count; first += PACKET_SIZE)
+    {
+        const int count = int(std::min<int64_t>(PACKET_SIZE, ray_count - first));
+        RayPacket packet;
+        float fars[PACKET_SIZE];
+        for (int i = 0; i < PACKET_SIZE; ++i)
+        {
+            const int64_t ray = first + std::min(i, count - 1); // pad the last packet with its last ray
+            const Vector3 &origin = origins[ray];
+            const Vector3 &direction = directions[ray];
+            for (int a = 0; a < 3; ++a)
+            {
+                packet.o[a][i] = origin[a];
+                packet.d[a][i] = direction[a];
+            }
+            fars[i] = ranges.size() == 1 ? ranges[0] : ranges[ray];
+        }
+        packet.clip(_grid_size, 1.0f / _properties.scale, near, fars);
+
+        for (int i = 0; i < count; ++i)
+        {
+            VoxelRayHit hit;
+            float *h = out + (first + i) * HIT_STRIDE;
+            if (packet.t_start[i] <= packet.t_end[i] &&
+                trace(Vector3(packet.o[0][i], packet.o[1][i], packet.o[2][i]),
+                      Vector3(packet.d[0][i], packet.d[1][i], packet.d[2][i]), packet.t_start[i], packet.t_end[i],
+                      packet.entry_axis[i], hit))
+            {
+                h[0] = hit.distance;
+                h[1] = hit.normal.x;
+                h[2] = hit.normal.y;
+                h[3] = hit.normal.z;
+                h[4] = hit.grid_position.x;
+                h[5] = hit.grid_position.y;
+                h[6] = hit.grid_position.z;
+                h[7] = hit.type;
+            }
+            else
+            {
+                std::fill(h, h + HIT_STRIDE, 0.0f);
+                h[0] = -1.0f;
+            }
+        }
+    }
+    return result;
+}
+
+// entry of the segment o + d * t, t in [0, t_max], into the box
+static bool segment_box_entry(const Vector3 &o, const Vector3 &d, float t_max, const Vector3 &box_min,
+                              const Vector3 &box_max, float &t_entry)
+{
+    float t0 = 0.0f, t1 = t_max;
+    for (int a = 0; a < 3; ++a)
+    {
+        if (std::abs(d[a]) < MIN_DIRECTION)
+        {
+            if (o[a] < box_min[a] || o[a] > box_max[a])
+                return false;
+            continue;
+        }
+        const float ta = (box_min[a] - o[a]) / d[a];
+        const float tb = (box_max[a] - o[a]) / d[a];
+        t0 = std::max(t0, std::min(ta, tb));
+        t1 = std::min(t1, std::max(ta, tb));
+    }
+    t_entry = t0;
+    return t0 <= t1;
+}
+
+static Vector3 closest_point_on_box(const Vector3 &p, const Vector3 &box_min, const Vector3 &box_max)
+{
+    return Vector3(std::clamp(p.x, box_min.x, box_max.x), std::clamp(p.y, box_min.y, box_max.y),
+                   std::clamp(p.z, box_min.z, box_max.z));
+}
+
+bool VoxelWorldMirror::sweep_sphere(const Vector3 &from, const Vector3 &to, float radius, VoxelRayHit &hit) const
+{
+    static constexpr int REFINE_STEPS = 16;
+    static constexpr float SWEEP_EPSILON = 1e-3f;
+
+    // everything in voxel units
+    const float inv_scale = 1.0f / _properties.scale;
+    const Vector3 o = from * inv_scale;
+    const Vector3 delta = to * inv_scale - o;
+    const float r = radius * inv_scale;
+    const float length = delta.length();
+    const Vector3 d = length > 0.0f ? delta / length : Vector3();
+    const Vector3 extent(r, r, r);
+
+    Vector3i min_voxel, max_voxel;
+    for (int a = 0; a < 3; ++a)
+    {
+        min_voxel[a] = std::clamp(int(std::floor(std::min(o[a], o[a] + delta[a]) - r)), 0, _grid_size[a] - 1);
+        max_voxel[a] = std::clamp(int(std::floor(std::max(o[a], o[a] + delta[a]) + r)), 0, _grid_size[a] - 1);
+    }
+    const Vector3i min_brick = min_voxel / VoxelWorldProperties::BRICK_SIZE;
+    const Vector3i max_brick = max_voxel / VoxelWorldProperties::BRICK_SIZE;
+
+    float best = RAY_INFINITY;
+    for (int bz = min_brick.z; bz <= max_brick.z; ++bz)
+        for (int by = min_brick.y; by <= max_brick.y; ++by)
+            for (int bx = min_brick.x; bx <= max_brick.x; ++bx)
+            {
+                const Vector3i brick_min = Vector3i(bx, by, bz) * VoxelWorldProperties::BRICK_SIZE;
+                const Vector3i brick_max = brick_min + Vector3i(1, 1, 1) * VoxelWorldProperties::BRICK_SIZE;
+                float t;
+                if (_occupancy[_properties.getBrickIndex(brick_min)] == 0 ||
+                    !segment_box_entry(o, d, std::min(length, best), Vector3(brick_min) - extent,
+                                       Vector3(brick_max) + extent, t))
+                    continue;
+
+                const Vector3i lo = brick_min.max(min_voxel);
+                const Vector3i hi = (brick_max - Vector3i(1, 1, 1)).min(max_voxel);
+                for (int z = lo.z; z <= hi.z; ++z)
+                    for (int y = lo.y; y <= hi.y; ++y)
+                        for (int x = lo.x; x <= hi.x; ++x)
+                        {
+                            const Vector3i voxel(x, y, z);
+                            const uint8_t type = _types[_properties.pos_to_voxel_index(voxel)];
+                            if (!is_solid_type(type))
+                                continue;
+                            const Vector3 voxel_min(voxel);
+                            const Vector3 voxel_max = voxel_min + Vector3(1, 1, 1);
+                            const float t_max = std::min(length, best);
+                            if (!segment_box_entry(o, d, t_max, voxel_min - extent, voxel_max + extent, t))
+                                continue;
+                            // the expanded box is larger than the rounded one at edges and corners, sphere trace
+                            // the rest of the way
+                            for (int s = 0; s < REFINE_STEPS && t <= t_max; ++s)
+                            {
+                                const Vector3 center = o + d * t;
+                                const float distance =
+                                    (center - closest_point_on_box(center, voxel_min, voxel_max)).length() - r;
+                                if (distance <= SWEEP_EPSILON)
+                                {
+                                    best = t;
+                                    hit.grid_position = voxel;
+                                    hit.type = type;
+                                    break;
+                                }
+                                t += distance;
+                            }
+                        }
+            }
+
+    if (best == RAY_INFINITY)
+        return false;
+    const Vector3 center = o + d * best;
+    const Vector3 voxel_min(hit.grid_position);
+    const Vector3 normal = center - closest_point_on_box(center, voxel_min, voxel_min + Vector3(1, 1, 1));
+    hit.normal = normal.length() > 1e-6f ? normal.normalized() : (length > 0.0f ? -d : Vector3(0, 1, 0));
+    hit.distance = best * _properties.scale;
+    return true;
+}
+
+void VoxelWorldMirror::overlap_count(const Vector3 &center, float radius, uint32_t type_mask, int32_t *counts) const
+{
+    std::fill(counts, counts + OVERLAP_TYPE_COUNT, 0);
+    const float inv_scale = 1.0f / _properties.scale;
+    const Vector3 c = center * inv_scale;
+    const float r = radius * inv_scale;
+    const float r2 = r * r;
+    const bool count_air = (type_mask & 1u) != 0;
+
+    Vector3i min_voxel, max_voxel;
+    for (int a = 0; a < 3; ++a)
+    {
+        min_voxel[a] = std::clamp(int(std::floor(c[a] - r)), 0, _grid_size[a] - 1);
+        max_voxel[a] = std::clamp(int(std::floor(c[a] + r)), 0, _grid_size[a] - 1);
+    }
+    const Vector3i min_brick = min_voxel / VoxelWorldProperties::BRICK_SIZE;
+    const Vector3i max_brick = max_voxel / VoxelWorldProperties::BRICK_SIZE;
+
+    for (int bz = min_brick.z; bz <= max_brick.z; ++bz)
+        for (int by = min_brick.y; by <= max_brick.y; ++by)
+            for (int bx = min_brick.x; bx <= max_brick.x; ++bx)
+            {
+                const Vector3i brick_min = Vector3i(bx, by, bz) * VoxelWorldProperties::BRICK_SIZE;
+                const Vector3i brick_max = brick_min + Vector3i(1, 1, 1) * VoxelWorldProperties::BRICK_SIZE;
+                // empty bricks only matter when air is counted
+                const bool empty = _occupancy[_properties.getBrickIndex(brick_min)] == 0;
+                const Vector3 center_min = Vector3(brick_min) + Vector3(0.5f, 0.5f, 0.5f);
+                const Vector3 center_max = Vector3(brick_max) - Vector3(0.5f, 0.5f, 0.5f);
+                if ((empty && !count_air) || (c - closest_point_on_box(c, center_min, center_max)).length() > r)
+                    continue;
+
+                const Vector3i lo = brick_min.max(min_voxel);
+                const Vector3i hi = (brick_max - Vector3i(1, 1, 1)).min(max_voxel);
+                for (int z = lo.z; z <= hi.z; ++z)
+                    for (int y = lo.y; y <= hi.y; ++y)
+                        for (int x = lo.x; x <= hi.x; ++x)
+                        {
+                            const Vector3i voxel(x, y, z);
+                            if ((Vector3(voxel) + Vector3(0.5f, 0.5f, 0.5f) - c).length_squared() > r2)
+                                continue;
+                            const uint8_t type = empty ? 0 : _types[_properties.pos_to_voxel_index(voxel)];
+                            if (type < OVERLAP_TYPE_COUNT && (type_mask & (1u << type)) != 0)
+                                ++counts[type];
+                        }
+            }
+}
+
+PackedFloat32Array VoxelWorldMirror::sweep_sphere_batch(const PackedVector3Array &froms, const PackedVector3Array &tos,
+                                                        const PackedFloat32Array &radii) const
+{
+    static constexpr int HIT_STRIDE = 8; // matches VoxelShapeQueryPass::RESULT_STRIDE
+    PackedFloat32Array result;
+    const int64_t query_count = froms.size();
+    if (tos.size() != query_count || (radii.size() != query_count && radii.size() != 1))
+    {
+        UtilityFunctions::printerr("VoxelWorldMirror::sweep_sphere_batch() froms and tos must have the same size, "
+                                   "radii the same size or a single value");
+        return result;
+    }
+    result.resize(query_count * HIT_STRIDE);
+    float *out = result.ptrw();
+    for (int64_t i = 0; i < query_count; ++i)
+    {
+        VoxelRayHit hit;
+        float *h = out + i * HIT_STRIDE;
+        std::fill(h, h + HIT_STRIDE, 0.0f);
+        h[0] = -1.0f;
+        if (!sweep_sphere(froms[i], tos[i], radii.size() == 1 ? radii[0] : radii[i], hit))
+            continue;
+        h[0] = hit.distance;
+        h[1] = hit.normal.x;
+        h[2] = hit.normal.y;
+        h[3] = hit.normal.z;
+        h[4] = hit.grid_position.x;
+        h[5] = hit.grid_position.y;
+        h[6] = hit.grid_position.z;
+        h[7] = hit.type;
+    }
+    return result;
+}
+
+PackedInt32Array VoxelWorldMirror::overlap_count_batch(const PackedVector3Array &centers,
+                                                       const PackedFloat32Array &radii, uint32_t type_mask) const
+{
+    PackedInt32Array result;
+    const int64_t query_count = centers.size();
+    if (radii.size() != query_count && radii.size() != 1)
+    {
+        UtilityFunctions::printerr("VoxelWorldMirror::overlap_count_batch() radii must have the same size as "
+                                   "centers or a single value");
+        return result;
+    }
+    result.resize(query_count * OVERLAP_TYPE_COUNT);
+    for (int64_t i = 0; i < query_count; ++i)
+        overlap_count(centers[i], radii.size() == 1 ? radii[0] : radii[i], type_mask,
+                      result.ptrw() + i * OVERLAP_TYPE_COUNT);
+    return result;
+}
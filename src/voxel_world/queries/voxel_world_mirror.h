@@ -0,0 +1,102 @@
+#ifndef VOXEL_WORLD_MIRROR_H
+#define VOXEL_WORLD_MIRROR_H
+
+#include <godot_cpp/classes/rendering_device.hpp>
+#include <godot_cpp/variant/callable.hpp>
+#include <godot_cpp/variant/packed_float32_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_vector3_array.hpp>
+#include <godot_cpp/variant/rid.hpp>
+#include <vector>
+
+#include "voxel_heightmap.h"
+#include "voxel_world/voxel_properties.h"
+
+using namespace godot;
+
+struct VoxelRayHit
+{
+    float distance = -1.0f; // meters
+    Vector3 normal;
+    Vector3i grid_position;
+    uint8_t type = 0;
+};
+
+// CPU copy of the voxel types and brick occupancy, so gameplay queries can be answered within the same physics
+// tick without a GPU round trip. It is refreshed asynchronously: bricks touched by edits first, then a round robin
+// over the whole world, so it lags the GPU by a few frames at most. The first copy is filled the same way, in
+// ranges of SYNC_BRICKS_PER_FRAME, queries should wait for is_synced().
+class VoxelWorldMirror
+{
+  public:
+    static constexpr int BRICK_BYTES = VoxelWorldProperties::BRICK_VOLUME * sizeof(Voxel);
+    static constexpr int PACKET_SIZE = 4;
+    static constexpr int OVERLAP_TYPE_COUNT = 8; // counts per overlap query, types 0-7
+    static constexpr uint32_t SYNC_BRICKS_PER_FRAME = 2048; // 4 MB of readback per frame for the first copy
+
+    VoxelWorldMirror(RenderingDevice *rd, const VoxelWorldRIDs &voxel_world_rids,
+                     const VoxelWorldProperties &properties);
+    ~VoxelWorldMirror() {};
+
+    // true once every brick has been read back at least once
+    bool is_synced() const { return _sync_received >= _brick_count; }
+    // bricks that changed on the GPU, they are fetched before the round robin continues
+    void mark_dirty(const std::vector<uint32_t> &bricks);
+    // queues the readbacks of this frame, on_fetched is called with (data, first_brick) for every range
+    void request_updates(unsigned int frame, const Callable &on_fetched, int bricks_per_frame);
+    void on_bricks_fetched(const PackedByteArray &data, uint32_t first_brick);
+
+    uint8_t get_voxel_type(const Vector3i &grid_position) const;
+    // same as isVoxelSolid on the GPU: not air and not liquid
+    static bool is_solid_type(uint8_t type)
+    {
+        return type != Voxel::VOXEL_TYPE_AIR && type != Voxel::VOXEL_TYPE_WATER && type != Voxel::VOXEL_TYPE_LAVA;
+    }
+    bool is_brick_empty(uint32_t brick_index) const { return _occupancy[brick_index] == 0; }
+    const VoxelWorldProperties &get_properties() const { return _properties; }
+    const VoxelHeightmap &get_heightmap() const { return _heightmap; }
+
+    // Same brick-then-voxel DDA as voxelTraceWorld, empty bricks are skipped in one step. Origin in meters.
+    bool raycast(const Vector3 &origin, const Vector3 &direction, float near, float far, VoxelRayHit &hit) const;
+    // drop-in for VoxelWorld::raycast_voxels: Vector4(grid position, w >= 0 if hit)
+    Vector4 raycast_voxels(const Vector3 &origin, const Vector3 &direction, float near, float far) const;
+    // same layout as VoxelRaycastPass::raycast_batch, rays are set up in packets of PACKET_SIZE
+    PackedFloat32Array raycast_batch(const PackedVector3Array &origins, const PackedVector3Array &directions,
+                                     const PackedFloat32Array &ranges, float near = 0.0f) const;
+
+    // Moves a sphere from -> to (meters) and returns the first contact with a solid voxel, hit.distance is how
+    // far the center travelled. Bricks and voxels the swept sphere cannot reach are culled with slab tests.
+    bool sweep_sphere(const Vector3 &from, const Vector3 &to, float radius, VoxelRayHit &hit) const;
+    // voxels with their center inside the sphere, per type. Types outside type_mask stay 0.
+    void overlap_count(const Vector3 &center, float radius, uint32_t type_mask, int32_t *counts) const;
+    // same layouts as VoxelShapeQueryPass, radii holds one radius per query or a single value
+    PackedFloat32Array sweep_sphere_batch(const PackedVector3Array &froms, const PackedVector3Array &tos,
+                                          const PackedFloat32Array &radii) const;
+    PackedInt32Array overlap_count_batch(const PackedVector3Array &centers, const PackedFloat32Array &radii,
+                                         uint32_t type_mask) const;
+
+  private:
+    RenderingDevice *_rd = nullptr;
+    VoxelWorldRIDs _voxel_world_rids;
+    VoxelWorldProperties _properties;
+    Vector3i _grid_size;
+    Vector3i _brick_grid_size;
+    uint32_t _brick_count = 0;
+
+    std::vector<uint8_t> _types;      // voxel types in the layout of the GPU voxel buffer
+    std::vector<uint16_t> _occupancy; // non-air voxels per brick
+    VoxelHeightmap _heightmap;
+
+    std::vector<uint32_t> _dirty_bricks;
+    uint32_t _next_brick = 0; // round robin position
+    uint32_t _sync_next = 0;     // first brick of the first copy not requested yet
+    uint32_t _sync_received = 0; // bricks of the first copy that arrived
+
+    // update_heightmap rescans the heightmap columns of the bricks whose voxels changed
+    void store_bricks(const uint8_t *data, uint32_t first_brick, uint32_t brick_count, bool update_heightmap);
+    // traverses a ray already clipped to the world, all values in voxel units
+    bool trace(const Vector3 &origin, const Vector3 &direction, float t, float t_end, int entry_axis,
+               VoxelRayHit &hit) const;
+};
+
+#endif // VOXEL_WORLD_MIRROR_H
@@ -0,0 +1,174 @@
+#include "voxel_edit_journal.h"
+#include <algorithm>
+
+using namespace godot;
+
+VoxelEditJournal::VoxelEditJournal(RenderingDevice *rd, VoxelWorldRIDs &voxel_world_rids, RID edit_params_rid,
+                                   int memory_mb)
+    : _rd(rd)
+{
+    _capacity = std::max<uint64_t>(1, uint64_t(std::max(memory_mb, 1)) * 1024 * 1024 / SLOT_SIZE);
+    _params = {};
+    _params.capacity = _capacity;
+
+    journal_shader = new ComputeShader("res://addons/voxel_playground/src/shaders/voxel_edit/brick_journal.glsl", rd);
+    voxel_world_rids.add_voxel_buffers(journal_shader);
+
+    PackedByteArray slot_bricks, slot_voxels, slot_occupancy;
+    slot_bricks.resize(_capacity * sizeof(uint32_t));
+    slot_bricks.fill(0xFF); // INVALID_BRICK
+    slot_voxels.resize(size_t(_capacity) * VoxelWorldProperties::BRICK_VOLUME * sizeof(Voxel));
+    slot_occupancy.resize(_capacity * sizeof(uint32_t));
+
+    _params_rid = journal_shader->create_storage_buffer_uniform(_params.to_packed_byte_array(), 0, 1);
+    _slot_bricks_rid = journal_shader->create_storage_buffer_uniform(slot_bricks, 1, 1);
+    journal_shader->create_storage_buffer_uniform(slot_voxels, 2, 1);
+    journal_shader->create_storage_buffer_uniform(slot_occupancy, 3, 1);
+    journal_shader->add_existing_buffer(edit_params_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 4, 1);
+    journal_shader->finish_create_uniforms();
+}
+
+VoxelEditJournal::~VoxelEditJournal()
+{
+    // frees the slots, the edit params buffer belongs to the edit pass
+    delete journal_shader;
+}
+
+bool VoxelEditJournal::allocate(uint32_t slot_count, Entry &entry)
+{
+    // a new edit invalidates everything that could be redone
+    for (int i = _cursor; i < int(_entries.size()); ++i)
+        _used_slots -= _entries[i].slot_count;
+    _entries.erase(_entries.begin() + _cursor, _entries.end());
+
+    if (slot_count == 0)
+        return false;
+    if (slot_count > _capacity)
+    {
+        UtilityFunctions::printerr("VoxelEditJournal: edit touches ", slot_count, " bricks but the history holds ",
+                                   _capacity, ", increase the undo memory. History cleared.");
+        clear();
+        return false;
+    }
+
+    entry.id = _next_entry_id++;
+    entry.first_slot = _entries.empty() ? 0 : (_entries.back().first_slot + _entries.back().slot_count) % _capacity;
+    entry.slot_count = slot_count;
+    while (_used_slots + slot_count > _capacity)
+    {
+        _used_slots -= _entries.front().slot_count;
+        _entries.pop_front();
+        --_cursor;
+    }
+
+    _entries.push_back(entry);
+    _used_slots += slot_count;
+    _cursor = _entries.size();
+    return true;
+}
+
+void VoxelEditJournal::dispatch(Mode mode, const Entry &entry)
+{
+    if (journal_shader == nullptr || !journal_shader->check_ready())
+    {
+        UtilityFunctions::printerr("VoxelEditJournal::dispatch() journal shader is null or not ready");
+        return;
+    }
+
+    _params.mode = mode;
+    if (mode == MODE_GATHER_RAYCAST)
+    {
+        _params.first_slot = entry.first_slot;
+        _params.slot_count = entry.slot_count;
+        PackedByteArray params_data = _params.to_packed_byte_array();
+        _rd->buffer_update(_params_rid, 0, params_data.size(), params_data);
+        const uint32_t group_size = VoxelWorldProperties::BRICK_VOLUME;
+        journal_shader->compute(Vector3i((entry.slot_count + group_size - 1) / group_size, 1, 1), false);
+        return;
+    }
+
+    // one workgroup per slot, split to stay within the dispatch limits
+    static const uint32_t MAX_GROUPS = 65535;
+    for (uint32_t offset = 0; offset < entry.slot_count; offset += MAX_GROUPS)
+    {
+        _params.first_slot = (entry.first_slot + offset) % _capacity;
+        _params.slot_count = std::min(MAX_GROUPS, entry.slot_count - offset);
+        PackedByteArray params_data = _params.to_packed_byte_array();
+        _rd->buffer_update(_params_rid, 0, params_data.size(), params_data);
+        journal_shader->compute(Vector3i(_params.slot_count, 1, 1), false);
+    }
+}
+
+void VoxelEditJournal::record_bricks(const std::vector<uint32_t> &bricks)
+{
+    Entry entry;
+    if (!allocate(bricks.size(), entry))
+        return;
+    _entries.back().bricks = bricks;
+
+    // write the brick list into the ring, in at most two pieces when it wraps
+    const uint32_t first_part = std::min(entry.slot_count, _capacity - entry.first_slot);
+    PackedByteArray brick_data;
+    brick_data.resize(bricks.size() * sizeof(uint32_t));
+    std::memcpy(brick_data.ptrw(), bricks.data(), brick_data.size());
+    _rd->buffer_update(_slot_bricks_rid, entry.first_slot * sizeof(uint32_t), first_part * sizeof(uint32_t),
+                       brick_data.slice(0, first_part * sizeof(uint32_t)));
+    if (first_part < entry.slot_count)
+        _rd->buffer_update(_slot_bricks_rid, 0, (entry.slot_count - first_part) * sizeof(uint32_t),
+                           brick_data.slice(first_part * sizeof(uint32_t)));
+
+    dispatch(MODE_SAVE, entry);
+}
+
+int64_t VoxelEditJournal::record_raycast(float radius, int groups_per_axis)
+{
+    // the edit covers groups_per_axis * 8 voxels per axis from an arbitrary offset, so one more brick
+    const int bricks_per_axis = std::max(groups_per_axis, 0) + 1;
+    Entry entry;
+    if (!allocate(bricks_per_axis * bricks_per_axis * bricks_per_axis, entry))
+        return -1;
+
+    _params.gather_size = Vector4i(bricks_per_axis, bricks_per_axis, bricks_per_axis, 0);
+    _params.gather_radius = radius;
+    dispatch(MODE_GATHER_RAYCAST, entry);
+    dispatch(MODE_SAVE, entry);
+    return int64_t(entry.id);
+}
+
+void VoxelEditJournal::set_entry_bricks(int64_t id, const std::vector<uint32_t> &bricks)
+{
+    // the entry may have been dropped from the ring in the meantime
+    for (Entry &entry : _entries)
+        if (int64_t(entry.id) == id)
+        {
+            entry.bricks = bricks;
+            return;
+        }
+}
+
+bool VoxelEditJournal::undo(std::vector<uint32_t> &touched_bricks)
+{
+    if (_cursor == 0)
+        return false;
+    --_cursor;
+    dispatch(MODE_SWAP, _entries[_cursor]);
+    touched_bricks.insert(touched_bricks.end(), _entries[_cursor].bricks.begin(), _entries[_cursor].bricks.end());
+    return true;
+}
+
+bool VoxelEditJournal::redo(std::vector<uint32_t> &touched_bricks)
+{
+    if (_cursor >= int(_entries.size()))
+        return false;
+    dispatch(MODE_SWAP, _entries[_cursor]);
+    touched_bricks.insert(touched_bricks.end(), _entries[_cursor].bricks.begin(), _entries[_cursor].bricks.end());
+    ++_cursor;
+    return true;
+}
+
+void VoxelEditJournal::clear()
+{
+    _entries.clear();
+    _used_slots = 0;
+    _cursor = 0;
+}
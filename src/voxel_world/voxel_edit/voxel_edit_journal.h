@@ -0,0 +1,99 @@
+#ifndef VOXEL_EDIT_JOURNAL_H
+#define VOXEL_EDIT_JOURNAL_H
+
+#include <godot_cpp/classes/rendering_device.hpp>
+#include <godot_cpp/variant/rid.hpp>
+#include <deque>
+#include <vector>
+
+#include "gdcs/include/gdcs.h"
+#include "voxel_world/voxel_properties.h"
+
+using namespace godot;
+
+// Undo/redo history of voxel edits. Before an edit runs, the bricks it touches are copied on the GPU into a ring
+// of history slots. Undo swaps an entry's slots with the world, which leaves the edited state in the slots for
+// redo to swap back. Both cost a copy of the edited bricks only. When the ring is full the oldest entries are dropped.
+class VoxelEditJournal
+{
+    struct JournalParams // match the struct on the gpu
+    {
+        unsigned int mode;
+        unsigned int first_slot;
+        unsigned int slot_count;
+        unsigned int capacity;
+        Vector4i gather_size;
+        float gather_radius;
+        float _pad0;
+        float _pad1;
+        float _pad2;
+
+        PackedByteArray to_packed_byte_array()
+        {
+            PackedByteArray byte_array;
+            byte_array.resize(sizeof(JournalParams));
+            std::memcpy(byte_array.ptrw(), this, sizeof(JournalParams));
+            return byte_array;
+        }
+    };
+
+    struct Entry
+    {
+        uint64_t id;
+        uint32_t first_slot;
+        uint32_t slot_count;
+        std::vector<uint32_t> bricks; // world bricks of the slots, reported as dirty by undo and redo
+    };
+
+    enum Mode
+    {
+        MODE_GATHER_RAYCAST = 0,
+        MODE_SAVE = 1,
+        MODE_SWAP = 2,
+    };
+
+  public:
+    static constexpr uint32_t INVALID_BRICK = 0xFFFFFFFFu;
+    // bytes per history slot: the brick voxels and its occupancy
+    static constexpr int SLOT_SIZE = VoxelWorldProperties::BRICK_VOLUME * sizeof(Voxel) + 2 * sizeof(uint32_t);
+
+    // edit_params_rid is the raycast edit params buffer, the journal reads the hit position from it
+    VoxelEditJournal(RenderingDevice *rd, VoxelWorldRIDs &voxel_world_rids, RID edit_params_rid, int memory_mb);
+    ~VoxelEditJournal();
+
+    // saves the given bricks as one entry, call before dispatching the edit that changes them
+    void record_bricks(const std::vector<uint32_t> &bricks);
+    // saves the bricks around the hit of a raycast edit, groups_per_axis is the size of the edit dispatch.
+    // Returns the id of the entry, or -1. The bricks are only known on the GPU, set_entry_bricks() fills them in
+    // once the hit has been read back.
+    int64_t record_raycast(float radius, int groups_per_axis);
+    void set_entry_bricks(int64_t id, const std::vector<uint32_t> &bricks);
+
+    // append the bricks they changed to touched_bricks, false if there is nothing to undo/redo
+    bool undo(std::vector<uint32_t> &touched_bricks);
+    bool redo(std::vector<uint32_t> &touched_bricks);
+    void clear();
+
+    int get_undo_count() const { return _cursor; }
+    int get_redo_count() const { return int(_entries.size()) - _cursor; }
+    uint32_t get_capacity() const { return _capacity; }
+
+  private:
+    RenderingDevice *_rd = nullptr;
+    ComputeShader *journal_shader = nullptr;
+    uint32_t _capacity = 0;
+    uint32_t _used_slots = 0;
+    uint64_t _next_entry_id = 0;
+
+    std::deque<Entry> _entries;
+    int _cursor = 0; // entries before the cursor can be undone, the rest redone
+
+    JournalParams _params;
+    RID _params_rid;
+    RID _slot_bricks_rid;
+
+    bool allocate(uint32_t slot_count, Entry &entry);
+    void dispatch(Mode mode, const Entry &entry);
+};
+
+#endif // VOXEL_EDIT_JOURNAL_H
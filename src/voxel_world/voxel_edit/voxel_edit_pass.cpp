@@ -2,11 +2,14 @@
 
 #include "voxel_edit_pass.h"
 #include <godot_cpp/core/print_string.hpp>  // For print_line()
+#include <algorithm>
 
 using namespace godot;
 
 
-VoxelEditPass::VoxelEditPass(String shader_path, RenderingDevice * rd, VoxelWorldRIDs& voxel_world_rids, const Vector3i size) : _size(size){
+VoxelEditPass::VoxelEditPass(String shader_path, RenderingDevice * rd, VoxelWorldRIDs& voxel_world_rids, const VoxelParticleRIDs &particle_rids, const Vector3i size) : _rd(rd), _size(size){
+
+    _brick_grid_size = size / VoxelWorldProperties::BRICK_SIZE;
 
     _edit_params = {
         Vector4(1, 1, 1, 1), // camera_origin
@@ -27,9 +30,32 @@ VoxelEditPass::VoxelEditPass(String shader_path, RenderingDevice * rd, VoxelWorl
     voxel_world_rids.add_voxel_buffers(edit_shader);
     edit_shader->add_existing_buffer(_edit_params_rid, RenderingDevice::UNIFORM_TYPE_STORAGE_BUFFER, 0, 1);
     edit_shader->finish_create_uniforms();
+
+    // edit queue, buffers are allocated at full capacity and partially updated on flush
+    edit_queue_shader = new ComputeShader("res://addons/voxel_playground/src/shaders/voxel_edit/edit_queue.glsl", rd);
+    voxel_world_rids.add_voxel_buffers(edit_queue_shader);
+    PackedByteArray edit_commands, edit_jobs, edit_refs, stamp_voxels;
+    edit_commands.resize(MAX_QUEUED_EDITS * sizeof(VoxelEditCommand));
+    edit_jobs.resize(MAX_EDIT_JOBS * 4 * sizeof(uint32_t));
+    edit_refs.resize(MAX_EDIT_REFS * sizeof(uint32_t));
+    stamp_voxels.resize(MAX_STAMP_VOXELS * sizeof(uint32_t));
+    _edit_commands_rid = edit_queue_shader->create_storage_buffer_uniform(edit_commands, 0, 1);
+    _edit_jobs_rid = edit_queue_shader->create_storage_buffer_uniform(edit_jobs, 1, 1);
+    _edit_refs_rid = edit_queue_shader->create_storage_buffer_uniform(edit_refs, 2, 1);
+    _stamp_voxels_rid = edit_queue_shader->create_storage_buffer_uniform(stamp_voxels, 3, 1);
+    particle_rids.add_particle_buffers(edit_queue_shader, 4);
+    edit_queue_shader->finish_create_uniforms();
+}
+
+VoxelEditPass::~VoxelEditPass()
+{
+    // the raycast shader owns the params buffer the other two borrow, so it goes last
+    delete edit_queue_shader;
+    delete edit_shader;
+    delete ray_cast_shader;
 }
 
-void VoxelEditPass::edit_using_raycast(const Vector3 &camera_origin, const Vector3 &camera_direction, const float radius, const float range, const int value)
+void VoxelEditPass::edit_using_raycast(const Vector3 &camera_origin, const Vector3 &camera_direction, const float radius, const float range, const int value, const Callable &on_hit)
 {
     if (ray_cast_shader == nullptr || !ray_cast_shader->check_ready() || edit_shader == nullptr || !edit_shader->check_ready()) 
     {
@@ -37,6 +63,9 @@ void VoxelEditPass::edit_using_raycast(const Vector3 &camera_origin, const Vecto
         return;
     }
 
+    // edits queued before this one are applied first, so all edits keep their submission order
+    flush();
+
     _edit_params.camera_origin = Vector4(camera_origin.x, camera_origin.y, camera_origin.z, 1.0f);
     _edit_params.camera_direction = Vector4(camera_direction.x, camera_direction.y, camera_direction.z, 0.0f).normalized();
     _edit_params.hit_position = Vector4(0, 0, 0, -1);
@@ -45,44 +74,226 @@ void VoxelEditPass::edit_using_raycast(const Vector3 &camera_origin, const Vecto
     _edit_params.radius = radius;
     _edit_params.value = value;
 
-    //raycast
+    // raycast, the edit kernel picks the hit position up from the shared params buffer, so both dispatches
+    // go out back to back without waiting for the GPU
     ray_cast_shader->update_storage_buffer_uniform(_edit_params_rid, _edit_params.to_packed_byte_array());
     ray_cast_shader->compute(Vector3i(1,1,1), false); 
 
-    PackedByteArray arr =  ray_cast_shader->get_storage_buffer_uniform(_edit_params_rid);
-    VoxelEditParams *params = reinterpret_cast<VoxelEditParams *>(arr.ptrw());
-    // UtilityFunctions::print(params->hit_position);
-
     //edit at found position
     const Vector3 group_size = Vector3(8, 8, 8);
     const Vector3i group_count = Vector3i(std::ceil(2.0f * radius / group_size.x), std::ceil(2.0f * radius / group_size.y), std::ceil(2.0f * radius / group_size.z));
+    const int64_t journal_entry = _journal != nullptr ? _journal->record_raycast(radius, group_count.x) : -1;
     edit_shader->compute(group_count, false);
+
+    // the caller gets the raw params once the GPU is done with them
+    if (on_hit.is_valid())
+        ray_cast_shader->get_storage_buffer_uniform_async(_edit_params_rid, on_hit.bind(journal_entry));
+}
+
+Vector4 VoxelEditPass::get_hit_position(const PackedByteArray &params_data)
+{
+    if (params_data.size() < int64_t(sizeof(VoxelEditParams)))
+        return Vector4(0, 0, 0, -1);
+    VoxelEditParams params;
+    std::memcpy(&params, params_data.ptr(), sizeof(VoxelEditParams));
+    return params.hit_position;
+}
+
+std::vector<uint32_t> VoxelEditPass::get_hit_bricks(const PackedByteArray &params_data) const
+{
+    std::vector<uint32_t> bricks;
+    if (params_data.size() < int64_t(sizeof(VoxelEditParams)))
+        return bricks;
+    VoxelEditParams params;
+    std::memcpy(&params, params_data.ptr(), sizeof(VoxelEditParams));
+    if (params.hit_position.w < 0.0f)
+        return bricks;
+
+    // sphere_edit.glsl changes the voxels closer than radius to the hit
+    const Vector3 hit(params.hit_position.x, params.hit_position.y, params.hit_position.z);
+    const Vector3 extent(params.radius, params.radius, params.radius);
+    const Vector3i last_brick = _brick_grid_size - Vector3i(1, 1, 1);
+    const Vector3i from =
+        Vector3i(((hit - extent) / VoxelWorldProperties::BRICK_SIZE).floor()).clamp(Vector3i(0, 0, 0), last_brick);
+    const Vector3i to =
+        Vector3i(((hit + extent) / VoxelWorldProperties::BRICK_SIZE).floor()).clamp(Vector3i(0, 0, 0), last_brick);
+    for (int z = from.z; z <= to.z; ++z)
+        for (int y = from.y; y <= to.y; ++y)
+            for (int x = from.x; x <= to.x; ++x)
+                bricks.push_back(x + y * _brick_grid_size.x + z * _brick_grid_size.x * _brick_grid_size.y);
+    return bricks;
+}
+
+void VoxelEditPass::queue_edit(const VoxelEditCommand &edit)
+{
+    if (_queued_edits.size() >= size_t(MAX_QUEUED_EDITS))
+        flush();
+    _queued_edits.push_back(edit);
+}
+
+void VoxelEditPass::queue_sphere(const Vector3 &center, const float radius, const int value, const float eject_speed)
+{
+    queue_shape(EDIT_SHAPE_SPHERE, Vector4(center.x, center.y, center.z, radius), Vector4(), value, 0.0f, eject_speed);
 }
 
-void VoxelEditPass::edit_at(const Vector3 &position, const float radius, const int value)
+void VoxelEditPass::queue_box(const Vector3 &center, const Vector3 &half_extents, const int value)
 {
-    if (edit_shader == nullptr || !edit_shader->check_ready())
+    queue_shape(EDIT_SHAPE_BOX, Vector4(center.x, center.y, center.z, 0.0f),
+                Vector4(half_extents.x, half_extents.y, half_extents.z, 0.0f), value);
+}
+
+void VoxelEditPass::queue_shape(VoxelEditShape shape, const Vector4 &a, const Vector4 &b, const int value,
+                                const float smoothness, const float eject_speed)
+{
+    VoxelEditCommand edit = {};
+    edit.a = a;
+    edit.b = b;
+    edit.shape = shape;
+    edit.value = value;
+    edit.smoothness = smoothness;
+    edit.eject_speed = eject_speed;
+    queue_edit(edit);
+}
+
+void VoxelEditPass::queue_stamp(const Vector3i &min_corner, const Vector3i &size, const std::vector<Voxel> &voxels)
+{
+    const size_t count = size_t(size.x) * size.y * size.z;
+    if (count == 0 || voxels.size() != count || count > size_t(MAX_STAMP_VOXELS))
     {
-        UtilityFunctions::printerr("VoxelEditPass::edit_at() edit shader is null or not ready");
+        UtilityFunctions::printerr("VoxelEditPass::queue_stamp() stamp is empty, malformed or larger than ",
+                                   MAX_STAMP_VOXELS, " voxels");
         return;
     }
+    if (_queued_stamp_voxels.size() + count > size_t(MAX_STAMP_VOXELS))
+        flush();
 
-    _edit_params.camera_origin = Vector4(0,0,0,1);
-    _edit_params.camera_direction = Vector4(0,0,-1,0);
-    _edit_params.hit_position = Vector4(position.x, position.y, position.z, 1.0f);
-    _edit_params.near = 0.0f;
-    _edit_params.far = 0.0f;
-    _edit_params.radius = radius;
-    _edit_params.value = value;
+    VoxelEditCommand edit = {};
+    edit.a = Vector4(min_corner.x, min_corner.y, min_corner.z, 0.0f);
+    edit.b = Vector4(size.x, size.y, size.z, 0.0f);
+    edit.shape = EDIT_SHAPE_STAMP;
+    edit.stamp_offset = _queued_stamp_voxels.size();
+    for (const Voxel &voxel : voxels)
+        _queued_stamp_voxels.push_back(static_cast<uint32_t>(voxel.data));
+    queue_edit(edit);
+}
 
-    // Update edit params and dispatch edit compute directly
-    edit_shader->update_storage_buffer_uniform(_edit_params_rid, _edit_params.to_packed_byte_array());
+void VoxelEditPass::flush()
+{
+    if (_queued_edits.empty())
+        return;
+    if (edit_queue_shader == nullptr || !edit_queue_shader->check_ready())
+    {
+        UtilityFunctions::printerr("VoxelEditPass::flush() edit queue shader is null or not ready");
+        _queued_edits.clear();
+        _queued_stamp_voxels.clear();
+        return;
+    }
 
-    const Vector3 group_size = Vector3(8, 8, 8);
-    const Vector3i group_count = Vector3i(std::ceil(2.0f * radius / group_size.x),
-                                          std::ceil(2.0f * radius / group_size.y),
-                                          std::ceil(2.0f * radius / group_size.z));
-    edit_shader->compute(group_count, false);
+    // expand every edit into the bricks it overlaps, the stable sort keeps the submission order within a brick.
+    // The sdf at the brick centre tells whether the shape misses the brick or contains all of it: no voxel of a
+    // brick is further than BRICK_RADIUS from its centre.
+    static const float BRICK_RADIUS = 3.5f * std::sqrt(3.0f) + 0.01f;
+    std::vector<std::pair<uint32_t, uint32_t>> brick_edits;
+    const Vector3i last_brick = _brick_grid_size - Vector3i(1, 1, 1);
+    for (uint32_t e = 0; e < _queued_edits.size(); ++e)
+    {
+        const VoxelEditCommand &edit = _queued_edits[e];
+        Vector3 min_voxel, max_voxel;
+        VoxelEditShapes::get_edit_bounds(edit, min_voxel, max_voxel);
+
+        const Vector3i min_brick = Vector3i((min_voxel / VoxelWorldProperties::BRICK_SIZE).floor());
+        const Vector3i max_brick = Vector3i((max_voxel / VoxelWorldProperties::BRICK_SIZE).floor());
+        if (max_brick.x < 0 || max_brick.y < 0 || max_brick.z < 0 || min_brick.x > last_brick.x ||
+            min_brick.y > last_brick.y || min_brick.z > last_brick.z)
+            continue;
+        const Vector3i from = min_brick.clamp(Vector3i(0, 0, 0), last_brick);
+        const Vector3i to = max_brick.clamp(Vector3i(0, 0, 0), last_brick);
+
+        for (int z = from.z; z <= to.z; ++z)
+            for (int y = from.y; y <= to.y; ++y)
+                for (int x = from.x; x <= to.x; ++x)
+                {
+                    uint32_t ref = e;
+                    if (edit.shape != EDIT_SHAPE_STAMP)
+                    {
+                        const Vector3 brick_center = Vector3(x, y, z) * VoxelWorldProperties::BRICK_SIZE +
+                                                     Vector3(3.5f, 3.5f, 3.5f);
+                        const float distance = VoxelEditShapes::sd_edit(edit, brick_center);
+                        if (distance >= BRICK_RADIUS)
+                            continue;
+                        if (distance < -BRICK_RADIUS)
+                            ref |= EDIT_COVERS_BRICK;
+                    }
+                    const uint32_t brick_index =
+                        x + y * _brick_grid_size.x + z * _brick_grid_size.x * _brick_grid_size.y;
+                    brick_edits.emplace_back(brick_index, ref);
+                }
+    }
+    std::stable_sort(brick_edits.begin(), brick_edits.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    PackedByteArray edit_data;
+    edit_data.resize(_queued_edits.size() * sizeof(VoxelEditCommand));
+    std::memcpy(edit_data.ptrw(), _queued_edits.data(), edit_data.size());
+    _rd->buffer_update(_edit_commands_rid, 0, edit_data.size(), edit_data);
+
+    if (!_queued_stamp_voxels.empty())
+    {
+        PackedByteArray stamp_data;
+        stamp_data.resize(_queued_stamp_voxels.size() * sizeof(uint32_t));
+        std::memcpy(stamp_data.ptrw(), _queued_stamp_voxels.data(), stamp_data.size());
+        _rd->buffer_update(_stamp_voxels_rid, 0, stamp_data.size(), stamp_data);
+    }
+
+    std::vector<uint32_t> bricks;
+    for (const auto &brick_edit : brick_edits)
+        if (bricks.empty() || bricks.back() != brick_edit.first)
+            bricks.push_back(brick_edit.first);
+    _edited_bricks.insert(_edited_bricks.end(), bricks.begin(), bricks.end());
+    // all edits of a flush form one undo step
+    if (_journal != nullptr)
+        _journal->record_bricks(bricks);
+
+    // one job per brick: (brick index, first ref, ref count, 0)
+    std::vector<uint32_t> jobs;
+    std::vector<uint32_t> refs;
+    for (size_t i = 0; i < brick_edits.size();)
+    {
+        size_t end = i;
+        while (end < brick_edits.size() && brick_edits[end].first == brick_edits[i].first)
+            ++end;
+        if (jobs.size() / 4 == size_t(MAX_EDIT_JOBS) || refs.size() + (end - i) > size_t(MAX_EDIT_REFS))
+        {
+            dispatch_jobs(jobs, refs);
+            jobs.clear();
+            refs.clear();
+        }
+        jobs.insert(jobs.end(), {brick_edits[i].first, uint32_t(refs.size()), uint32_t(end - i), 0u});
+        for (; i < end; ++i)
+            refs.push_back(brick_edits[i].second);
+    }
+    dispatch_jobs(jobs, refs);
+
+    _queued_edits.clear();
+    _queued_stamp_voxels.clear();
+}
+
+void VoxelEditPass::dispatch_jobs(const std::vector<uint32_t> &jobs, const std::vector<uint32_t> &refs)
+{
+    if (jobs.empty())
+        return;
+
+    PackedByteArray job_data;
+    job_data.resize(jobs.size() * sizeof(uint32_t));
+    std::memcpy(job_data.ptrw(), jobs.data(), job_data.size());
+    _rd->buffer_update(_edit_jobs_rid, 0, job_data.size(), job_data);
+
+    PackedByteArray ref_data;
+    ref_data.resize(refs.size() * sizeof(uint32_t));
+    std::memcpy(ref_data.ptrw(), refs.data(), ref_data.size());
+    _rd->buffer_update(_edit_refs_rid, 0, ref_data.size(), ref_data);
+
+    edit_queue_shader->compute(Vector3i(jobs.size() / 4, 1, 1), false);
 }
 
 Vector4 VoxelEditPass::raycast_voxels(const Vector3 &origin, const Vector3 &direction, float near, float far)
@@ -6,9 +6,13 @@
 #include <godot_cpp/classes/rendering_device.hpp>
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/variant/rid.hpp>
+#include <vector>
 
 #include "gdcs/include/gdcs.h"
 #include "voxel_world/voxel_properties.h"
+#include "voxel_world/particles/voxel_particle_system.h"
+#include "voxel_world/voxel_edit/voxel_edit_shapes.h"
+#include "voxel_world/voxel_edit/voxel_edit_journal.h"
 
 using namespace godot;
 
@@ -34,12 +38,54 @@ class VoxelEditPass
     };
 
   public:
-    VoxelEditPass(String edit_shader_path, RenderingDevice *rd, VoxelWorldRIDs &voxel_world_rids, const Vector3i size);
-    ~VoxelEditPass() {};
+    // capacities of the queue buffers, a full queue is flushed early and a large flush is split into several
+    // dispatches (bricks are independent, so this keeps the per-brick submission order)
+    static constexpr int MAX_QUEUED_EDITS = 256;
+    static constexpr int MAX_EDIT_JOBS = 8192;
+    static constexpr int MAX_EDIT_REFS = 16384;
+    static constexpr int MAX_STAMP_VOXELS = 1 << 18;
+    // set on an edit reference when the edit contains the whole brick (matches edit_queue.glsl)
+    static constexpr uint32_t EDIT_COVERS_BRICK = 0x80000000u;
 
+    VoxelEditPass(String edit_shader_path, RenderingDevice *rd, VoxelWorldRIDs &voxel_world_rids,
+                  const VoxelParticleRIDs &particle_rids, const Vector3i size);
+    ~VoxelEditPass();
+
+    // Runs right away, after flushing the queued edits so the submission order holds across both kinds.
+    // on_hit, if valid, is called asynchronously with the params buffer and the id of the journal entry of the edit
+    // (-1 without one), decode it with get_hit_position() and get_hit_bricks()
     void edit_using_raycast(const Vector3 &camera_origin, const Vector3 &camera_direction, const float radius,
-                            const float range, const int value);
-    void edit_at(const Vector3 &position, const float radius, const int value);
+                            const float range, const int value, const Callable &on_hit = Callable());
+    // hit position of a raycast edit as Vector4(x,y,z,w) in voxels, w>=0 if hit, <0 if no hit
+    static Vector4 get_hit_position(const PackedByteArray &params_data);
+    // bricks a raycast edit changed, from the same params buffer
+    std::vector<uint32_t> get_hit_bricks(const PackedByteArray &params_data) const;
+    // Queued edits are applied together by flush(), in submission order. Positions and sizes are in voxels.
+    // eject_speed (voxels / s) > 0 throws part of the removed voxels out as debris particles
+    void queue_sphere(const Vector3 &center, const float radius, const int value, const float eject_speed = 0.0f);
+    void queue_box(const Vector3 &center, const Vector3 &half_extents, const int value);
+    // any sdf primitive, see VoxelEditCommand for the meaning of a and b
+    void queue_shape(VoxelEditShape shape, const Vector4 &a, const Vector4 &b, const int value,
+                     const float smoothness = 0.0f, const float eject_speed = 0.0f);
+    // non-air stamp voxels overwrite the world, min_corner is the position of stamp voxel (0, 0, 0)
+    void queue_stamp(const Vector3i &min_corner, const Vector3i &size, const std::vector<Voxel> &voxels);
+    // uploads the queue and applies it with one dispatch, call once per frame
+    void flush();
+    bool has_queued_edits() const { return !_queued_edits.empty(); }
+
+    // when set, every edit records the bricks it touches for undo
+    void set_journal(VoxelEditJournal *journal) { _journal = journal; }
+    VoxelEditJournal *get_journal() const { return _journal; }
+    RID get_edit_params_rid() const { return _edit_params_rid; }
+
+    // bricks changed by queued edits since the last call (raycast edits are resolved on the GPU, their bricks come
+    // with the hit readback, see get_hit_bricks())
+    std::vector<uint32_t> take_edited_bricks()
+    {
+        std::vector<uint32_t> bricks;
+        bricks.swap(_edited_bricks);
+        return bricks;
+    }
 
     // Perform voxel raycast and return hit position as Vector4(x,y,z,w), w>=0 if hit, <0 if no hit
     Vector4 raycast_voxels(const Vector3 &origin, const Vector3 &direction, float near, float far);
@@ -47,10 +93,25 @@ class VoxelEditPass
   private:
     ComputeShader *ray_cast_shader = nullptr;
     ComputeShader *edit_shader = nullptr;
+    ComputeShader *edit_queue_shader = nullptr;
+    RenderingDevice *_rd = nullptr;
     Vector3i _size;
+    Vector3i _brick_grid_size;
 
     VoxelEditParams _edit_params;
     RID _edit_params_rid;
+
+    std::vector<VoxelEditCommand> _queued_edits;
+    std::vector<uint32_t> _queued_stamp_voxels;
+    RID _edit_commands_rid;
+    RID _edit_jobs_rid;
+    RID _edit_refs_rid;
+    RID _stamp_voxels_rid;
+    VoxelEditJournal *_journal = nullptr;
+    std::vector<uint32_t> _edited_bricks;
+
+    void queue_edit(const VoxelEditCommand &edit);
+    void dispatch_jobs(const std::vector<uint32_t> &jobs, const std::vector<uint32_t> &refs);
 };
 
 #endif // VOXEL_WORLD_EDIT_PASS_H
@@ -0,0 +1,197 @@
+#ifndef VOXEL_EDIT_SHAPES_H
+#define VOXEL_EDIT_SHAPES_H
+
+#include <godot_cpp/variant/vector2.hpp>
+#include <godot_cpp/variant/vector3.hpp>
+#include <godot_cpp/variant/vector4.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace godot;
+
+// CPU mirror of shaders/voxel_edit/edit_shapes.glsl, used to cull and classify bricks before dispatching edits.
+
+enum VoxelEditShape
+{
+    EDIT_SHAPE_SPHERE = 0,
+    EDIT_SHAPE_BOX = 1,
+    EDIT_SHAPE_STAMP = 2,
+    EDIT_SHAPE_CAPSULE = 3,
+    EDIT_SHAPE_CYLINDER = 4,
+    EDIT_SHAPE_CONE = 5,
+    EDIT_SHAPE_SMOOTH_UNION = 6,    // two spheres blended together
+    EDIT_SHAPE_SMOOTH_SUBTRACT = 7, // sphere a with sphere b carved out, blended
+};
+
+struct VoxelEditCommand // match the struct on the gpu
+{
+    Vector4 a; // centre / segment start / stamp min corner. w: radius
+    Vector4 b; // box half extents / segment end / stamp size / second sphere. w: second radius
+    unsigned int shape;
+    unsigned int value;
+    float eject_speed;
+    unsigned int stamp_offset;
+    float smoothness;
+    float _pad0;
+    float _pad1;
+    float _pad2;
+
+    Vector3 get_a() const { return Vector3(a.x, a.y, a.z); }
+    Vector3 get_b() const { return Vector3(b.x, b.y, b.z); }
+};
+
+namespace VoxelEditShapes
+{
+
+inline float sd_sphere(const Vector3 &p, const Vector3 &center, float radius)
+{
+    return (p - center).length() - radius;
+}
+
+inline float sd_box(const Vector3 &p, const Vector3 &center, const Vector3 &half_extents)
+{
+    Vector3 q = (p - center).abs() - half_extents;
+    return q.max(Vector3(0, 0, 0)).length() + std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+}
+
+inline float sd_capsule(const Vector3 &p, const Vector3 &a, const Vector3 &b, float radius)
+{
+    Vector3 pa = p - a;
+    Vector3 ba = b - a;
+    float h = std::clamp(pa.dot(ba) / std::max(ba.dot(ba), 1e-6f), 0.0f, 1.0f);
+    return (pa - ba * h).length() - radius;
+}
+
+// one voxel thick disc in the xz plane, what cylinders and cones with a zero-length axis become
+inline float sd_disc(const Vector3 &p, const Vector3 &center, float radius)
+{
+    const float dx = Vector2(p.x - center.x, p.z - center.z).length() - radius;
+    const float dy = std::abs(p.y - center.y) - 0.5f;
+    return std::min(std::max(dx, dy), 0.0f) + Vector2(std::max(dx, 0.0f), std::max(dy, 0.0f)).length();
+}
+
+inline float sd_cylinder(const Vector3 &p, const Vector3 &a, const Vector3 &b, float radius)
+{
+    Vector3 ba = b - a;
+    Vector3 pa = p - a;
+    float baba = ba.dot(ba);
+    if (baba < 1e-6f)
+        return sd_disc(p, a, radius);
+    float paba = pa.dot(ba);
+    float x = (pa * baba - ba * paba).length() - radius * baba;
+    float y = std::abs(paba - baba * 0.5f) - baba * 0.5f;
+    float x2 = x * x;
+    float y2 = y * y * baba;
+    float d = (std::max(x, y) < 0.0f) ? -std::min(x2, y2) : ((x > 0.0f ? x2 : 0.0f) + (y > 0.0f ? y2 : 0.0f));
+    return std::copysign(std::sqrt(std::abs(d)), d) / baba;
+}
+
+inline float sd_cone(const Vector3 &p, const Vector3 &a, const Vector3 &b, float ra, float rb)
+{
+    float rba = rb - ra;
+    float baba = (b - a).dot(b - a);
+    if (baba < 1e-6f)
+        return sd_disc(p, a, std::max(ra, rb));
+    float papa = (p - a).dot(p - a);
+    float paba = (p - a).dot(b - a) / baba;
+    float x = std::sqrt(std::max(papa - paba * paba * baba, 0.0f));
+    float cax = std::max(0.0f, x - (paba < 0.5f ? ra : rb));
+    float cay = std::abs(paba - 0.5f) - 0.5f;
+    float k = rba * rba + baba;
+    float f = std::clamp((rba * (x - ra) + paba * baba) / k, 0.0f, 1.0f);
+    float cbx = x - ra - f * rba;
+    float cby = paba - f;
+    float s = (cbx < 0.0f && cay < 0.0f) ? -1.0f : 1.0f;
+    return s * std::sqrt(std::min(cax * cax + cay * cay * baba, cbx * cbx + cby * cby * baba));
+}
+
+inline float smooth_min(float d1, float d2, float k)
+{
+    if (k <= 0.0f)
+        return std::min(d1, d2);
+    float h = std::max(k - std::abs(d1 - d2), 0.0f) / k;
+    return std::min(d1, d2) - h * h * k * 0.25f;
+}
+
+inline float smooth_max(float d1, float d2, float k)
+{
+    return -smooth_min(-d1, -d2, k);
+}
+
+// stamps are not an sdf, they only report their bounding box
+inline float sd_edit(const VoxelEditCommand &edit, const Vector3 &p)
+{
+    switch (edit.shape)
+    {
+    case EDIT_SHAPE_SPHERE:
+        return sd_sphere(p, edit.get_a(), edit.a.w);
+    case EDIT_SHAPE_BOX:
+        return sd_box(p, edit.get_a(), edit.get_b());
+    case EDIT_SHAPE_STAMP:
+        return sd_box(p, edit.get_a() + 0.5f * (edit.get_b() - Vector3(1, 1, 1)), 0.5f * edit.get_b());
+    case EDIT_SHAPE_CAPSULE:
+        return sd_capsule(p, edit.get_a(), edit.get_b(), edit.a.w);
+    case EDIT_SHAPE_CYLINDER:
+        return sd_cylinder(p, edit.get_a(), edit.get_b(), edit.a.w);
+    case EDIT_SHAPE_CONE:
+        return sd_cone(p, edit.get_a(), edit.get_b(), edit.a.w, edit.b.w);
+    case EDIT_SHAPE_SMOOTH_UNION:
+        return smooth_min(sd_sphere(p, edit.get_a(), edit.a.w), sd_sphere(p, edit.get_b(), edit.b.w), edit.smoothness);
+    case EDIT_SHAPE_SMOOTH_SUBTRACT:
+        return smooth_max(sd_sphere(p, edit.get_a(), edit.a.w), -sd_sphere(p, edit.get_b(), edit.b.w),
+                          edit.smoothness);
+    }
+    return 1.0f;
+}
+
+// conservative bounds of the voxels an edit can touch, inclusive
+inline void get_edit_bounds(const VoxelEditCommand &edit, Vector3 &min_voxel, Vector3 &max_voxel)
+{
+    const Vector3 a = edit.get_a();
+    const Vector3 b = edit.get_b();
+    const Vector3 ra = Vector3(edit.a.w, edit.a.w, edit.a.w);
+    const Vector3 rb = Vector3(edit.b.w, edit.b.w, edit.b.w);
+    switch (edit.shape)
+    {
+    case EDIT_SHAPE_STAMP:
+        min_voxel = a;
+        max_voxel = a + b - Vector3(1, 1, 1);
+        return;
+    case EDIT_SHAPE_BOX:
+        min_voxel = a - b;
+        max_voxel = a + b;
+        break;
+    case EDIT_SHAPE_CAPSULE:
+    case EDIT_SHAPE_CYLINDER:
+        min_voxel = a.min(b) - ra;
+        max_voxel = a.max(b) + ra;
+        break;
+    case EDIT_SHAPE_CONE:
+        min_voxel = a.min(b) - ra.max(rb);
+        max_voxel = a.max(b) + ra.max(rb);
+        break;
+    case EDIT_SHAPE_SMOOTH_UNION: {
+        // the blend grows the shape by at most smoothness / 4
+        const Vector3 blend = Vector3(1, 1, 1) * std::max(edit.smoothness, 0.0f) * 0.25f;
+        min_voxel = (a - ra).min(b - rb) - blend;
+        max_voxel = (a + ra).max(b + rb) + blend;
+        break;
+    }
+    case EDIT_SHAPE_SMOOTH_SUBTRACT: {
+        const Vector3 blend = Vector3(1, 1, 1) * std::max(edit.smoothness, 0.0f) * 0.25f;
+        min_voxel = a - ra - blend;
+        max_voxel = a + ra + blend;
+        break;
+    }
+    default:
+        min_voxel = a - ra;
+        max_voxel = a + ra;
+        break;
+    }
+    min_voxel = min_voxel.floor();
+    max_voxel = max_voxel.ceil();
+}
+
+} // namespace VoxelEditShapes
+
+#endif // VOXEL_EDIT_SHAPES_H
@@ -189,6 +189,9 @@ struct VoxelWorldRIDs
     RID voxel_bricks;
     RID voxel_data;
     RID voxel_data2;
+    // a bit per brick whose voxel types the automata or landing particles changed this frame, not part of
+    // add_voxel_buffers, the passes that write it bind it themselves
+    RID changed_bricks;
 
     size_t brick_count;
     size_t voxel_count;
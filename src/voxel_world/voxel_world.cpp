@@ -4,6 +4,8 @@
 #include <godot_cpp/classes/engine.hpp>
 #include <godot_cpp/classes/rendering_server.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
+#include <algorithm>
+#include <cmath>
 
 using namespace godot;
 
@@ -12,13 +14,20 @@ VoxelWorld::VoxelWorld()
     brick_map_size = Vector3i(16, 16, 16);
     scale = 0.125f;
     _initialized = false;
-    _has_last_collider_pos = false;
-    _has_last_collider_pos_aux = false;
 }
 
 VoxelWorld::~VoxelWorld()
 {
-
+    // the journal reads the params buffer of the edit pass, and every pass borrows the particle buffers
+    delete _mirror;
+    delete _shape_query_pass;
+    delete _raycast_pass;
+    delete _edit_journal;
+    delete _edit_pass;
+    delete _update_pass;
+    delete _particle_system;
+    if (_rd != nullptr && _voxel_world_rids.changed_bricks.is_valid())
+        _rd->free_rid(_voxel_world_rids.changed_bricks);
 }
 
 void VoxelWorld::edit_world(const Vector3 &camera_origin, const Vector3 &camera_direction, const float radius,
@@ -26,7 +35,28 @@ void VoxelWorld::edit_world(const Vector3 &camera_origin, const Vector3 &camera_
 {
     if (_edit_pass == nullptr)
         return;
-    _edit_pass->edit_using_raycast(camera_origin, camera_direction, radius, range, value);
+    // the hit is read back a few frames later, it also tells which bricks the edit changed
+    _edit_pass->edit_using_raycast(camera_origin, camera_direction, radius, range, value,
+                                   Callable(this, "_on_edit_hit_fetched"));
+}
+
+void VoxelWorld::_on_changed_bricks_fetched(const PackedByteArray &data)
+{
+    // bricks the automata moved voxels in, so the heightmap and the colliders follow falling sand and flowing water
+    std::vector<uint32_t> bricks = VoxelWorldUpdatePass::get_changed_bricks(data);
+    _dirty_bricks.insert(_dirty_bricks.end(), bricks.begin(), bricks.end());
+}
+
+void VoxelWorld::_on_edit_hit_fetched(const PackedByteArray &data, int64_t journal_entry)
+{
+    // the bricks are marked even when the edit was undone in the meantime, the swap changed them again
+    std::vector<uint32_t> bricks = _edit_pass->get_hit_bricks(data);
+    if (_edit_journal != nullptr && journal_entry >= 0)
+        _edit_journal->set_entry_bricks(journal_entry, bricks);
+    _dirty_bricks.insert(_dirty_bricks.end(), bricks.begin(), bricks.end());
+
+    Vector4 hit = VoxelEditPass::get_hit_position(data);
+    emit_signal("edit_hit", Vector3(hit.x, hit.y, hit.z) * scale, hit.w >= 0.0f);
 }
 
 void VoxelWorld::edit_sphere_at(const Vector3 &position, const float radius, const int value)
@@ -35,7 +65,134 @@ void VoxelWorld::edit_sphere_at(const Vector3 &position, const float radius, con
         return;
     // Convert world position (meters) to voxel grid coordinates before editing shader
     Vector3i grid = get_voxel_world_position(position);
-    _edit_pass->edit_at(Vector3(grid.x, grid.y, grid.z), radius, value);
+    _edit_pass->queue_sphere(Vector3(grid.x, grid.y, grid.z), radius, value);
+}
+
+void VoxelWorld::edit_box_at(const Vector3 &position, const Vector3 &half_extents, const int value)
+{
+    if (_edit_pass == nullptr)
+        return;
+    Vector3i grid = get_voxel_world_position(position);
+    _edit_pass->queue_box(Vector3(grid.x, grid.y, grid.z), half_extents, value);
+}
+
+void VoxelWorld::edit_capsule_at(const Vector3 &from, const Vector3 &to, const float radius, const int value)
+{
+    if (_edit_pass == nullptr)
+        return;
+    _edit_pass->queue_shape(EDIT_SHAPE_CAPSULE, get_voxel_edit_point(from, radius), get_voxel_edit_point(to, radius),
+                            value);
+}
+
+void VoxelWorld::edit_cylinder_at(const Vector3 &from, const Vector3 &to, const float radius, const int value)
+{
+    if (_edit_pass == nullptr)
+        return;
+    _edit_pass->queue_shape(EDIT_SHAPE_CYLINDER, get_voxel_edit_point(from, radius), get_voxel_edit_point(to, radius),
+                            value);
+}
+
+void VoxelWorld::edit_cone_at(const Vector3 &from, const Vector3 &to, const float radius_from, const float radius_to,
+                              const int value)
+{
+    if (_edit_pass == nullptr)
+        return;
+    _edit_pass->queue_shape(EDIT_SHAPE_CONE, get_voxel_edit_point(from, radius_from),
+                            get_voxel_edit_point(to, radius_to), value);
+}
+
+void VoxelWorld::edit_smooth_union_at(const Vector3 &position_a, const float radius_a, const Vector3 &position_b,
+                                      const float radius_b, const float smoothness, const int value)
+{
+    if (_edit_pass == nullptr)
+        return;
+    _edit_pass->queue_shape(EDIT_SHAPE_SMOOTH_UNION, get_voxel_edit_point(position_a, radius_a),
+                            get_voxel_edit_point(position_b, radius_b), value, smoothness);
+}
+
+void VoxelWorld::edit_smooth_subtract_at(const Vector3 &position, const float radius,
+                                         const Vector3 &subtract_position, const float subtract_radius,
+                                         const float smoothness, const int value)
+{
+    if (_edit_pass == nullptr)
+        return;
+    _edit_pass->queue_shape(EDIT_SHAPE_SMOOTH_SUBTRACT, get_voxel_edit_point(position, radius),
+                            get_voxel_edit_point(subtract_position, subtract_radius), value, smoothness);
+}
+
+void VoxelWorld::stamp_at(const Vector3 &position, const Ref<VoxelData> &voxel_data)
+{
+    if (_edit_pass == nullptr || voxel_data.is_null())
+        return;
+    if (voxel_data->get_count() == 0 && voxel_data->load() != OK)
+    {
+        UtilityFunctions::printerr("VoxelWorld::stamp_at() failed to load the stamp voxel data");
+        return;
+    }
+
+    const Vector3i size = voxel_data->get_size();
+    std::vector<Voxel> voxels;
+    voxels.reserve(voxel_data->get_count());
+    for (int z = 0; z < size.z; ++z)
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x)
+                voxels.push_back(voxel_data->get_voxel_at(Vector3i(x, y, z)));
+    _edit_pass->queue_stamp(get_voxel_world_position(position), size, voxels);
+}
+
+void VoxelWorld::set_simulation_substeps(int substeps)
+{
+    simulation_substeps = std::clamp(substeps, 1, VoxelWorldUpdatePass::MAX_SUBSTEPS);
+    if (_update_pass != nullptr)
+        _update_pass->set_substeps(simulation_substeps);
+}
+
+void VoxelWorld::explode_at(const Vector3 &position, const float radius, const float eject_speed)
+{
+    if (_edit_pass == nullptr)
+        return;
+    Vector3i grid = get_voxel_world_position(position);
+    _edit_pass->queue_sphere(Vector3(grid.x, grid.y, grid.z), radius, 0, eject_speed / scale);
+}
+
+void VoxelWorld::set_undo_enabled(bool enabled)
+{
+    undo_enabled = enabled;
+    if (_edit_pass == nullptr)
+        return;
+    if (enabled && _edit_journal == nullptr)
+        _edit_journal = new VoxelEditJournal(_rd, _voxel_world_rids, _edit_pass->get_edit_params_rid(), undo_memory_mb);
+    _edit_pass->set_journal(enabled ? _edit_journal : nullptr);
+}
+
+bool VoxelWorld::undo()
+{
+    if (_edit_journal == nullptr)
+        return false;
+    // edits queued this frame come first, so they can be undone right away
+    _edit_pass->flush();
+    return _edit_journal->undo(_dirty_bricks);
+}
+
+bool VoxelWorld::redo()
+{
+    if (_edit_journal == nullptr)
+        return false;
+    _edit_pass->flush();
+    return _edit_journal->redo(_dirty_bricks);
+}
+
+void VoxelWorld::clear_undo_history()
+{
+    if (_edit_journal != nullptr)
+        _edit_journal->clear();
+}
+
+void VoxelWorld::set_particles_enabled(bool enabled)
+{
+    particles_enabled = enabled;
+    if (_particle_system != nullptr)
+        _particle_system->set_spawn_enabled(enabled);
 }
 
 Vector4 VoxelWorld::raycast_voxels(const Vector3 &origin, const Vector3 &direction, float near, float far)
@@ -45,6 +202,164 @@ Vector4 VoxelWorld::raycast_voxels(const Vector3 &origin, const Vector3 &directi
     return _edit_pass->raycast_voxels(origin, direction, near, far);
 }
 
+PackedFloat32Array VoxelWorld::raycast_batch(const PackedVector3Array &origins, const PackedVector3Array &directions,
+                                             const PackedFloat32Array &ranges)
+{
+    if (_raycast_pass == nullptr)
+        return PackedFloat32Array();
+    return _raycast_pass->raycast_batch(origins, directions, ranges);
+}
+
+Vector4 VoxelWorld::raycast_voxels_cpu(const Vector3 &origin, const Vector3 &direction, float near, float far)
+{
+    // the mirror misses everything it has not streamed in yet, the GPU answers until then
+    if (_mirror == nullptr || !_mirror->is_synced())
+        return raycast_voxels(origin, direction, near, far);
+    return _mirror->raycast_voxels(origin, direction, near, far);
+}
+
+PackedFloat32Array VoxelWorld::raycast_batch_cpu(const PackedVector3Array &origins,
+                                                 const PackedVector3Array &directions,
+                                                 const PackedFloat32Array &ranges)
+{
+    if (_mirror == nullptr || !_mirror->is_synced())
+        return raycast_batch(origins, directions, ranges);
+    return _mirror->raycast_batch(origins, directions, ranges);
+}
+
+void VoxelWorld::add_collider_agent(Node3D *agent)
+{
+    if (_voxel_world_collider != nullptr)
+        _voxel_world_collider->addAgent(agent);
+}
+
+void VoxelWorld::remove_collider_agent(Node3D *agent)
+{
+    if (_voxel_world_collider != nullptr)
+        _voxel_world_collider->removeAgent(agent);
+}
+
+float VoxelWorld::get_ground_height(float x, float z) const
+{
+    if (_mirror == nullptr)
+        return -1.0f;
+    const int top = _mirror->get_heightmap().get_top(int(std::floor(x / scale)), int(std::floor(z / scale)));
+    return top == VoxelHeightmap::NO_GROUND ? -1.0f : (top + 1) * scale;
+}
+
+float VoxelWorld::get_ground_below(const Vector3 &origin, float max_distance)
+{
+    static constexpr float PROBE_RADIUS = 0.05f; // meters
+    const float ground = get_ground_height(origin.x, origin.z);
+    if (ground >= 0.0f && ground <= origin.y)
+        return ground;
+    const Vector4 hit = sweep_sphere(origin, origin + Vector3(0.0f, -max_distance, 0.0f), PROBE_RADIUS);
+    return hit.w < 0.0f ? -1.0f : hit.y - PROBE_RADIUS;
+}
+
+int VoxelWorld::get_ground_type(float x, float z) const
+{
+    if (_mirror == nullptr)
+        return 0;
+    return _mirror->get_heightmap().get_type(int(std::floor(x / scale)), int(std::floor(z / scale)));
+}
+
+Vector4 VoxelWorld::sweep_sphere(const Vector3 &from, const Vector3 &to, float radius)
+{
+    // contact center, w how far the sphere travelled
+    const Vector3 direction = (to - from).normalized();
+    if (_mirror != nullptr && _mirror->is_synced())
+    {
+        VoxelRayHit hit;
+        if (!_mirror->sweep_sphere(from, to, radius, hit))
+            return Vector4(0, 0, 0, -1);
+        const Vector3 center = from + direction * hit.distance;
+        return Vector4(center.x, center.y, center.z, hit.distance);
+    }
+    if (_shape_query_pass == nullptr)
+        return Vector4(0, 0, 0, -1);
+    PackedVector3Array froms, tos;
+    PackedFloat32Array radii;
+    froms.push_back(from);
+    tos.push_back(to);
+    radii.push_back(radius);
+    PackedFloat32Array hit = _shape_query_pass->sweep_sphere_batch(froms, tos, radii);
+    if (hit.is_empty() || hit[0] < 0.0f)
+        return Vector4(0, 0, 0, -1);
+    const Vector3 center = from + direction * hit[0];
+    return Vector4(center.x, center.y, center.z, hit[0]);
+}
+
+PackedInt32Array VoxelWorld::overlap_count(const Vector3 &center, float radius, int type_mask)
+{
+    if (_mirror != nullptr && _mirror->is_synced())
+    {
+        PackedInt32Array counts;
+        counts.resize(VoxelWorldMirror::OVERLAP_TYPE_COUNT);
+        _mirror->overlap_count(center, radius, uint32_t(type_mask), counts.ptrw());
+        return counts;
+    }
+    if (_shape_query_pass == nullptr)
+        return PackedInt32Array();
+    PackedVector3Array centers;
+    PackedFloat32Array radii;
+    centers.push_back(center);
+    radii.push_back(radius);
+    return _shape_query_pass->overlap_count_batch(centers, radii, uint32_t(type_mask));
+}
+
+PackedFloat32Array VoxelWorld::sweep_sphere_batch(const PackedVector3Array &froms, const PackedVector3Array &tos,
+                                                  const PackedFloat32Array &radii)
+{
+    if (_shape_query_pass == nullptr)
+        return PackedFloat32Array();
+    return _shape_query_pass->sweep_sphere_batch(froms, tos, radii);
+}
+
+PackedInt32Array VoxelWorld::overlap_count_batch(const PackedVector3Array &centers, const PackedFloat32Array &radii,
+                                                 int type_mask)
+{
+    if (_shape_query_pass == nullptr)
+        return PackedInt32Array();
+    return _shape_query_pass->overlap_count_batch(centers, radii, uint32_t(type_mask));
+}
+
+PackedFloat32Array VoxelWorld::sweep_sphere_batch_cpu(const PackedVector3Array &froms, const PackedVector3Array &tos,
+                                                      const PackedFloat32Array &radii)
+{
+    if (_mirror == nullptr)
+        return PackedFloat32Array();
+    return _mirror->sweep_sphere_batch(froms, tos, radii);
+}
+
+PackedInt32Array VoxelWorld::overlap_count_batch_cpu(const PackedVector3Array &centers,
+                                                     const PackedFloat32Array &radii, int type_mask)
+{
+    if (_mirror == nullptr)
+        return PackedInt32Array();
+    return _mirror->overlap_count_batch(centers, radii, uint32_t(type_mask));
+}
+
+void VoxelWorld::raycast_voxels_async(const Vector3 &origin, const Vector3 &direction, float near, float far,
+                                      const Callable &callback)
+{
+    if (_raycast_pass == nullptr)
+        return;
+    _raycast_pass->queue_async(origin, direction, near, far, callback);
+}
+
+void VoxelWorld::_on_async_raycasts_fetched(const PackedByteArray &data)
+{
+    if (_raycast_pass != nullptr)
+        _raycast_pass->on_async_fetched(data);
+}
+
+void VoxelWorld::_on_mirror_bricks_fetched(const PackedByteArray &data, int first_brick)
+{
+    if (_mirror != nullptr)
+        _mirror->on_bricks_fetched(data, first_brick);
+}
+
 void VoxelWorld::_bind_methods()
 {
     ClassDB::bind_method(D_METHOD("get_generator"), &VoxelWorld::get_generator);
@@ -64,23 +379,53 @@ void VoxelWorld::_bind_methods()
     ClassDB::bind_method(D_METHOD("set_simulation_enabled", "enabled"), &VoxelWorld::set_simulation_enabled);
     ADD_PROPERTY(PropertyInfo(Variant::BOOL, "simulation_enabled"), "set_simulation_enabled", "get_simulation_enabled");
 
+    ClassDB::bind_method(D_METHOD("get_simulation_substeps"), &VoxelWorld::get_simulation_substeps);
+    ClassDB::bind_method(D_METHOD("set_simulation_substeps", "substeps"), &VoxelWorld::set_simulation_substeps);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "simulation_substeps", PROPERTY_HINT_RANGE, "1,3,1"),
+                 "set_simulation_substeps", "get_simulation_substeps");
+
+    ClassDB::bind_method(D_METHOD("get_particles_enabled"), &VoxelWorld::get_particles_enabled);
+    ClassDB::bind_method(D_METHOD("set_particles_enabled", "enabled"), &VoxelWorld::set_particles_enabled);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "particles_enabled"), "set_particles_enabled", "get_particles_enabled");
+
+    ClassDB::bind_method(D_METHOD("get_particle_capacity"), &VoxelWorld::get_particle_capacity);
+    ClassDB::bind_method(D_METHOD("set_particle_capacity", "capacity"), &VoxelWorld::set_particle_capacity);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "particle_capacity", PROPERTY_HINT_RANGE, "1,1048576,1"),
+                 "set_particle_capacity", "get_particle_capacity");
+
+    ClassDB::bind_method(D_METHOD("get_undo_enabled"), &VoxelWorld::get_undo_enabled);
+    ClassDB::bind_method(D_METHOD("set_undo_enabled", "enabled"), &VoxelWorld::set_undo_enabled);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "undo_enabled"), "set_undo_enabled", "get_undo_enabled");
+
+    ClassDB::bind_method(D_METHOD("get_undo_memory_mb"), &VoxelWorld::get_undo_memory_mb);
+    ClassDB::bind_method(D_METHOD("set_undo_memory_mb", "memory_mb"), &VoxelWorld::set_undo_memory_mb);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "undo_memory_mb", PROPERTY_HINT_RANGE, "1,4096,1,suffix:MB"),
+                 "set_undo_memory_mb", "get_undo_memory_mb");
+
+    ClassDB::bind_method(D_METHOD("get_cpu_mirror_enabled"), &VoxelWorld::get_cpu_mirror_enabled);
+    ClassDB::bind_method(D_METHOD("set_cpu_mirror_enabled", "enabled"), &VoxelWorld::set_cpu_mirror_enabled);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "cpu_mirror_enabled"), "set_cpu_mirror_enabled", "get_cpu_mirror_enabled");
+
+    ClassDB::bind_method(D_METHOD("get_mirror_bricks_per_frame"), &VoxelWorld::get_mirror_bricks_per_frame);
+    ClassDB::bind_method(D_METHOD("set_mirror_bricks_per_frame", "bricks"), &VoxelWorld::set_mirror_bricks_per_frame);
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "mirror_bricks_per_frame", PROPERTY_HINT_RANGE, "1,65536,1"),
+                 "set_mirror_bricks_per_frame", "get_mirror_bricks_per_frame");
+
     ClassDB::bind_method(D_METHOD("set_voxel_world_collider", "collider"), &VoxelWorld::set_voxel_world_collider);
     ClassDB::bind_method(D_METHOD("get_voxel_world_collider"), &VoxelWorld::get_voxel_world_collider);
     ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "voxel_world_collider", PROPERTY_HINT_NODE_TYPE, "VoxelWorldCollider"),
                  "set_voxel_world_collider", "get_voxel_world_collider");
-    ClassDB::bind_method(D_METHOD("set_voxel_world_collider_aux", "collider"), &VoxelWorld::set_voxel_world_collider_aux);
-    ClassDB::bind_method(D_METHOD("get_voxel_world_collider_aux"), &VoxelWorld::get_voxel_world_collider_aux);
-    ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "voxel_world_collider_aux", PROPERTY_HINT_NODE_TYPE, "VoxelWorldCollider"),
-                 "set_voxel_world_collider_aux", "get_voxel_world_collider_aux");
+    ClassDB::bind_method(D_METHOD("add_collider_agent", "agent"), &VoxelWorld::add_collider_agent);
+    ClassDB::bind_method(D_METHOD("remove_collider_agent", "agent"), &VoxelWorld::remove_collider_agent);
 
     ClassDB::bind_method(D_METHOD("get_player_node"), &VoxelWorld::get_player_node);
     ClassDB::bind_method(D_METHOD("set_player_node", "player_node"), &VoxelWorld::set_player_node);
     ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "player_node", PROPERTY_HINT_NODE_TYPE, "Node3D"), "set_player_node",
                  "get_player_node");
-    ClassDB::bind_method(D_METHOD("get_aux_node"), &VoxelWorld::get_aux_node);
-    ClassDB::bind_method(D_METHOD("set_aux_node", "aux_node"), &VoxelWorld::set_aux_node);
-    ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "aux_node", PROPERTY_HINT_NODE_TYPE, "Node3D"), "set_aux_node",
-                 "get_aux_node");
+    ClassDB::bind_method(D_METHOD("get_player_collider_agent"), &VoxelWorld::get_player_collider_agent);
+    ClassDB::bind_method(D_METHOD("set_player_collider_agent", "enabled"), &VoxelWorld::set_player_collider_agent);
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "player_collider_agent"), "set_player_collider_agent",
+                 "get_player_collider_agent");
 
     ClassDB::bind_method(D_METHOD("get_sun_light"), &VoxelWorld::get_sun_light);
     ClassDB::bind_method(D_METHOD("set_sun_light", "sun_light"), &VoxelWorld::set_sun_light);
@@ -98,13 +443,61 @@ void VoxelWorld::_bind_methods()
     // methods
     ClassDB::bind_method(D_METHOD("edit_world", "camera_origin", "camera_direction", "radius", "range", "value"),
                          &VoxelWorld::edit_world);
+    ClassDB::bind_method(D_METHOD("_on_edit_hit_fetched", "data", "journal_entry"), &VoxelWorld::_on_edit_hit_fetched);
+    ClassDB::bind_method(D_METHOD("_on_changed_bricks_fetched", "data"), &VoxelWorld::_on_changed_bricks_fetched);
     ClassDB::bind_method(D_METHOD("edit_sphere_at", "position", "radius", "value"), &VoxelWorld::edit_sphere_at);
+    ClassDB::bind_method(D_METHOD("edit_box_at", "position", "half_extents", "value"), &VoxelWorld::edit_box_at);
+    ClassDB::bind_method(D_METHOD("edit_capsule_at", "from", "to", "radius", "value"), &VoxelWorld::edit_capsule_at);
+    ClassDB::bind_method(D_METHOD("edit_cylinder_at", "from", "to", "radius", "value"), &VoxelWorld::edit_cylinder_at);
+    ClassDB::bind_method(D_METHOD("edit_cone_at", "from", "to", "radius_from", "radius_to", "value"),
+                         &VoxelWorld::edit_cone_at);
+    ClassDB::bind_method(D_METHOD("edit_smooth_union_at", "position_a", "radius_a", "position_b", "radius_b",
+                                  "smoothness", "value"),
+                         &VoxelWorld::edit_smooth_union_at);
+    ClassDB::bind_method(D_METHOD("edit_smooth_subtract_at", "position", "radius", "subtract_position",
+                                  "subtract_radius", "smoothness", "value"),
+                         &VoxelWorld::edit_smooth_subtract_at);
+    ClassDB::bind_method(D_METHOD("stamp_at", "position", "voxel_data"), &VoxelWorld::stamp_at);
+    ClassDB::bind_method(D_METHOD("explode_at", "position", "radius", "eject_speed"), &VoxelWorld::explode_at);
+    ClassDB::bind_method(D_METHOD("undo"), &VoxelWorld::undo);
+    ClassDB::bind_method(D_METHOD("redo"), &VoxelWorld::redo);
+    ClassDB::bind_method(D_METHOD("clear_undo_history"), &VoxelWorld::clear_undo_history);
+    ClassDB::bind_method(D_METHOD("get_undo_count"), &VoxelWorld::get_undo_count);
+    ClassDB::bind_method(D_METHOD("get_redo_count"), &VoxelWorld::get_redo_count);
     ClassDB::bind_method(D_METHOD("raycast_voxels", "origin", "direction", "near", "far"), &VoxelWorld::raycast_voxels);
+    ClassDB::bind_method(D_METHOD("raycast_batch", "origins", "directions", "ranges"), &VoxelWorld::raycast_batch);
+    ClassDB::bind_method(D_METHOD("raycast_voxels_cpu", "origin", "direction", "near", "far"),
+                         &VoxelWorld::raycast_voxels_cpu);
+    ClassDB::bind_method(D_METHOD("raycast_batch_cpu", "origins", "directions", "ranges"),
+                         &VoxelWorld::raycast_batch_cpu);
+    ClassDB::bind_method(D_METHOD("get_ground_height", "x", "z"), &VoxelWorld::get_ground_height);
+    ClassDB::bind_method(D_METHOD("get_ground_type", "x", "z"), &VoxelWorld::get_ground_type);
+    ClassDB::bind_method(D_METHOD("get_ground_below", "origin", "max_distance"), &VoxelWorld::get_ground_below);
+    ClassDB::bind_method(D_METHOD("sweep_sphere", "from", "to", "radius"), &VoxelWorld::sweep_sphere);
+    ClassDB::bind_method(D_METHOD("overlap_count", "center", "radius", "type_mask"), &VoxelWorld::overlap_count,
+                         DEFVAL(~1));
+    ClassDB::bind_method(D_METHOD("sweep_sphere_batch", "froms", "tos", "radii"), &VoxelWorld::sweep_sphere_batch);
+    ClassDB::bind_method(D_METHOD("overlap_count_batch", "centers", "radii", "type_mask"),
+                         &VoxelWorld::overlap_count_batch, DEFVAL(~1));
+    ClassDB::bind_method(D_METHOD("sweep_sphere_batch_cpu", "froms", "tos", "radii"),
+                         &VoxelWorld::sweep_sphere_batch_cpu);
+    ClassDB::bind_method(D_METHOD("overlap_count_batch_cpu", "centers", "radii", "type_mask"),
+                         &VoxelWorld::overlap_count_batch_cpu, DEFVAL(~1));
+    ClassDB::bind_method(D_METHOD("raycast_voxels_async", "origin", "direction", "near", "far", "callback"),
+                         &VoxelWorld::raycast_voxels_async);
+    ClassDB::bind_method(D_METHOD("_on_async_raycasts_fetched", "data"), &VoxelWorld::_on_async_raycasts_fetched);
+    ClassDB::bind_method(D_METHOD("_on_mirror_bricks_fetched", "data", "first_brick"),
+                         &VoxelWorld::_on_mirror_bricks_fetched);
+
+    // emitted for edit_world() calls once the GPU raycast result is back, position in meters
+    ADD_SIGNAL(MethodInfo("edit_hit", PropertyInfo(Variant::VECTOR3, "position"), PropertyInfo(Variant::BOOL, "hit")));
 
     // Performance profiling methods
     ClassDB::bind_method(D_METHOD("get_time_simulation_liquid"), &VoxelWorld::get_time_simulation_liquid);
     ClassDB::bind_method(D_METHOD("get_time_simulation_freeze"), &VoxelWorld::get_time_simulation_freeze);
     ClassDB::bind_method(D_METHOD("get_time_simulation_cleanup"), &VoxelWorld::get_time_simulation_cleanup);
+    ClassDB::bind_method(D_METHOD("get_time_simulation_particles"), &VoxelWorld::get_time_simulation_particles);
+    ClassDB::bind_method(D_METHOD("get_time_edit"), &VoxelWorld::get_time_edit);
     ClassDB::bind_method(D_METHOD("get_time_collision"), &VoxelWorld::get_time_collision);
     ClassDB::bind_method(D_METHOD("get_time_total_update"), &VoxelWorld::get_time_total_update);
 
@@ -181,6 +574,11 @@ void VoxelWorld::init()
     PackedByteArray properties_data = _voxel_properties.to_packed_byte_array();
     _voxel_world_rids.properties = _rd->storage_buffer_create(properties_data.size(), properties_data);
 
+    PackedByteArray changed_bricks;
+    changed_bricks.resize(((brick_count + 31) / 32) * sizeof(uint32_t));
+    changed_bricks.fill(0);
+    _voxel_world_rids.changed_bricks = _rd->storage_buffer_create(changed_bricks.size(), changed_bricks);
+
     if (generator.is_null())
     {
         UtilityFunctions::printerr(
@@ -190,20 +588,33 @@ void VoxelWorld::init()
     generator->initialize_brick_grid(_rd, _voxel_world_rids, _voxel_properties);
     generator->generate(_rd, _voxel_world_rids, _voxel_properties);
 
+    // Create the particle pool, shared by the automata (free fall), edits (debris) and the camera.
+    _particle_system = new VoxelParticleSystem(_rd, _voxel_world_rids, particle_capacity, scale);
+    _particle_system->set_spawn_enabled(particles_enabled);
+
     // Create the update pass.
-    _update_pass = new VoxelWorldUpdatePass("res://addons/voxel_playground/src/shaders/automata/liquid.glsl", _rd, _voxel_world_rids, size);
+    _update_pass = new VoxelWorldUpdatePass("res://addons/voxel_playground/src/shaders/automata/liquid.glsl", _rd, _voxel_world_rids, _particle_system->get_rids(), size);
+    _update_pass->set_substeps(simulation_substeps);
 
     // Create the edit pass.
-    _edit_pass = new VoxelEditPass("res://addons/voxel_playground/src/shaders/voxel_edit/sphere_edit.glsl", _rd, _voxel_world_rids, size);
+    _edit_pass = new VoxelEditPass("res://addons/voxel_playground/src/shaders/voxel_edit/sphere_edit.glsl", _rd, _voxel_world_rids, _particle_system->get_rids(), size);
+    set_undo_enabled(undo_enabled);
+
+    // Create the batched raycast pass.
+    _raycast_pass = new VoxelRaycastPass(_rd, _voxel_world_rids);
+    _shape_query_pass = new VoxelShapeQueryPass(_rd, _voxel_world_rids);
+
+    // Mirror the generated world on the CPU, it is read back over the first frames and then kept up to date
+    // asynchronously.
+    if (cpu_mirror_enabled)
+        _mirror = new VoxelWorldMirror(_rd, _voxel_world_rids, _voxel_properties);
 
-    // if colliders set, initialize them
+    // if a collider is set, initialize it around the player, unless the player registers itself
     if (_voxel_world_collider != nullptr)
     {
         _voxel_world_collider->init(_rd, _voxel_world_rids, scale);
-    }
-    if (_voxel_world_collider_aux != nullptr)
-    {
-        _voxel_world_collider_aux->init(_rd, _voxel_world_rids, scale);
+        if (player_collider_agent)
+            _voxel_world_collider->addAgent(player_node);
     }
     
     _initialized = true;
@@ -220,92 +631,70 @@ void VoxelWorld::update(float delta)
     PackedByteArray properties_data = _voxel_properties.to_packed_byte_array();
     _rd->buffer_update(_voxel_world_rids.properties, 0, properties_data.size(), properties_data);
 
+    // apply all edits queued since the last frame with a single dispatch
+    uint64_t edit_start = Time::get_singleton()->get_ticks_usec();
+    _edit_pass->flush();
+    _time_edit_us = Time::get_singleton()->get_ticks_usec() - edit_start;
+
+    // particles are part of the simulation: they deposit into the buffer the automata carry over, so they pause
+    // with it
     if (simulation_enabled)
     {
         uint64_t sim_start = Time::get_singleton()->get_ticks_usec();
+        _particle_system->begin_frame(delta);
         _update_pass->update(delta);
+        _particle_system->update();
+        // after the particles, their landings are reported with the automata changes
+        _update_pass->fetch_changed_bricks(Callable(this, "_on_changed_bricks_fetched"));
         uint64_t sim_end = Time::get_singleton()->get_ticks_usec();
 
         // Get individual pass timings from update pass
         _time_simulation_liquid_us = _update_pass->get_time_liquid_us();
         _time_simulation_freeze_us = _update_pass->get_time_freeze_us();
         _time_simulation_cleanup_us = _update_pass->get_time_cleanup_us();
+        _time_simulation_particles_us = _particle_system->get_time_update_us();
     }
     else
     {
         _time_simulation_liquid_us = 0;
         _time_simulation_freeze_us = 0;
         _time_simulation_cleanup_us = 0;
+        _time_simulation_particles_us = 0;
     }
 
-    // Update primary collider at player
-    if (_voxel_world_collider != nullptr && player_node != nullptr)
-    {
-        // Snap collider update center to reduce remeshing churn when moving/falling.
-        static const int SNAP_VOX = 4; // 4 voxels; with scale=0.25 this equals 1m
-        Vector3 player_pos = player_node->get_global_position();
-        Vector3i pvox = get_voxel_world_position(player_pos);
-
-        auto snap_comp = [](int v) {
-            // floor-like snapping that behaves for negative coordinates
-            int q = v / SNAP_VOX;
-            int r = v % SNAP_VOX;
-            if (r < 0) {
-                q -= 1;
-            }
-            return q * SNAP_VOX;
-        };
-
-        Vector3i snapped(snap_comp(pvox.x), snap_comp(pvox.y), snap_comp(pvox.z));
-
-        if (!_has_last_collider_pos || snapped != _last_collider_voxel_pos)
-        {
-            uint64_t collision_start = Time::get_singleton()->get_ticks_usec();
-            _voxel_world_collider->update(snapped);
-            uint64_t collision_end = Time::get_singleton()->get_ticks_usec();
-            _time_collision_us = collision_end - collision_start;
-
-            _last_collider_voxel_pos = snapped;
-            _has_last_collider_pos = true;
-        }
-    }
-    // Update auxiliary collider at aux_node (e.g., an enemy like slime)
-    if (_voxel_world_collider_aux != nullptr && (aux_node_id != ObjectID()))
+    // bricks edited, undone, redone or changed by the automata, the colliders and the CPU mirror fetch them again
+    std::vector<uint32_t> edited_bricks = _edit_pass->take_edited_bricks();
+    edited_bricks.insert(edited_bricks.end(), _dirty_bricks.begin(), _dirty_bricks.end());
+    _dirty_bricks.clear();
+    const Vector3i brick_grid_size(_voxel_properties.brick_grid_size.x, _voxel_properties.brick_grid_size.y,
+                                   _voxel_properties.brick_grid_size.z);
+
+    // The collider keeps the chunks that stay in the windows of its agents, so calling it every frame only
+    // fetches the chunks that entered a window or whose bricks were edited or simulated.
+    if (_voxel_world_collider != nullptr)
     {
-        static const int SNAP_VOX = 4;
-        // Resolve aux node safely via ObjectDB each frame in case it was freed.
-        Object *aux_obj = ObjectDB::get_instance((uint64_t)aux_node_id);
-        Node3D *aux = Object::cast_to<Node3D>(aux_obj);
-        if (aux == nullptr) {
-            aux_node = nullptr;
-            aux_node_id = ObjectID();
-        } else {
-            Vector3 aux_pos = aux->get_global_position();
-        Vector3i avox = get_voxel_world_position(aux_pos);
-
-        auto snap_comp2 = [](int v) {
-            int q = v / SNAP_VOX;
-            int r = v % SNAP_VOX;
-            if (r < 0) {
-                q -= 1;
-            }
-            return q * SNAP_VOX;
-        };
-        Vector3i snapped2(snap_comp2(avox.x), snap_comp2(avox.y), snap_comp2(avox.z));
-
-            if (!_has_last_collider_pos_aux || snapped2 != _last_collider_voxel_pos_aux)
-            {
-                _voxel_world_collider_aux->update(snapped2);
-                _last_collider_voxel_pos_aux = snapped2;
-                _has_last_collider_pos_aux = true;
-            }
-        }
+        uint64_t collision_start = Time::get_singleton()->get_ticks_usec();
+        _voxel_world_collider->markBricksDirty(edited_bricks, brick_grid_size);
+        _voxel_world_collider->update();
+        uint64_t collision_end = Time::get_singleton()->get_ticks_usec();
+        _time_collision_us = collision_end - collision_start;
     }
     else
     {
         _time_collision_us = 0;
     }
 
+    if (_mirror != nullptr)
+    {
+        _mirror->mark_dirty(edited_bricks);
+        _mirror->request_updates(_voxel_properties.frame, Callable(this, "_on_mirror_bricks_fetched"),
+                                 mirror_bricks_per_frame);
+    }
+
+    // async raycasts see this frame's edits, their results arrive with the readback
+    if (_raycast_pass != nullptr)
+        _raycast_pass->flush_async(Callable(this, "_on_async_raycasts_fetched"));
+
     uint64_t update_end = Time::get_singleton()->get_ticks_usec();
     _time_total_update_us = update_end - update_start;
 }
@@ -8,12 +8,18 @@
 #include <godot_cpp/classes/directional_light3d.hpp>
 #include <godot_cpp/classes/time.hpp>
 #include <godot_cpp/core/object_id.hpp>
+#include <algorithm>
 
 #include "voxel_world/voxel_properties.h"
 #include "voxel_world/cellular_automata/voxel_world_update_pass.h"
 #include "voxel_world/voxel_edit/voxel_edit_pass.h"
+#include "voxel_world/particles/voxel_particle_system.h"
+#include "voxel_world/queries/voxel_raycast_pass.h"
+#include "voxel_world/queries/voxel_shape_query_pass.h"
+#include "voxel_world/queries/voxel_world_mirror.h"
 #include "voxel_world/colliders/voxel_world_collider.h"
 #include "voxel_world/generator/voxel_world_generator.h"
+#include "voxel_world/data/voxel_data.h"
 
 using namespace godot;
 
@@ -30,6 +36,13 @@ private:
     Vector3i brick_map_size = Vector3i(16, 16, 16);
     float scale = 0.125f;
     bool simulation_enabled = true;
+    int simulation_substeps = 1;
+    bool particles_enabled = true;
+    int particle_capacity = 16384;
+    bool undo_enabled = false;
+    bool cpu_mirror_enabled = true;
+    int mirror_bricks_per_frame = 256;
+    int undo_memory_mb = 64;
     bool _initialized;
 
     // RID _voxel_data_rid;
@@ -39,14 +52,19 @@ private:
     VoxelWorldProperties _voxel_properties;
     RenderingDevice* _rd;
     Node3D* player_node = nullptr;
-    Node3D* aux_node = nullptr;
-    ObjectID aux_node_id = ObjectID();
+    bool player_collider_agent = true;
 
     Ref<VoxelWorldGenerator> generator;
     VoxelWorldUpdatePass* _update_pass = nullptr;
     VoxelEditPass* _edit_pass = nullptr;
+    VoxelEditJournal* _edit_journal = nullptr;
+    VoxelParticleSystem* _particle_system = nullptr;
+    VoxelRaycastPass* _raycast_pass = nullptr;
+    VoxelShapeQueryPass* _shape_query_pass = nullptr;
+    VoxelWorldMirror* _mirror = nullptr;
     VoxelWorldCollider* _voxel_world_collider = nullptr;
-    VoxelWorldCollider* _voxel_world_collider_aux = nullptr;
+    // bricks changed outside the edit queue (raycast edits, undo, redo, automata), marked dirty with the next update
+    std::vector<uint32_t> _dirty_bricks;
 
     DirectionalLight3D* _sun_light = nullptr;
     Color ground_color = Color(0.5, 0.3, 0.15, 1.0);
@@ -56,22 +74,25 @@ private:
     uint64_t _time_simulation_liquid_us = 0;
     uint64_t _time_simulation_freeze_us = 0;
     uint64_t _time_simulation_cleanup_us = 0;
+    uint64_t _time_simulation_particles_us = 0;
+    uint64_t _time_edit_us = 0;
     uint64_t _time_collision_us = 0;
     uint64_t _time_total_update_us = 0;
 
     void init();
     void update(float delta);
+    void _on_edit_hit_fetched(const PackedByteArray &data, int64_t journal_entry);
+    void _on_changed_bricks_fetched(const PackedByteArray &data);
+    void _on_async_raycasts_fetched(const PackedByteArray &data);
+    void _on_mirror_bricks_fetched(const PackedByteArray &data, int first_brick);
 
     Vector3i get_voxel_world_position(const Vector3 &position) const {
         return Vector3i(std::floor(position.x / scale), std::floor(position.y / scale), std::floor(position.z / scale));
     }
-
-    // Throttle collider updates by snapping the requested center to a voxel grid
-    // and only updating when the snapped center changes.
-    Vector3i _last_collider_voxel_pos = Vector3i(0, 0, 0);
-    bool _has_last_collider_pos = false;
-    Vector3i _last_collider_voxel_pos_aux = Vector3i(0, 0, 0);
-    bool _has_last_collider_pos_aux = false;
+    Vector4 get_voxel_edit_point(const Vector3 &position, float radius) const {
+        Vector3i grid = get_voxel_world_position(position);
+        return Vector4(grid.x, grid.y, grid.z, radius);
+    }
 
 public:
     VoxelWorld();
@@ -84,9 +105,31 @@ public:
     void set_scale(float p_scale) { scale = p_scale; }
     float get_scale() const { return scale; }
 
+    // Pausing the simulation also pauses the particles, in-flight debris and splashes stay where they are.
     void set_simulation_enabled(bool enabled) { simulation_enabled = enabled; }
     bool get_simulation_enabled() const { return simulation_enabled; }
 
+    void set_simulation_substeps(int substeps);
+    int get_simulation_substeps() const { return simulation_substeps; }
+
+    void set_particles_enabled(bool enabled);
+    bool get_particles_enabled() const { return particles_enabled; }
+    void set_particle_capacity(int capacity) { particle_capacity = std::max(capacity, 1); }
+    int get_particle_capacity() const { return particle_capacity; }
+
+    // Records edits for undo/redo. The history is allocated the first time it is enabled after init,
+    // undo_memory_mb caps its GPU memory.
+    void set_undo_enabled(bool enabled);
+    bool get_undo_enabled() const { return undo_enabled; }
+    void set_undo_memory_mb(int memory_mb) { undo_memory_mb = std::max(memory_mb, 1); }
+    int get_undo_memory_mb() const { return undo_memory_mb; }
+
+    // CPU copy of the world for the *_cpu queries, applied on init. mirror_bricks_per_frame bounds the readback.
+    void set_cpu_mirror_enabled(bool enabled) { cpu_mirror_enabled = enabled; }
+    bool get_cpu_mirror_enabled() const { return cpu_mirror_enabled; }
+    void set_mirror_bricks_per_frame(int bricks) { mirror_bricks_per_frame = std::max(bricks, 1); }
+    int get_mirror_bricks_per_frame() const { return mirror_bricks_per_frame; }
+
     void set_sun_light(DirectionalLight3D* node) { _sun_light = node; }
     DirectionalLight3D* get_sun_light() const { return _sun_light; }
 
@@ -97,20 +140,84 @@ public:
 
     void set_player_node(Node3D* node) { player_node = node; }
     Node3D* get_player_node() const { return player_node; }
-    void set_aux_node(Node3D* node) { aux_node = node; aux_node_id = node ? ObjectID(node->get_instance_id()) : ObjectID(); }
-    Node3D* get_aux_node() const { return aux_node; }
+    // player_node is added as a collider agent on init. Off for players that register themselves, for example
+    // because they move against the mirror and need no collider.
+    void set_player_collider_agent(bool enabled) { player_collider_agent = enabled; }
+    bool get_player_collider_agent() const { return player_collider_agent; }
 
     void set_voxel_world_collider(VoxelWorldCollider* collider) {_voxel_world_collider = collider;}
     VoxelWorldCollider* get_voxel_world_collider() const { return _voxel_world_collider; }
-    void set_voxel_world_collider_aux(VoxelWorldCollider* collider) { _voxel_world_collider_aux = collider; }
-    VoxelWorldCollider* get_voxel_world_collider_aux() const { return _voxel_world_collider_aux; }
+    // nodes the collider keeps collision around, the player node is added on init
+    void add_collider_agent(Node3D *agent);
+    void remove_collider_agent(Node3D *agent);
 
+    // Raycast edit dispatched right away, the edits queued before it are applied first.
     void edit_world(const Vector3 &camera_origin, const Vector3 &camera_direction, const float radius, const float range, const int value);
+    // Sphere, box and stamp edits are queued and applied together at the start of the next physics frame.
+    // Positions are in meters, radius and half extents in voxels.
     void edit_sphere_at(const Vector3 &position, const float radius, const int value);
+    void edit_box_at(const Vector3 &position, const Vector3 &half_extents, const int value);
+    void edit_capsule_at(const Vector3 &from, const Vector3 &to, const float radius, const int value);
+    void edit_cylinder_at(const Vector3 &from, const Vector3 &to, const float radius, const int value);
+    void edit_cone_at(const Vector3 &from, const Vector3 &to, const float radius_from, const float radius_to,
+                      const int value);
+    // Two spheres blended over smoothness voxels, either merged or with the second one carved out of the first.
+    void edit_smooth_union_at(const Vector3 &position_a, const float radius_a, const Vector3 &position_b,
+                              const float radius_b, const float smoothness, const int value);
+    void edit_smooth_subtract_at(const Vector3 &position, const float radius, const Vector3 &subtract_position,
+                                 const float subtract_radius, const float smoothness, const int value);
+    // Writes the non-air voxels of voxel_data with their minimum corner at position.
+    void stamp_at(const Vector3 &position, const Ref<VoxelData> &voxel_data);
+    // Carves a sphere of air and throws part of the removed voxels out as debris particles (eject_speed in m/s).
+    void explode_at(const Vector3 &position, const float radius, const float eject_speed);
+    // Undo/redo whole edits (every edit_world call, or all queued edits of a frame). Return false if there is nothing to do.
+    bool undo();
+    bool redo();
+    void clear_undo_history();
+    int get_undo_count() const { return _edit_journal ? _edit_journal->get_undo_count() : 0; }
+    int get_redo_count() const { return _edit_journal ? _edit_journal->get_redo_count() : 0; }
+
     Vector4 raycast_voxels(const Vector3 &origin, const Vector3 &direction, float near, float far);
+    // Traces all rays with a single dispatch. Returns VoxelRaycastPass::HIT_STRIDE floats per ray: distance in meters
+    // (< 0 if nothing was hit), normal xyz, grid position xyz and voxel type.
+    PackedFloat32Array raycast_batch(const PackedVector3Array &origins, const PackedVector3Array &directions,
+                                     const PackedFloat32Array &ranges);
+    // Same as raycast_voxels / raycast_batch but traced on the CPU mirror: no GPU sync, a few frames behind. Traced
+    // on the GPU while the mirror is disabled or not synced yet.
+    Vector4 raycast_voxels_cpu(const Vector3 &origin, const Vector3 &direction, float near, float far);
+    PackedFloat32Array raycast_batch_cpu(const PackedVector3Array &origins, const PackedVector3Array &directions,
+                                         const PackedFloat32Array &ranges);
+    // Top of the highest solid voxel in the column at world x, z in meters, -1 if there is none. A lookup in the
+    // heightmap of the CPU mirror, which follows edits and simulation with the mirror's delay.
+    float get_ground_height(float x, float z) const;
+    // voxel type of that top voxel, 0 if there is none
+    int get_ground_type(float x, float z) const;
+    // Top of the first solid voxel below origin within max_distance meters, -1 if there is none. The heightmap when
+    // its column top is below origin, else (overhangs, caves, a mirror that is not synced yet) a downward sweep.
+    float get_ground_below(const Vector3 &origin, float max_distance);
+    // Moves a sphere from -> to and returns Vector4(contact center, w distance travelled or -1), meters. Uses the
+    // CPU mirror when enabled and synced, the GPU otherwise.
+    Vector4 sweep_sphere(const Vector3 &from, const Vector3 &to, float radius);
+    // voxel count per type (index = type) with the voxel center inside the sphere, type_mask has a bit per type
+    PackedInt32Array overlap_count(const Vector3 &center, float radius, int type_mask);
+    // batched versions on the GPU and the CPU mirror, 8 values per query: a raycast_batch hit or the type counts
+    PackedFloat32Array sweep_sphere_batch(const PackedVector3Array &froms, const PackedVector3Array &tos,
+                                          const PackedFloat32Array &radii);
+    PackedInt32Array overlap_count_batch(const PackedVector3Array &centers, const PackedFloat32Array &radii,
+                                         int type_mask);
+    PackedFloat32Array sweep_sphere_batch_cpu(const PackedVector3Array &froms, const PackedVector3Array &tos,
+                                              const PackedFloat32Array &radii);
+    PackedInt32Array overlap_count_batch_cpu(const PackedVector3Array &centers, const PackedFloat32Array &radii,
+                                             int type_mask);
+    // Latency-tolerant raycast: queued into this frame's batch, callback(hit: Vector4) is called with the
+    // raycast_voxels result once the readback completes, usually next frame.
+    void raycast_voxels_async(const Vector3 &origin, const Vector3 &direction, float near, float far,
+                              const Callable &callback);
+    VoxelWorldMirror *get_mirror() const { return _mirror; }
 
     VoxelWorldRIDs get_voxel_world_rids() const { return _voxel_world_rids; }
     VoxelWorldProperties get_voxel_properties() const { return _voxel_properties; }
+    VoxelParticleSystem *get_particle_system() const { return _particle_system; }
 
     Ref<VoxelWorldGenerator> get_generator() const { return generator;}
     void set_generator(const Ref<VoxelWorldGenerator> p_generator) { generator = p_generator; }
@@ -119,6 +226,8 @@ public:
     float get_time_simulation_liquid() const { return _time_simulation_liquid_us / 1000.0f; }
     float get_time_simulation_freeze() const { return _time_simulation_freeze_us / 1000.0f; }
     float get_time_simulation_cleanup() const { return _time_simulation_cleanup_us / 1000.0f; }
+    float get_time_simulation_particles() const { return _time_simulation_particles_us / 1000.0f; }
+    float get_time_edit() const { return _time_edit_us / 1000.0f; }
     float get_time_collision() const { return _time_collision_us / 1000.0f; }
     float get_time_total_update() const { return _time_total_update_us / 1000.0f; }
 